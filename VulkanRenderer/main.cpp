@@ -2,15 +2,25 @@
 
 #define GLFW_INCLUDE_VULKAN
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_DXT_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include <GLFW/glfw3.h>
-
+#include <tol/tiny_obj_loader.h>
+#include <stbi/stb_dxt.h>
+#include <stbi/stb_image_resize2.h>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 
 #include "sources/application.h"
+#include "sources/benchmarks.h"
 #include "sources/apps/draw_model_app.h"
 #include "sources/apps/draw_particles_app.h"
 
@@ -19,20 +29,71 @@ enum AppIdentifier
 	DRAW_MODEL, DRAW_PARTICLES
 };
 
+const std::array<std::string, 3> PARTICLE_INTERACTION_NAMES = { "none", "grid", "brute-force" }; // Indexed by "ParticleInteractions".
+
+static ParticleInteractions parseParticleInteractions(const std::string& name)
+{
+	for (size_t i = 0; i < PARTICLE_INTERACTION_NAMES.size(); i++)
+	{
+		if (PARTICLE_INTERACTION_NAMES[i] == name)
+		{
+			return static_cast<ParticleInteractions>(i);
+		}
+	}
+
+	throw std::runtime_error("Unknown particle interactions \"" + name + "\"!");
+}
+
 class Program
 {
 public:
-	void run(int appIdentifier)
+	void run(int appIdentifier, const HeadlessSettings& headlessSettings = {}, uint32_t headlessFrameCount = 0, const BenchmarkSettings& benchmarkSettings = {})
 	{
+		headless = headlessSettings;
+		frameCount = headlessFrameCount;
+		benchmark = benchmarkSettings;
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+
 		setup(appIdentifier);
-		runMainLoop();
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		double startupTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+		// Uploads are still in flight at this point, the upload context logs their totals at clean-up.
+		std::cout << "[INFO] STARTUP TIME: " << startupTime << " ms" << std::endl;
+
+		if (benchmark.enabled)
+		{
+			runBenchmarkLoop(appIdentifier, startupTime);
+		}
+		else if (headless.enabled)
+		{
+			runHeadlessLoop();
+		}
+		else
+		{
+			runMainLoop();
+		}
+
 		cleanUp();
 	}
 
+	uint32_t modelInstanceCount = MODEL_INSTANCE_COUNT; // Applied to the model app before its setup.
+	uint32_t particleCount = PARTICLE_COUNT; // Applied to the particle app before its setup.
+	ParticleInteractions particleInteractions = PARTICLE_INTERACTIONS;
+
+	std::vector<FrameBenchmarkResult> benchmarkResults; // One per benchmark run, in order.
+
 private:
 	uint32_t windowWidth = 1600, windowHeight = 900;
 
-	GLFWwindow* window;
+	GLFWwindow* window = nullptr;
+
+	HeadlessSettings headless;
+	uint32_t frameCount = 0;
+
+	BenchmarkSettings benchmark;
 
 	Application* app;
 
@@ -45,31 +106,70 @@ private:
 		ptr->framebufferResized = true;
 	}
 
+	static void keyCallback(GLFWwindow* window, int key, int, int action, int)
+	{
+		Application* ptr = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+
+		if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+		{
+			ptr->profileExportRequested = true;
+		}
+	}
+
 	void setup(int appIdentifier)
 	{
-		glfwInit();
+		if (!headless.enabled)
+		{
+			glfwInit();
 
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-		window = glfwCreateWindow(windowWidth, windowHeight, "Vulkan Renderer", nullptr, nullptr);
+			window = glfwCreateWindow(windowWidth, windowHeight, "Vulkan Renderer", nullptr, nullptr);
 
-		glfwSetWindowUserPointer(window, this);
-		glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+			glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+			glfwSetKeyCallback(window, keyCallback);
+		}
 
 		switch (appIdentifier)
 		{
 		case AppIdentifier::DRAW_MODEL:
-			app = new DrawModelApp();
+		{
+			DrawModelApp* modelApp = new DrawModelApp();
+
+			modelApp->instanceCount = modelInstanceCount;
+
+			app = modelApp;
 			break;
+		}
 
 		case AppIdentifier::DRAW_PARTICLES:
-			app = new DrawParticlesApp();
+		{
+			DrawParticlesApp* particlesApp = new DrawParticlesApp();
+
+			particlesApp->particleCount = particleCount;
+			particlesApp->interactions = particleInteractions;
+
+			app = particlesApp;
 			break;
+		}
 
 		default:
 			break;
 		}
 
+		if (!headless.enabled)
+		{
+			// The callbacks reach the app through the window.
+			glfwSetWindowUserPointer(window, app);
+		}
+
+		app->headless = headless;
+
+		if (benchmark.enabled)
+		{
+			app->randomSeed = benchmark.seed;
+		}
+
 		app->setup(window);
 	}
 
@@ -89,23 +189,419 @@ private:
 		}
 	}
 
+	void runHeadlessLoop()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto lastTime = startTime;
+
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			auto currTime = std::chrono::high_resolution_clock::now();
+
+			deltaTime = std::chrono::duration<float>(currTime - lastTime).count();
+			lastTime = currTime;
+
+			app->update(deltaTime);
+			app->render(window, deltaTime);
+		}
+
+		// The last frames in flight aren't waited for, their share of the total is negligible over a long run.
+		double totalTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		std::cout << "[INFO] HEADLESS RUN:" << std::endl;
+		std::cout << '\t' << "Frames: " << frameCount << " (" << headless.width << "x" << headless.height << ")" << std::endl;
+		std::cout << '\t' << "Time: " << totalTime << " ms" << std::endl;
+		std::cout << '\t' << "Average frame time: " << totalTime / std::max(frameCount, 1u) << " ms" << std::endl;
+		std::cout << '\t' << "Throughput: " << frameCount * 1000.0 / totalTime << " frames/s" << std::endl;
+	}
+
+	void runBenchmarkLoop(int appIdentifier, double startupTime)
+	{
+		FrameBenchmarkResult result;
+
+		result.appName = appIdentifier == AppIdentifier::DRAW_MODEL ? "draw_model" : "draw_particles";
+		result.seed = benchmark.seed;
+		result.timeStep = benchmark.timeStep;
+		result.warmupFrames = benchmark.warmupFrames;
+		result.headless = headless.enabled;
+		result.width = headless.enabled ? headless.width : windowWidth;
+		result.height = headless.enabled ? headless.height : windowHeight;
+		result.instanceCount = appIdentifier == AppIdentifier::DRAW_MODEL ? modelInstanceCount : 1;
+		result.particleCount = appIdentifier == AppIdentifier::DRAW_PARTICLES ? particleCount : 0;
+		result.particleInteractions = appIdentifier == AppIdentifier::DRAW_PARTICLES ? PARTICLE_INTERACTION_NAMES[static_cast<size_t>(particleInteractions)] : "";
+		result.startupTime = startupTime;
+
+		uint32_t totalFrames = benchmark.warmupFrames + benchmark.measuredFrames;
+
+		for (uint32_t i = 0; i < totalFrames; i++)
+		{
+			if (!headless.enabled)
+			{
+				if (glfwWindowShouldClose(window))
+				{
+					break;
+				}
+
+				glfwPollEvents();
+			}
+
+			auto frameStartTime = std::chrono::high_resolution_clock::now();
+
+			// The simulated time step replaces the measured one, so every run updates the same way.
+			app->update(benchmark.timeStep);
+			app->render(window, benchmark.timeStep);
+
+			double cpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStartTime).count();
+			double gpuTime = 0.0;
+			bool gpuTimeCollected = app->getProfiler().takeCollectedTime(gpuTime);
+
+			if (i < benchmark.warmupFrames)
+			{
+				continue;
+			}
+
+			result.cpuFrameTimes.push_back(cpuTime);
+
+			if (gpuTimeCollected)
+			{
+				result.gpuFrameTimes.push_back(gpuTime);
+			}
+		}
+
+		for (const GpuProfiler::ScopeStatistics& scope : app->getProfiler().getStatistics())
+		{
+			result.gpuScopeTimes.emplace_back(scope.name, scope.avgTime);
+		}
+
+		writeFrameBenchmarkReport(benchmark.outputPath, result);
+
+		benchmarkResults.push_back(std::move(result));
+	}
+
 	void cleanUp()
 	{
 		app->cleanUp();
 
-		glfwDestroyWindow(window);
+		delete app;
+
+		if (!headless.enabled)
+		{
+			glfwDestroyWindow(window);
 
-		glfwTerminate();
+			glfwTerminate();
+		}
 	}
 };
 
-int main()
+int main(int argc, char** argv)
 {
 	Program program;
 	int appIdentifier = -1;
 
 	try
 	{
+		// Command line tools, run instead of the interactive applications.
+		if (argc >= 4 && std::string(argv[1]) == "--generate-grid")
+		{
+			generateGridModel(argv[2], static_cast<uint32_t>(std::stoul(argv[3])));
+
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 3 && std::string(argv[1]) == "--bench-obj")
+		{
+			runObjParserBenchmark(argv[2]);
+
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 3 && std::string(argv[1]) == "--bench-dedup")
+		{
+			runDedupBenchmark(argv[2]);
+
+			return EXIT_SUCCESS;
+		}
+
+		if (argc >= 2 && std::string(argv[1]) == "--bench-mipmaps")
+		{
+			DrawModelApp app;
+
+			app.headless.enabled = true;
+
+			app.setup(nullptr);
+			app.runMipmapBenchmark();
+			app.cleanUp();
+
+			return EXIT_SUCCESS;
+		}
+
+		// Renders the still model with both vertex layouts and compares the frames, fails past the thresholds.
+		if (argc >= 2 && std::string(argv[1]) == "--diff-vertex-layouts")
+		{
+			const uint32_t tolerance = 8;
+			const double maxDifferingPixels = 0.5;
+
+			std::array<VertexLayout, 2> layouts = { VertexLayout::FLOAT, VertexLayout::COMPACT };
+			std::array<std::vector<uint8_t>, 2> frames;
+
+			for (size_t i = 0; i < layouts.size(); i++)
+			{
+				DrawModelApp app;
+
+				app.headless.enabled = true;
+				app.headless.readback = true;
+				app.vertexLayout = layouts[i];
+
+				app.setup(nullptr);
+				frames[i] = app.captureFrame();
+				app.cleanUp();
+			}
+
+			ImageDifference difference = compareImages(frames[0], frames[1], tolerance);
+			bool passed = difference.differingPixels <= maxDifferingPixels;
+
+			std::cout << "[INFO] VERTEX LAYOUT DIFF (float vs compact):" << std::endl;
+			std::cout << '\t' << "PSNR: " << difference.psnr << " dB, max channel difference: " << difference.maxDifference << std::endl;
+			std::cout << '\t' << "Pixels off by more than " << tolerance << ": " << difference.differingPixels << "% (at most " << maxDifferingPixels << "%)" << std::endl;
+			std::cout << '\t' << "Result: " << (passed ? "passed" : "FAILED") << std::endl;
+
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Usage: --verify-culling <instance count> <frame count>
+		if (argc >= 4 && std::string(argv[1]) == "--verify-culling")
+		{
+			DrawModelApp app;
+
+			app.headless.enabled = true;
+			app.instanceCount = static_cast<uint32_t>(std::stoul(argv[2]));
+
+			app.setup(nullptr);
+			bool passed = app.verifyCulling(static_cast<uint32_t>(std::stoul(argv[3])));
+			app.cleanUp();
+
+			return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Usage: --headless <app identifier> <frame count> [--readback]
+		if (argc >= 4 && std::string(argv[1]) == "--headless")
+		{
+			HeadlessSettings headless;
+
+			headless.enabled = true;
+			headless.readback = argc >= 5 && std::string(argv[4]) == "--readback";
+
+			program.run(std::stoi(argv[2]), headless, static_cast<uint32_t>(std::stoul(argv[3])));
+
+			return EXIT_SUCCESS;
+		}
+
+		// Usage: --bench-instances <warm-up frames> <measured frames> [--headless] [--output <path>]
+		// Benchmarks the model app once per instance count, from 1 to 1M, every count draws in a single call.
+		if (argc >= 4 && std::string(argv[1]) == "--bench-instances")
+		{
+			HeadlessSettings headless;
+			BenchmarkSettings benchmark;
+			std::string outputPath = "instancing_benchmark.json";
+
+			benchmark.enabled = true;
+			benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[2]));
+			benchmark.measuredFrames = static_cast<uint32_t>(std::stoul(argv[3]));
+			benchmark.outputPath = ""; // Runs are only logged, the sweep report holds all of them.
+
+			for (int i = 4; i < argc; i++)
+			{
+				std::string option = argv[i];
+
+				if (option == "--headless")
+				{
+					headless.enabled = true;
+				}
+				else if (option == "--output" && i + 1 < argc)
+				{
+					outputPath = argv[++i];
+				}
+				else
+				{
+					throw std::runtime_error("Unknown benchmark option \"" + option + "\"!");
+				}
+			}
+
+			std::vector<uint32_t> instanceCounts = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+			for (uint32_t instanceCount : instanceCounts)
+			{
+				program.modelInstanceCount = instanceCount;
+
+				program.run(AppIdentifier::DRAW_MODEL, headless, 0, benchmark);
+			}
+
+			writeSweepBenchmarkReport(outputPath, "instances", instanceCounts, program.benchmarkResults);
+
+			return EXIT_SUCCESS;
+		}
+
+		// Usage: --bench-particles <warm-up frames> <measured frames> [--headless] [--output <path>]
+		// Benchmarks the particle app once per particle count, from 8K to 16M, the report splits simulation ("particle dispatch") and draw ("render pass") times.
+		// Particles don't interact, so the runs measure the streams alone (see "--bench-neighbours").
+		if (argc >= 4 && std::string(argv[1]) == "--bench-particles")
+		{
+			HeadlessSettings headless;
+			BenchmarkSettings benchmark;
+			std::string outputPath = "particles_benchmark.json";
+
+			benchmark.enabled = true;
+			benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[2]));
+			benchmark.measuredFrames = static_cast<uint32_t>(std::stoul(argv[3]));
+			benchmark.outputPath = ""; // Runs are only logged, the sweep report holds all of them.
+
+			for (int i = 4; i < argc; i++)
+			{
+				std::string option = argv[i];
+
+				if (option == "--headless")
+				{
+					headless.enabled = true;
+				}
+				else if (option == "--output" && i + 1 < argc)
+				{
+					outputPath = argv[++i];
+				}
+				else
+				{
+					throw std::runtime_error("Unknown benchmark option \"" + option + "\"!");
+				}
+			}
+
+			std::vector<uint32_t> particleCounts = { 1 << 13, 1 << 15, 1 << 17, 1 << 19, 1 << 21, 1 << 23, 1 << 24 };
+
+			program.particleInteractions = ParticleInteractions::NONE;
+
+			for (uint32_t particleCount : particleCounts)
+			{
+				program.particleCount = particleCount;
+
+				program.run(AppIdentifier::DRAW_PARTICLES, headless, 0, benchmark);
+			}
+
+			writeSweepBenchmarkReport(outputPath, "particles", particleCounts, program.benchmarkResults);
+
+			return EXIT_SUCCESS;
+		}
+
+		// Usage: --bench-neighbours <warm-up frames> <measured frames> [--headless] [--output <path>]
+		// Benchmarks the particle interactions from 64K to 4M particles, with the grid and with the brute force reference
+		// (up to 256K particles, its steps grow quadratically). The report splits the grid build ("particle grid") from the
+		// force evaluation and integration ("particle simulation"), per step.
+		if (argc >= 4 && std::string(argv[1]) == "--bench-neighbours")
+		{
+			const uint32_t maxBruteForceParticles = 1 << 18;
+
+			HeadlessSettings headless;
+			BenchmarkSettings benchmark;
+			std::string outputPath = "neighbours_benchmark.json";
+
+			benchmark.enabled = true;
+			benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[2]));
+			benchmark.measuredFrames = static_cast<uint32_t>(std::stoul(argv[3]));
+			benchmark.outputPath = ""; // Runs are only logged, the sweep report holds all of them.
+
+			for (int i = 4; i < argc; i++)
+			{
+				std::string option = argv[i];
+
+				if (option == "--headless")
+				{
+					headless.enabled = true;
+				}
+				else if (option == "--output" && i + 1 < argc)
+				{
+					outputPath = argv[++i];
+				}
+				else
+				{
+					throw std::runtime_error("Unknown benchmark option \"" + option + "\"!");
+				}
+			}
+
+			std::vector<uint32_t> runParticleCounts;
+
+			for (uint32_t particleCount : { 1 << 16, 1 << 18, 1 << 20, 1 << 22 })
+			{
+				for (ParticleInteractions interactions : { ParticleInteractions::GRID, ParticleInteractions::BRUTE_FORCE })
+				{
+					if (interactions == ParticleInteractions::BRUTE_FORCE && particleCount > maxBruteForceParticles)
+					{
+						continue;
+					}
+
+					program.particleCount = particleCount;
+					program.particleInteractions = interactions;
+
+					program.run(AppIdentifier::DRAW_PARTICLES, headless, 0, benchmark);
+
+					runParticleCounts.push_back(particleCount);
+				}
+			}
+
+			writeSweepBenchmarkReport(outputPath, "particles", runParticleCounts, program.benchmarkResults);
+
+			return EXIT_SUCCESS;
+		}
+
+		// Usage: --benchmark <app identifier> <warm-up frames> <measured frames> [--headless] [--seed <n>] [--time-step <seconds>] [--instances <n>] [--particles <n>] [--interactions <none|grid|brute-force>] [--output <path>]
+		if (argc >= 5 && std::string(argv[1]) == "--benchmark")
+		{
+			HeadlessSettings headless;
+			BenchmarkSettings benchmark;
+
+			benchmark.enabled = true;
+			benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[3]));
+			benchmark.measuredFrames = static_cast<uint32_t>(std::stoul(argv[4]));
+
+			for (int i = 5; i < argc; i++)
+			{
+				std::string option = argv[i];
+
+				if (option == "--headless")
+				{
+					headless.enabled = true;
+				}
+				else if (option == "--seed" && i + 1 < argc)
+				{
+					benchmark.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+				}
+				else if (option == "--time-step" && i + 1 < argc)
+				{
+					benchmark.timeStep = std::stof(argv[++i]);
+				}
+				else if (option == "--instances" && i + 1 < argc)
+				{
+					program.modelInstanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+				}
+				else if (option == "--particles" && i + 1 < argc)
+				{
+					program.particleCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+				}
+				else if (option == "--interactions" && i + 1 < argc)
+				{
+					program.particleInteractions = parseParticleInteractions(argv[++i]);
+				}
+				else if (option == "--output" && i + 1 < argc)
+				{
+					benchmark.outputPath = argv[++i];
+				}
+				else
+				{
+					throw std::runtime_error("Unknown benchmark option \"" + option + "\"!");
+				}
+			}
+
+			program.run(std::stoi(argv[2]), headless, 0, benchmark);
+
+			return EXIT_SUCCESS;
+		}
+
 		std::cout << "APPLICATIONS:" << std::endl;
 		std::cout << "\t0. DRAW MODEL" << std::endl;
 		std::cout << "\t1. DRAW PARTICLES" << std::endl;
@@ -10,6 +10,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/hash.hpp>
 
 #ifndef STB_IMAGE_LIB_INCLUDED
@@ -18,12 +19,35 @@
 #include <stbi/stb_image.h>
 #endif // !STB_IMAGE_IMPLEMENTATION
 
+#include "memory_allocator.h"
+#include "staging_ring.h"
+#include "upload_context.h"
+#include "pipeline_cache.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "parallel_for.h"
+#include "vertex_dedup.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet_builder.h"
+#include "obj_parser.h"
+#include "gpu_profiler.h"
+#include "gpu_culler.h"
+#include "offscreen_target.h"
+#include "texture_cache.h"
+#include "texture_compression.h"
+#include "mipmap_generator.h"
+#include "texture_streamer.h"
+
 #include <set>
+#include <span>
 #include <array>
 #include <vector>
 #include <chrono>
 #include <random>
+#include <limits>
 #include <fstream>
+#include <numeric>
 #include <iostream>
 #include <optional>
 #include <algorithm>
@@ -38,9 +62,77 @@ const bool ENABLE_VALIDATION_LAYERS = true;
 const std::vector<const char*> VALIDATION_LAYERS = { "VK_LAYER_KHRONOS_validation" };
 
 const std::vector<const char*> DEVICE_EXTENSIONS = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+const std::vector<const char*> HEADLESS_DEVICE_EXTENSIONS = {};
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+const VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024; // Uploads larger than the ring go through a temporary overflow block.
+
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin"; // Shared by every app, entries are keyed by the pipeline state.
+
+const VkFormat HEADLESS_IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_SRGB; // Same format the swap chain prefers, so pipelines match.
+
+// Where texture mip levels come from. Precomputed levels are streamed from the texture cache, smallest first,
+// the runtime sources build them from an RGBA8 base level: a blit per level (needs linear blit support) or the
+// compute mipmap generator (needs storage images only).
+enum class MipmapSource
+{
+	PRECOMPUTED, BLIT, COMPUTE
+};
+
+const MipmapSource TEXTURE_MIPMAP_SOURCE = MipmapSource::PRECOMPUTED;
+
+// Vertex layouts of the model app. The compact one quantizes positions to SNORM16 within the mesh bounds
+// (dequantized in the vertex shader) and stores UVs as half floats, 12 bytes per vertex instead of 32.
+enum class VertexLayout
+{
+	FLOAT, COMPACT
+};
+
+const VertexLayout MODEL_VERTEX_LAYOUT = VertexLayout::COMPACT;
+
+const uint32_t MODEL_INSTANCE_COUNT = 1; // Copies of the model drawn by a single call, laid out on a square grid.
+const float MODEL_INSTANCE_SPACING = 2.5f; // Distance between neighbouring grid cells, the model fits in a 2x2 square.
+const uint32_t INSTANCE_UPDATE_BATCH = 16384; // Instance transforms written per worker thread at least.
+
+const bool MODEL_GPU_CULLING = true; // Frustum culls the model instances in a compute pass and draws them indirectly, when supported.
+const bool MODEL_MESHLET_CULLING = true; // Culls every meshlet of every instance on its own, by frustum and normal cone.
+const uint64_t MESHLET_CULLING_MAX_DRAWS = 1 << 22; // Instances times meshlets at most, past it whole instances are culled.
+
+const bool OPTIMIZE_MESH_OVERDRAW = true; // Cluster reorder after the vertex cache one, when importing models.
+
+const uint32_t MODEL_LOD_COUNT = 6; // Levels generated on import, the full mesh included, fewer when simplification stalls.
+const float MODEL_LOD_REDUCTION = 0.5f; // Triangles every level keeps of the previous one.
+const float MODEL_LOD_MAX_ERROR = 0.05f; // Simplification error the coarsest level may reach, relative to the mesh radius.
+const float MODEL_LOD_PIXEL_ERROR = 1.0f; // Projected simplification error tolerated on screen, in pixels.
+
+static_assert(MODEL_LOD_COUNT <= GpuCuller::MAX_LEVELS_OF_DETAIL, "The GPU culler can't select between that many levels!");
+
+const uint32_t PARTICLE_COUNT = 8192; // Capacity of the particle pool, any count. Only the live particles are simulated and drawn.
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256; // Must match "local_size_x" of the particle compute shader.
+const float PARTICLE_SPEED = 0.2f; // Initial speed, in screen units per second (the screen spans 2 of them).
+const float PARTICLE_TIME_STEP = 1.0f / 60.0f; // Simulated seconds per step, whatever the frame rate.
+const uint32_t PARTICLE_MAX_SUBSTEPS = 8; // Steps recorded per frame at most, past it the simulation slows down instead of falling further behind.
+const float PARTICLE_LIFETIME = 4.0f; // Mean lifetime of the default emitter, in seconds, it emits just enough to fill the pool.
+const uint32_t MAX_PARTICLE_EMITTERS = 4;
+
+// How particles find the neighbours they interact with. The grid hashes them into cells as large as the interaction
+// radius and counting sorts them by cell every step, so only the 3x3 cells around a particle are searched. The brute
+// force reference tests every pair of particles of a chunk, it's only meant for comparison.
+enum class ParticleInteractions
+{
+	NONE, GRID, BRUTE_FORCE
+};
+
+const ParticleInteractions PARTICLE_INTERACTIONS = ParticleInteractions::GRID;
+const float PARTICLE_INTERACTION_RADIUS = 1.0f / 128.0f; // In screen units, also the size of the grid cells.
+const float PARTICLE_SEPARATION = 0.5f; // Acceleration away from the closest neighbours at most, in screen units per second squared.
+const float PARTICLE_COHESION = 0.25f; // Acceleration towards the center of the neighbours at most.
+
+const VkDeviceSize TEXTURE_STREAMING_BUDGET = 2 * 1024 * 1024; // Texture bytes uploaded per frame at most, while streaming.
+
+const std::string GPU_PROFILE_PATH = "gpu_profile"; // Exported as ".csv" and ".json" when requested (F12).
+
 static VkResult createDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
 {
 	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
@@ -65,6 +157,32 @@ static void destroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMesse
 	}
 }
 
+// Rendering without a window: no GLFW, no surface and no swap chain. Frames go to offscreen images
+// rotating with the frames in flight, optionally read back to host memory.
+struct HeadlessSettings
+{
+	bool enabled = false;
+	bool readback = false;
+
+	uint32_t width = 1600;
+	uint32_t height = 900;
+};
+
+// Non interactive runs doing the same work every time: a fixed seed, a fixed simulated time step and a fixed
+// number of frames. Warm-up frames aren't measured, they also cover the GPU times lagging by the frames in flight.
+struct BenchmarkSettings
+{
+	bool enabled = false;
+
+	uint32_t seed = 1;
+	float timeStep = 1.0f / 60.0f;
+
+	uint32_t warmupFrames = 100;
+	uint32_t measuredFrames = 1000;
+
+	std::string outputPath = "benchmark.json";
+};
+
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsAndComputeFamily;
@@ -84,6 +202,13 @@ struct SwapChainSupportDetails
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
+// "VertexLayout::COMPACT" vertices, built from the float ones at upload.
+struct CompactVertex
+{
+	int16_t position[4]; // SNORM16 within the mesh bounds, the last component only pads to 8 bytes.
+	uint16_t uvs[2];     // Half floats.
+};
+
 struct Vertex
 {
 	glm::vec3 position;
@@ -95,70 +220,100 @@ struct Vertex
 		return position == other.position && color == other.color && uvs == other.uvs;
 	}
 
-	static VkVertexInputBindingDescription getBindingDescription()
+	static VkVertexInputBindingDescription getBindingDescription(VertexLayout layout = VertexLayout::FLOAT)
 	{
 		VkVertexInputBindingDescription bindingDescription{};
 
 		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
+		bindingDescription.stride = layout == VertexLayout::COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
 		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	// The color is always white, so it isn't fetched by either layout.
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(VertexLayout layout = VertexLayout::FLOAT)
 	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, position);
 
 		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
+		attributeDescriptions[1].location = 2;
 
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, uvs);
+		if (layout == VertexLayout::COMPACT)
+		{
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+			attributeDescriptions[0].offset = offsetof(CompactVertex, position);
+
+			attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+			attributeDescriptions[1].offset = offsetof(CompactVertex, uvs);
+		}
+		else
+		{
+			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[0].offset = offsetof(Vertex, position);
+
+			attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+			attributeDescriptions[1].offset = offsetof(Vertex, uvs);
+		}
 
 		return attributeDescriptions;
 	}
 };
 
-struct Particle
+// Particles are stored as a structure of arrays, a tightly packed (std430) stream per attribute, so every pass only
+// moves what it uses. Positions and velocities are double buffered, every simulation step reads one buffer and writes
+// the other, so the last two steps are always at hand to interpolate between. Colors never change, they live in a
+// single buffer read by the vertex stage only. Lifetimes are updated in place, and the live and dead particles are
+// listed by index.
+struct ParticleStreams
 {
-	glm::vec2 position;
-	glm::vec2 velocity;
-	glm::vec4 color;
-
-	static VkVertexInputBindingDescription getBindingDescription()
+	using Position = glm::vec2;
+	using Velocity = glm::vec2;
+	using Color = glm::vec4;
+	using Lifetime = float;
+	using Index = uint32_t;
+
+	// Positions of the last step on binding 0, colors on binding 1, positions of the step before on binding 2.
+	static std::array<VkVertexInputBindingDescription, 3> getBindingDescriptions()
 	{
-		VkVertexInputBindingDescription bindingDescription{};
+		std::array<VkVertexInputBindingDescription, 3> bindingDescriptions{};
 
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Particle);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(Position);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-		return bindingDescription;
+		bindingDescriptions[1].binding = 1;
+		bindingDescriptions[1].stride = sizeof(Color);
+		bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		bindingDescriptions[2].binding = 2;
+		bindingDescriptions[2].stride = sizeof(Position);
+		bindingDescriptions[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescriptions;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
 	{
-		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
 
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
 		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Particle, position);
+		attributeDescriptions[0].offset = 0;
 
-		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].binding = 1;
 		attributeDescriptions[1].location = 1;
 		attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Particle, color);
+		attributeDescriptions[1].offset = 0;
+
+		attributeDescriptions[2].binding = 2;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[2].offset = 0;
 
 		return attributeDescriptions;
 	}
@@ -181,12 +336,48 @@ struct UniformBufferObject
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 projection;
 	alignas(16) float time;
+	alignas(16) glm::vec4 positionScale; // Dequantizes compact vertex positions, identity for float ones.
+	alignas(16) glm::vec4 positionOffset;
+};
+
+// Spawns particles in a disc, moving away from its center. Matches the std140 layout of the particle compute shader.
+struct ParticleEmitter
+{
+	alignas(8) glm::vec2 position = glm::vec2(0.0f);
+	float radius = 0.25f;
+	float speed = PARTICLE_SPEED;
+	float rate = 0.0f; // Particles per second.
+	float lifetime = PARTICLE_LIFETIME; // Mean, particles live between half and one and a half of it.
+	float padding[2] = {};
+};
+
+static_assert(sizeof(ParticleEmitter) == 32, "The emitters don't match the std140 layout of the particle compute shader!");
+
+struct ParticleUniformBufferObject
+{
+	alignas(16) ParticleEmitter emitters[MAX_PARTICLE_EMITTERS];
+	uint32_t emitterCount;
+	float timeStep; // Seconds per simulation step.
+	float aspectRatio; // Height over width, so emitters spawn round discs.
+
+	float interactionRadius;
+	float separation;
+	float cohesion;
+	uint32_t gridSize;  // Cells per side, the grid covers the screen from its (-1, -1) corner.
+	uint32_t cellCount; // Of the grid, padded to whole workgroups.
+};
+
+// Per instance data of the model app, indexed by "gl_InstanceIndex" in a storage buffer.
+struct InstanceData
+{
+	alignas(16) glm::mat4 model;
 };
 
 class Application
 {
 public:
 	Application() = default;
+	virtual ~Application() = default;
 
 	virtual void setup(GLFWwindow* window) = 0;
 	virtual void cleanUp() = 0;
@@ -194,6 +385,8 @@ public:
 	virtual void update(float deltaTime) = 0;
 	virtual void render(GLFWwindow* window, float deltaTime) = 0;
 
+	virtual GpuProfiler& getProfiler() = 0;
+
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 		VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -227,4 +420,9 @@ public:
 	}
 
 	bool framebufferResized = false;
+	bool profileExportRequested = false;
+
+	HeadlessSettings headless;
+
+	std::optional<uint32_t> randomSeed; // Seeds from the clock when empty.
 };
@@ -39,33 +39,54 @@ void DrawModelApp::setup(GLFWwindow* window)
 	createVertexBuffer();
 	createIndexBuffer();
 	createUniformBuffers();
+	createInstanceBuffers();
 
 	createDescriptorPool();
 	createDescriptorSets();
 
+	createGpuCuller();
+
 	createSyncObjects();
+
+	// Every upload recorded above goes out in a single submission, frames are ordered behind it on the graphics queue.
+	context.uploader.submit();
 }
 
 void DrawModelApp::cleanUp()
 {
 	vkDeviceWaitIdle(context.device);
 
+	if (context.mipmapGenerator.isInitialized())
+	{
+		context.mipmapGenerator.destroy();
+	}
+
+	context.textureStreamer.destroy();
+
+	if (context.gpuCuller.isInitialized())
+	{
+		context.gpuCuller.destroy(); // Its statistics are logged with the other ones, below.
+	}
+
 	vkDestroySampler(context.device, context.textureSampler, nullptr);
 	vkDestroyImageView(context.device, context.textureImageView, nullptr);
 	vkDestroyImage(context.device, context.textureImage, nullptr);
-	vkFreeMemory(context.device, context.textureImageMemory, nullptr);
+	context.allocator.free(context.textureImageMemory);
 
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		vkDestroyBuffer(context.device, context.uniformBuffers[i], nullptr);
-		vkFreeMemory(context.device, context.uniformBuffersMemory[i], nullptr);
+		context.allocator.free(context.uniformBuffersMemory[i]);
+
+		vkDestroyBuffer(context.device, context.instanceBuffers[i], nullptr);
+		context.allocator.free(context.instanceBuffersMemory[i]);
 	}
 
 	vkDestroyBuffer(context.device, context.indexBuffer, nullptr);
-	vkFreeMemory(context.device, context.indexBufferMemory, nullptr);
+	context.allocator.free(context.indexBufferMemory);
 
 	vkDestroyBuffer(context.device, context.vertexBuffer, nullptr);
-	vkFreeMemory(context.device, context.vertexBufferMemory, nullptr);
+	context.allocator.free(context.vertexBufferMemory);
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -88,11 +109,11 @@ void DrawModelApp::cleanUp()
 
 	vkDestroyImageView(context.device, context.depthImageView, nullptr);
 	vkDestroyImage(context.device, context.depthImage, nullptr);
-	vkFreeMemory(context.device, context.depthImageMemory, nullptr);
+	context.allocator.free(context.depthImageMemory);
 
 	vkDestroyImageView(context.device, context.colorImageView, nullptr);
 	vkDestroyImage(context.device, context.colorImage, nullptr);
-	vkFreeMemory(context.device, context.colorImageMemory, nullptr);
+	context.allocator.free(context.colorImageMemory);
 
 	vkDestroyPipeline(context.device, context.graphicsPipeline, nullptr);
 
@@ -109,42 +130,106 @@ void DrawModelApp::cleanUp()
 		vkDestroyImageView(context.device, context.swapChainImageViews[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	if (headless.enabled)
+	{
+		context.offscreenTarget.destroy();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	}
+
+	context.uploader.destroy();
+	context.pipelineCache.destroy();
+
+	context.profiler.logStatistics();
+	context.profiler.destroy();
+
+	context.gpuCuller.logStatistics();
+	logLodStatistics();
+
+	context.allocator.logStatistics();
+	context.allocator.destroy();
 
 	vkDestroyDevice(context.device, nullptr);
 
-	vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
+	if (!headless.enabled)
+	{
+		vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
+	}
 
 	vkDestroyInstance(context.instance, nullptr);
 }
 
 void DrawModelApp::update(float deltaTime)
 {
+	context.currentTime += deltaTime;
 }
 
 void DrawModelApp::render(GLFWwindow* window, float deltaTime)
 {
 	vkWaitForFences(context.device, 1, &context.queueSubmitFences[context.currentFrame], VK_TRUE, UINT64_MAX);
 
-	uint32_t imageIndex;
-	VkResult acquireResult = vkAcquireNextImageKHR(context.device, context.swapChain, UINT64_MAX, context.swapChainAcquireSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+	context.uploader.collect();
+	context.profiler.collect(context.currentFrame);
+	context.offscreenTarget.collect(context.currentFrame);
+	context.gpuCuller.collect(context.currentFrame);
+
+	const GpuCuller::Statistics& cullingStatistics = context.gpuCuller.getStatistics();
 
-	if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_SUBOPTIMAL_KHR)
+	if (cullingStatistics.frame > context.lodStatisticsCullingFrame)
 	{
-		recreateSwapChain(window);
-		return;
+		for (uint32_t level = 0; level < GpuCuller::MAX_LEVELS_OF_DETAIL; level++)
+		{
+			context.lodTriangleSums[level] += cullingStatistics.lodTriangles[level];
+		}
+
+		context.lodStatisticsFrames++;
+		context.lodStatisticsCullingFrame = cullingStatistics.frame;
+	}
+
+	// Uploads go out ahead of the frame on the graphics queue, so the view can already cover the levels they complete.
+	if (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED)
+	{
+		context.textureStreamer.update();
+		context.uploader.submit();
+	}
+
+	updateTextureDescriptor(context.currentFrame);
+
+	if (profileExportRequested)
+	{
+		context.profiler.exportCsv(GPU_PROFILE_PATH + ".csv");
+		context.profiler.exportJson(GPU_PROFILE_PATH + ".json");
+
+		profileExportRequested = false;
 	}
-	else if (acquireResult != VK_SUCCESS)
+
+	uint32_t imageIndex = context.currentFrame; // Offscreen images rotate with the frames in flight.
+
+	if (!headless.enabled)
 	{
-		throw std::runtime_error("Failed to acquire swap chain image!");
+		VkResult acquireResult = vkAcquireNextImageKHR(context.device, context.swapChain, UINT64_MAX, context.swapChainAcquireSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_SUBOPTIMAL_KHR)
+		{
+			recreateSwapChain(window);
+			return;
+		}
+		else if (acquireResult != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to acquire swap chain image!");
+		}
 	}
 
 	vkResetFences(context.device, 1, &context.queueSubmitFences[context.currentFrame]); // Only reset the fence if we are submitting some work...
 
 	vkResetCommandBuffer(context.commandBuffers[context.currentFrame], 0);
 
-	recordCommandBuffer(context.commandBuffers[context.currentFrame], imageIndex);
+	// Levels selected on the CPU decide the draws, so the buffers are written before recording.
 	updateUniformBuffer(context.currentFrame);
+	updateInstanceBuffer(context.currentFrame);
+	recordCommandBuffer(context.commandBuffers[context.currentFrame], imageIndex);
 
 	VkSemaphore waitSemaphores[] = { context.swapChainAcquireSemaphores[context.currentFrame] };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -153,12 +238,12 @@ void DrawModelApp::render(GLFWwindow* window, float deltaTime)
 	VkSubmitInfo submitInfo{};
 
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = headless.enabled ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &context.commandBuffers[context.currentFrame];
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = headless.enabled ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	if (vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, context.queueSubmitFences[context.currentFrame]) != VK_SUCCESS)
@@ -166,6 +251,13 @@ void DrawModelApp::render(GLFWwindow* window, float deltaTime)
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
 
+	if (headless.enabled)
+	{
+		context.currentFrame = (context.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+		return;
+	}
+
 	VkSwapchainKHR swapChains[] = { context.swapChain };
 
 	VkPresentInfoKHR presentInfo{};
@@ -246,10 +338,16 @@ bool DrawModelApp::checkValidationLayerSupport()
 
 std::vector<const char*> DrawModelApp::getRequiredInstanceExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
+
+	// GLFW isn't initialized when rendering headless, and no surface is created.
+	if (!headless.enabled)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -269,7 +367,7 @@ bool DrawModelApp::checkDeviceExtensionSupport(VkPhysicalDevice device)
 
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	for (const char* extensionName : DEVICE_EXTENSIONS)
+	for (const char* extensionName : headless.enabled ? HEADLESS_DEVICE_EXTENSIONS : DEVICE_EXTENSIONS)
 	{
 		bool extensionFound = false;
 
@@ -308,7 +406,15 @@ QueueFamilyIndices DrawModelApp::findQueueFamilies(VkPhysicalDevice device)
 		const VkQueueFamilyProperties& queueFamily = queueFamilies[i];
 		VkBool32 presentSupport = false;
 
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentSupport);
+		// Nothing is presented when rendering headless, the graphics queue stands in for the present queue.
+		if (headless.enabled)
+		{
+			presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentSupport);
+		}
 
 		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
@@ -372,9 +478,9 @@ bool DrawModelApp::isDeviceSuitable(VkPhysicalDevice device)
 
 	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(device);
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	bool swapChainAdequate = false;
+	bool swapChainAdequate = headless.enabled;
 
-	if (extensionsSupported)
+	if (extensionsSupported && !headless.enabled)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 
@@ -383,7 +489,7 @@ bool DrawModelApp::isDeviceSuitable(VkPhysicalDevice device)
 
 	bool suitable = true;
 
-	suitable = suitable && deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+	suitable = suitable && (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || headless.enabled); // Headless runs also accept software devices (e.g. lavapipe).
 	suitable = suitable && deviceFeatures.geometryShader && deviceFeatures.samplerAnisotropy;
 	suitable = suitable && queueFamilyIndices.isComplete();
 	suitable = suitable && extensionsSupported && swapChainAdequate;
@@ -456,7 +562,7 @@ VkExtent2D DrawModelApp::chooseSwapExtent(GLFWwindow* window, const VkSurfaceCap
 	}
 }
 
-VkImageView DrawModelApp::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
+VkImageView DrawModelApp::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, const VkComponentMapping& components)
 {
 	VkImageViewCreateInfo viewCreateInfo{};
 
@@ -464,6 +570,7 @@ VkImageView DrawModelApp::createImageView(VkImage image, VkFormat format, VkImag
 	viewCreateInfo.image = image;
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewCreateInfo.format = format;
+	viewCreateInfo.components = components;
 	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;
 	viewCreateInfo.subresourceRange.baseMipLevel = 0;
 	viewCreateInfo.subresourceRange.levelCount = mipLevels;
@@ -542,7 +649,22 @@ void DrawModelApp::cleanUpSwapChain()
 		vkDestroyImageView(context.device, context.swapChainImageViews[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	vkDestroyImageView(context.device, context.depthImageView, nullptr);
+	vkDestroyImage(context.device, context.depthImage, nullptr);
+	context.allocator.free(context.depthImageMemory);
+
+	vkDestroyImageView(context.device, context.colorImageView, nullptr);
+	vkDestroyImage(context.device, context.colorImage, nullptr);
+	context.allocator.free(context.colorImageMemory);
+
+	if (headless.enabled)
+	{
+		context.offscreenTarget.destroy();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	}
 }
 
 void DrawModelApp::recreateSwapChain(GLFWwindow* window)
@@ -581,6 +703,18 @@ void DrawModelApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t i
 		throw std::runtime_error("Failed to begin recording command buffer!");
 	}
 
+	context.profiler.beginRecording(commandBuffer, context.currentFrame);
+
+	if (context.gpuCuller.isInitialized())
+	{
+		context.profiler.beginScope(commandBuffer, "culling");
+		context.gpuCuller.setLodErrorScale(getLodErrorScale());
+		context.gpuCuller.recordCulling(commandBuffer, context.currentFrame);
+		context.profiler.endScope(commandBuffer);
+	}
+
+	context.profiler.beginScope(commandBuffer, "render pass");
+
 	std::array<VkClearValue, 2> clearValues{}; // The order of "clearValues" should be identical to the order of your attachments.
 
 	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -622,85 +756,65 @@ void DrawModelApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t i
 	VkDeviceSize offsets[] = { 0 };
 
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, context.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, context.indexBuffer, 0, context.indexType);
 
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context.pipelineLayout, 0, 1, &context.descriptorSets[context.currentFrame], 0, nullptr);
 
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(context.indices.size()), 1, 0, 0, 0);
-
-	vkCmdEndRenderPass(commandBuffer);
-
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	// Culled draws cost the same to record for any instance count, only the GPU work grows.
+	if (context.gpuCuller.isInitialized())
 	{
-		throw std::runtime_error("Failed to record command buffer!");
+		context.gpuCuller.recordDraw(commandBuffer, context.currentFrame);
 	}
-}
-
-VkCommandBuffer DrawModelApp::beginSingleTimeCommands()
-{
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
-
-	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBufferAllocateInfo.commandPool = context.commandPool;
-	commandBufferAllocateInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-
-	vkAllocateCommandBuffers(context.device, &commandBufferAllocateInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo{};
-
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
-}
-
-void DrawModelApp::endSingleTimeCommands(VkCommandBuffer commandBuffer)
-{
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo{};
+	else
+	{
+		uint32_t firstInstance = 0;
 
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+		for (uint32_t level = 0; level < context.lods.size(); level++)
+		{
+			uint32_t levelInstanceCount = context.lodInstanceCounts[level];
 
-	vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+			if (levelInstanceCount > 0)
+			{
+				vkCmdDrawIndexed(commandBuffer, context.lods[level].indexCount, levelInstanceCount, context.lods[level].firstIndex, 0, firstInstance);
+			}
 
-	vkQueueWaitIdle(context.graphicsQueue);
+			firstInstance += levelInstanceCount;
+		}
+	}
 
-	vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
-}
+	vkCmdEndRenderPass(commandBuffer);
 
-uint32_t DrawModelApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	context.profiler.endScope(commandBuffer);
 
-	vkGetPhysicalDeviceMemoryProperties(context.gpu, &memoryProperties);
+	context.offscreenTarget.recordReadback(commandBuffer, imageIndex);
 
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 	{
-		if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
+		throw std::runtime_error("Failed to record command buffer!");
 	}
-
-	throw std::runtime_error("Failed to find suitable memory type!");
 }
 
-void DrawModelApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void DrawModelApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory)
 {
 	VkBufferCreateInfo bufferCreateInfo{};
 
 	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferCreateInfo.size = size;
 	bufferCreateInfo.usage = usage;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Upload destinations are written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices = context.uploader.getQueueFamilyIndices();
+
+	if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && context.uploader.hasDedicatedTransferQueue())
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateBuffer(context.device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
 	{
@@ -711,40 +825,30 @@ void DrawModelApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkM
 
 	vkGetBufferMemoryRequirements(context.device, buffer, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAllocateInfo{};
+	bufferMemory = context.allocator.allocate(memoryRequirements, properties, LINEAR_RESOURCE);
 
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(context.device, &memoryAllocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate buffer memory!");
-	}
-
-	vkBindBufferMemory(context.device, buffer, bufferMemory, 0);
+	vkBindBufferMemory(context.device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void DrawModelApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void DrawModelApp::copyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = context.uploader.getTransferCommandBuffer();
 
 	VkBufferCopy copyRegion{};
 
-	copyRegion.srcOffset = 0;
+	copyRegion.srcOffset = srcOffset;
 	copyRegion.dstOffset = 0;
 	copyRegion.size = size;
 
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
-void DrawModelApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+void DrawModelApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory, VkImageCreateFlags flags)
 {
 	VkImageCreateInfo imageCreateInfo{};
 
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.flags = flags;
 	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageCreateInfo.extent.width = width;
 	imageCreateInfo.extent.height = height;
@@ -756,7 +860,20 @@ void DrawModelApp::createImage(uint32_t width, uint32_t height, uint32_t mipLeve
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCreateInfo.usage = usage;
 	imageCreateInfo.samples = numSamples;
-	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Upload destinations are written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices = context.uploader.getQueueFamilyIndices();
+
+	if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && context.uploader.hasDedicatedTransferQueue())
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateImage(context.device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
 	{
@@ -767,23 +884,19 @@ void DrawModelApp::createImage(uint32_t width, uint32_t height, uint32_t mipLeve
 
 	vkGetImageMemoryRequirements(context.device, image, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAllocateInfo{};
+	// Render targets are recreated along with the swap chain, so they get their own memory instead of fragmenting the pools.
+	bool dedicated = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+	AllocationType type = tiling == VK_IMAGE_TILING_OPTIMAL ? OPTIMAL_RESOURCE : LINEAR_RESOURCE;
 
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+	imageMemory = context.allocator.allocate(memoryRequirements, properties, type, dedicated);
 
-	if (vkAllocateMemory(context.device, &memoryAllocateInfo, nullptr, &imageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(context.device, image, imageMemory, 0);
+	vkBindImageMemory(context.device, image, imageMemory.memory, imageMemory.offset);
 }
 
-void DrawModelApp::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+void DrawModelApp::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	// Transfer queues can't wait on shader stages, so transitions to shader read are recorded for the graphics queue.
+	VkCommandBuffer commandBuffer = newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? context.uploader.getTransferCommandBuffer() : context.uploader.getGraphicsCommandBuffer();
 
 	VkImageMemoryBarrier barrier{};
 
@@ -831,17 +944,15 @@ void DrawModelApp::transitionImageLayout(VkImage image, VkFormat format, VkImage
 		0, nullptr,
 		1, &barrier
 	);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
-void DrawModelApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void DrawModelApp::copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = context.uploader.getTransferCommandBuffer();
 
 	VkBufferImageCopy region{};
 
-	region.bufferOffset = 0;
+	region.bufferOffset = bufferOffset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -859,8 +970,6 @@ void DrawModelApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t wi
 		1,
 		&region
 	);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
 void DrawModelApp::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
@@ -875,7 +984,8 @@ void DrawModelApp::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t
 		throw std::runtime_error("Texture image format does not support linear blitting!");
 	}
 
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	// Blits need a graphics queue.
+	VkCommandBuffer commandBuffer = context.uploader.getGraphicsCommandBuffer();
 
 	VkImageMemoryBarrier barrier{};
 
@@ -936,196 +1046,780 @@ void DrawModelApp::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t
 	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
-void DrawModelApp::updateUniformBuffer(uint32_t currentImage)
+void DrawModelApp::initMipmapGenerator()
 {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	auto currentTime = std::chrono::high_resolution_clock::now();
-
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-	float width = static_cast<float>(context.swapChainExtent.width);
-	float height = static_cast<float>(context.swapChainExtent.height);
-
-	UniformBufferObject ubo{};
-
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.projection = glm::perspective(glm::radians(45.0f), width / height, 0.1f, 10.0f);
-
-	ubo.projection[1][1] *= -1; // GLM was originally designed for OpenGL, where the Y coordinate of the clip coordinates is inverted.
-
-	memcpy(context.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	if (!context.mipmapGenerator.isInitialized())
+	{
+		context.mipmapGenerator.init(context.device, context.pipelineCache, readFile(mipmapShaderPath));
+	}
 }
 
-void DrawModelApp::loadModel()
+void DrawModelApp::runMipmapBenchmark()
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string error;
+	const uint32_t iterations = 10;
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, modelPath.c_str()))
+	if (!MipmapGenerator::isSupported(context.gpu))
 	{
-		throw std::runtime_error(error);
+		throw std::runtime_error("Mipmap generator storage format isn't supported!");
 	}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	initMipmapGenerator();
 
-	for (const auto& shape : shapes)
+	QueueFamilyIndices indices = findQueueFamilies(context.gpu);
+	GpuProfiler profiler;
+
+	profiler.init(context.gpu, context.device, indices.graphicsAndComputeFamily.value(), 1);
+
+	for (uint32_t size = 256; size <= 4096; size *= 2)
 	{
-		for (const auto& index : shape.mesh.indices)
-		{
-			Vertex vertex{};
+		uint32_t mipLevels = getMipLevelCount(size, size);
 
-			vertex.position = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+		VkImage blitImage = VK_NULL_HANDLE, computeImage = VK_NULL_HANDLE;
+		MemoryAllocation blitImageMemory, computeImageMemory;
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
+		createImage(size, size, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, blitImage, blitImageMemory);
+		createImage(size, size, mipLevels, VK_SAMPLE_COUNT_1_BIT, MipmapGenerator::STORAGE_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, computeImage, computeImageMemory, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
 
-			vertex.uvs = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
+		// Texel values don't change the timings, each run only discards the image contents. Both paths are
+		// submitted separately, so neither one overlaps the other.
+		for (uint32_t i = 0; i < 2 * iterations; i++)
+		{
+			bool compute = i % 2 == 1;
+			VkImage image = compute ? computeImage : blitImage;
 
-			if (uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(context.vertices.size());
+			transitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
-				context.vertices.push_back(vertex);
-			}
+			VkCommandBuffer commandBuffer = context.uploader.getGraphicsCommandBuffer();
 
-			context.indices.push_back(uniqueVertices[vertex]);
-		}
-	}
-}
+			profiler.beginRecording(commandBuffer, 0);
+			profiler.beginScope(commandBuffer, (compute ? "compute " : "blit ") + std::to_string(size));
 
-void DrawModelApp::createInstance()
-{
-	if (ENABLE_VALIDATION_LAYERS && !checkValidationLayerSupport())
-	{
-		throw std::runtime_error("Validation layers requested, but not available!");
-	}
+			if (compute)
+			{
+				context.mipmapGenerator.record(commandBuffer, image, size, size, mipLevels, true);
+			}
+			else
+			{
+				generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, size, size, mipLevels);
+			}
 
-	std::vector<const char*> extensions = getRequiredInstanceExtensions();
+			profiler.endScope(commandBuffer);
 
-	VkApplicationInfo appInfo{};
+			context.uploader.wait(context.uploader.submit());
+			context.uploader.collect();
 
-	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	appInfo.pApplicationName = "Vulkan Renderer";
-	appInfo.pEngineName = "No Engine";
-	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+			profiler.collect(0);
 
-	VkInstanceCreateInfo instanceCreateInfo{};
+			context.mipmapGenerator.releaseResources();
+		}
 
-	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-	instanceCreateInfo.pApplicationInfo = &appInfo;
-	instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-	instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
+		vkDestroyImage(context.device, blitImage, nullptr);
+		context.allocator.free(blitImageMemory);
 
-	if (ENABLE_VALIDATION_LAYERS)
-	{
-		VkDebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo{};
+		vkDestroyImage(context.device, computeImage, nullptr);
+		context.allocator.free(computeImageMemory);
+	}
 
-		debugMessengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-		debugMessengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-		debugMessengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-		debugMessengerCreateInfo.pfnUserCallback = debugCallback;
+	// Scopes were opened in pairs, blit first.
+	std::vector<GpuProfiler::ScopeStatistics> statistics = profiler.getStatistics();
 
-		instanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
-		instanceCreateInfo.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+	std::cout << "[INFO] MIPMAP BENCHMARK:" << std::endl;
 
-		instanceCreateInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugMessengerCreateInfo;
-	}
-	else
+	for (size_t i = 0; i + 1 < statistics.size(); i += 2)
 	{
-		instanceCreateInfo.enabledLayerCount = 0;
+		const GpuProfiler::ScopeStatistics& blit = statistics[i];
+		const GpuProfiler::ScopeStatistics& compute = statistics[i + 1];
 
-		instanceCreateInfo.pNext = nullptr;
+		std::cout << '\t' << blit.name << ": avg " << blit.avgTime << " ms, min " << blit.minTime << " ms | "
+			<< compute.name << ": avg " << compute.avgTime << " ms, min " << compute.minTime << " ms ("
+			<< blit.avgTime / compute.avgTime << "x)" << std::endl;
 	}
 
-	if (vkCreateInstance(&instanceCreateInfo, nullptr, &context.instance) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create VK instance!");
-	}
+	profiler.destroy();
 }
 
-void DrawModelApp::createDebugMessenger()
+std::vector<uint8_t> DrawModelApp::captureFrame()
 {
-	if (ENABLE_VALIDATION_LAYERS)
+	if (!headless.enabled || !headless.readback)
 	{
-		VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo{};
-
-		messengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-		messengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-		messengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-		messengerCreateInfo.pfnUserCallback = debugCallback;
+		throw std::runtime_error("Frame capture requires headless rendering with readback!");
+	}
 
-		if (createDebugUtilsMessengerEXT(context.instance, &messengerCreateInfo, nullptr, &context.debugMessenger) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to set up debug messenger!");
-		}
+	// "update" isn't called, so the model stays still.
+	while (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED && !context.textureStreamer.isFullyResident())
+	{
+		render(nullptr, 0.0f);
 	}
-}
 
-void DrawModelApp::createSurface(GLFWwindow* window)
-{
-	if (glfwCreateWindowSurface(context.instance, window, nullptr, &context.surface) != VK_SUCCESS)
+	// Frames are read back once their slot comes around again, the last collected one has every level bound.
+	for (uint32_t i = 0; i <= MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		throw std::runtime_error("Failed to create window surface!");
+		render(nullptr, 0.0f);
 	}
+
+	return context.offscreenTarget.getLastFrame();
 }
 
-void DrawModelApp::selectPhysicalDevice()
+bool DrawModelApp::verifyCulling(uint32_t frameCount)
 {
-	uint32_t deviceCount = 0;
-
-	vkEnumeratePhysicalDevices(context.instance, &deviceCount, nullptr);
-
-	if (deviceCount == 0)
+	if (!headless.enabled || !context.gpuCuller.isInitialized())
 	{
-		throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+		throw std::runtime_error("Culling verification requires headless rendering with GPU culling!");
 	}
 
-	std::vector<VkPhysicalDevice> availableDevices(deviceCount);
-
-	vkEnumeratePhysicalDevices(context.instance, &deviceCount, availableDevices.data());
+	const float timeStep = 1.0f / 60.0f;
 
-	for (const VkPhysicalDevice& device : availableDevices)
+	struct Counts
 	{
-		if (isDeviceSuitable(device))
-		{
-			context.gpu = device;
-			context.msaaSamples = getMaxUsableSampleCount();
+		uint32_t draws = 0;
+		uint64_t triangles = 0;
+	};
 
-			break;
-		}
-	}
+	std::vector<Counts> expectedCounts; // Indexed by the culler's frame number minus one.
+	uint64_t lastCheckedFrame = 0;
 
-	if (context.gpu == VK_NULL_HANDLE)
+	uint32_t tolerance = std::max(1u, static_cast<uint32_t>(context.drawRecords.size() * (context.cullMeshlets ? context.lodFirstMeshlets[1] : 1) / 1000)); // Border cases may round differently on the GPU.
+	std::vector<uint32_t> lodStates(context.drawRecords.size(), 0); // Mirrors the levels kept by the culler.
+	float errorScale = getLodErrorScale();
+	uint32_t checkedFrames = 0, failedFrames = 0, maxDifference = 0;
+	uint64_t drawnTrianglesSum = 0, expectedTrianglesSum = 0;
+
+	for (uint32_t i = 0; i < frameCount; i++)
 	{
-		throw std::runtime_error("Failed to find a suitable GPU!");
-	}
-}
+		uint32_t slot = context.currentFrame;
 
-void DrawModelApp::createLogicalDevice()
-{
-	float queuePriority = 1.0f;
+		update(timeStep);
+		render(nullptr, timeStep);
 
-	QueueFamilyIndices indices = findQueueFamilies(context.gpu);
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value() };
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+		// The host visible inputs of the frame just submitted, exactly what the culling pass reads.
+		const UniformBufferObject* ubo = static_cast<const UniformBufferObject*>(context.uniformBuffersMapped[slot]);
+		const InstanceData* instances = static_cast<const InstanceData*>(context.instanceBuffersMemory[slot].mapped);
 
-	for (uint32_t queueFamily : uniqueQueueFamilies)
-	{
-		VkDeviceQueueCreateInfo queueCreateInfo{};
+		glm::mat4 view = ubo->view;
+		glm::mat4 viewProjection = ubo->projection * view;
+		Counts expected;
+
+		for (size_t recordIndex = 0; recordIndex < context.drawRecords.size(); recordIndex++)
+		{
+			const GpuCuller::DrawRecord& record = context.drawRecords[recordIndex];
+			glm::mat4 model = instances[record.transformIndex].model;
+
+			if (!GpuCuller::isVisible(record, nullptr, &viewProjection[0][0], &view[0][0], &model[0][0]))
+			{
+				continue;
+			}
+
+			uint32_t level = GpuCuller::selectLevelOfDetail(context.lods, lodStates[recordIndex], record, &view[0][0], &model[0][0], errorScale);
+
+			lodStates[recordIndex] = level;
+
+			if (!context.cullMeshlets)
+			{
+				expected.draws++;
+				expected.triangles += context.lods[level].indexCount / 3;
+
+				continue;
+			}
+
+			for (uint32_t meshlet = context.lodFirstMeshlets[level]; meshlet < context.lodFirstMeshlets[level + 1]; meshlet++)
+			{
+				if (GpuCuller::isVisible(record, &context.meshlets[meshlet], &viewProjection[0][0], &view[0][0], &model[0][0]))
+				{
+					expected.draws++;
+					expected.triangles += context.meshlets[meshlet].indexCount / 3;
+				}
+			}
+		}
+
+		expectedCounts.push_back(expected);
+
+		const GpuCuller::Statistics& statistics = context.gpuCuller.getStatistics();
+
+		if (statistics.frame > lastCheckedFrame)
+		{
+			uint32_t expectedDraws = expectedCounts[statistics.frame - 1].draws;
+			uint32_t difference = statistics.visibleCount > expectedDraws ? statistics.visibleCount - expectedDraws : expectedDraws - statistics.visibleCount;
+
+			maxDifference = std::max(maxDifference, difference);
+			failedFrames += difference > tolerance ? 1 : 0;
+			drawnTrianglesSum += statistics.drawnTriangles;
+			expectedTrianglesSum += expectedCounts[statistics.frame - 1].triangles;
+			checkedFrames++;
+
+			lastCheckedFrame = statistics.frame;
+		}
+	}
+
+	bool passed = checkedFrames > 0 && failedFrames == 0;
+	uint64_t submittedTriangles = context.gpuCuller.getStatistics().submittedTriangles;
+
+	std::cout << "[INFO] CULLING VERIFICATION:" << std::endl;
+	std::cout << '\t' << "Instances: " << instanceCount << (context.cullMeshlets ? ", meshlets: " + std::to_string(context.meshlets.size()) : "") << std::endl;
+	std::cout << '\t' << "Frames checked: " << checkedFrames << " of " << frameCount << std::endl;
+	std::cout << '\t' << "Triangles per frame: " << submittedTriangles << " submitted, "
+		<< (checkedFrames > 0 ? static_cast<double>(drawnTrianglesSum) / checkedFrames : 0.0) << " drawn on average ("
+		<< (checkedFrames > 0 ? static_cast<double>(expectedTrianglesSum) / checkedFrames : 0.0) << " expected)" << std::endl;
+	std::cout << '\t' << "Largest draw count difference from the CPU reference: " << maxDifference << " (at most " << tolerance << ")" << std::endl;
+	std::cout << '\t' << "Result: " << (passed ? "passed" : "FAILED") << std::endl;
+
+	return passed;
+}
+
+void DrawModelApp::updateUniformBuffer(uint32_t currentImage)
+{
+	float width = static_cast<float>(context.swapChainExtent.width);
+	float height = static_cast<float>(context.swapChainExtent.height);
+
+	UniformBufferObject ubo{};
+
+	ubo.model = glm::mat4(1.0f); // Every instance carries its own transform.
+	ubo.view = glm::lookAt(getCameraPosition(), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.projection = glm::perspective(cameraFieldOfView, width / height, 0.1f, 10.0f + 2.0f * context.instanceFieldExtent);
+
+	ubo.projection[1][1] *= -1; // GLM was originally designed for OpenGL, where the Y coordinate of the clip coordinates is inverted.
+
+	ubo.positionScale = glm::vec4(context.positionScale, 0.0f);
+	ubo.positionOffset = glm::vec4(context.positionOffset, 0.0f);
+
+	memcpy(context.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+}
+
+void DrawModelApp::updateInstanceBuffer(uint32_t currentImage)
+{
+	float time = context.currentTime; // Accumulated from the frame deltas, so a fixed time step replays the same frames.
+	float angle = time * glm::radians(90.0f);
+
+	InstanceData* instances = static_cast<InstanceData*>(context.instanceBuffersMemory[currentImage].mapped);
+
+	// A rotation around Z followed by the grid translation.
+	auto getTransform = [&](uint32_t instance)
+	{
+		const glm::vec4& origin = context.instanceOrigins[instance];
+
+		float cosine = std::cos(angle + origin.w);
+		float sine = std::sin(angle + origin.w);
+
+		glm::mat4 model;
+
+		model[0] = glm::vec4(cosine, sine, 0.0f, 0.0f);
+		model[1] = glm::vec4(-sine, cosine, 0.0f, 0.0f);
+		model[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		model[3] = glm::vec4(origin.x, origin.y, origin.z, 1.0f);
+
+		return model;
+	};
+
+	uint32_t threadCount = std::min(getWorkerThreadCount(), std::max(instanceCount / INSTANCE_UPDATE_BATCH, 1u));
+
+	// The GPU culler selects levels itself and finds the transforms by instance.
+	if (context.gpuCuller.isInitialized() || context.lods.size() <= 1)
+	{
+		context.lodInstanceCounts.fill(0);
+		context.lodInstanceCounts[0] = instanceCount;
+
+		// Written sequentially and never read back, the mapping may be write combined.
+		parallelFor(instanceCount, threadCount, [&](size_t begin, size_t end, uint32_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				instances[i].model = getTransform(static_cast<uint32_t>(i));
+			}
+		});
+
+		return;
+	}
+
+	glm::vec3 cameraPosition = getCameraPosition();
+	glm::vec3 sphereCenter = glm::vec3(context.boundingSphere);
+	float errorScale = getLodErrorScale();
+
+	parallelFor(instanceCount, threadCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 center = glm::vec3(getTransform(static_cast<uint32_t>(i)) * glm::vec4(sphereCenter, 1.0f));
+			float distance = std::max(glm::length(center - cameraPosition) - context.boundingSphere.w, 1e-6f);
+
+			context.instanceLods[i] = selectMeshLod(context.lods, context.instanceLods[i], errorScale / distance);
+		}
+	});
+
+	// Grouped by level, every level is drawn with a single instanced call.
+	std::array<uint32_t, GpuCuller::MAX_LEVELS_OF_DETAIL> offsets{};
+
+	context.lodInstanceCounts.fill(0);
+
+	for (uint32_t level : context.instanceLods)
+	{
+		context.lodInstanceCounts[level]++;
+	}
+
+	std::exclusive_scan(context.lodInstanceCounts.begin(), context.lodInstanceCounts.end(), offsets.begin(), 0u);
+
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		context.instanceSlots[i] = offsets[context.instanceLods[i]]++;
+	}
+
+	parallelFor(instanceCount, threadCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			instances[context.instanceSlots[i]].model = getTransform(static_cast<uint32_t>(i));
+		}
+	});
+
+	for (uint32_t level = 0; level < context.lods.size(); level++)
+	{
+		context.lodTriangleSums[level] += static_cast<uint64_t>(context.lodInstanceCounts[level]) * (context.lods[level].indexCount / 3);
+	}
+
+	context.lodStatisticsFrames++;
+}
+
+glm::vec3 DrawModelApp::getCameraPosition()
+{
+	// The camera backs away along the same diagonal as the grid grows, a single instance keeps the original view.
+	return glm::vec3(2.0f + 0.5f * context.instanceFieldExtent);
+}
+
+float DrawModelApp::getLodErrorScale()
+{
+	// Pixels covered by an object space unit at a distance of 1, per pixel of tolerated error.
+	float pixelsPerUnit = 0.5f * context.swapChainExtent.height / std::tan(0.5f * cameraFieldOfView);
+
+	return pixelsPerUnit / MODEL_LOD_PIXEL_ERROR;
+}
+
+void DrawModelApp::logLodStatistics()
+{
+	if (context.lods.size() <= 1 || context.lodStatisticsFrames == 0)
+	{
+		return;
+	}
+
+	uint64_t triangleSum = 0;
+
+	for (uint64_t levelSum : context.lodTriangleSums)
+	{
+		triangleSum += levelSum;
+	}
+
+	std::cout << "[INFO] LOD STATISTICS:" << std::endl;
+	std::cout << '\t' << "Frames: " << context.lodStatisticsFrames << " (selected on the " << (context.gpuCuller.isInitialized() ? "GPU" : "CPU") << ")" << std::endl;
+
+	for (uint32_t level = 0; level < context.lods.size(); level++)
+	{
+		double meanTriangles = static_cast<double>(context.lodTriangleSums[level]) / context.lodStatisticsFrames;
+
+		std::cout << '\t' << "Level " << level << ": " << meanTriangles << " triangles drawn per frame ("
+			<< 100.0 * context.lodTriangleSums[level] / std::max<uint64_t>(triangleSum, 1) << "%)" << std::endl;
+	}
+}
+
+void DrawModelApp::loadModel()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile source;
+
+	if (!source.open(modelPath))
+	{
+		throw std::runtime_error("Failed to open model file!");
+	}
+
+	uint64_t sourceHash = MeshCache::hashData(source.getData(), source.getSize());
+	std::string cachePath = modelPath + ".meshcache";
+
+	bool cacheHit = context.meshCache.open(cachePath, sourceHash, sizeof(Vertex));
+
+	if (!cacheHit)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<MeshLod> lods;
+
+		importModel(source, vertices, indices, lods);
+
+		context.meshCache.store(cachePath, sourceHash, sizeof(Vertex), vertices.data(), vertices.size(), indices.data(), indices.size(), lods.data(), lods.size());
+	}
+
+	context.vertices = { static_cast<const Vertex*>(context.meshCache.getVertexData()), context.meshCache.getVertexCount() };
+	context.indices = { context.meshCache.getIndexData(), context.meshCache.getIndexCount() };
+	context.lods = { context.meshCache.getLodData(), context.meshCache.getLodCount() };
+
+	source.close();
+
+	if (context.lods.empty())
+	{
+		throw std::runtime_error("Failed to load model, the mesh has no levels of detail!");
+	}
+
+	// A bounding sphere around the mesh bounds, in model space (before quantization).
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+
+	for (const Vertex& vertex : context.vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	glm::vec3 center = 0.5f * (minimum + maximum);
+	float radius = 0.0f;
+
+	for (const Vertex& vertex : context.vertices)
+	{
+		radius = std::max(radius, glm::length(vertex.position - center));
+	}
+
+	context.boundingSphere = glm::vec4(center, radius);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	buildModelMeshlets();
+
+	std::cout << "[INFO] MODEL LOADED:" << std::endl;
+	std::cout << '\t' << "Source: " << modelPath << std::endl;
+	std::cout << '\t' << "Mesh cache: " << (cacheHit ? "hit" : "miss") << std::endl;
+	std::cout << '\t' << "Vertices: " << context.vertices.size() << ", indices: " << context.indices.size() << " (" << context.lods.size() << " levels of detail)" << std::endl;
+	std::cout << '\t' << "Time: " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+}
+
+void DrawModelApp::importModel(const MappedFile& source, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+	ObjMesh mesh;
+
+	parseObj(source.getData(), source.getSize(), getWorkerThreadCount(), mesh);
+
+	// Corners are first deduplicated by their OBJ index tuple, which is cheap to hash and compare. The
+	// much smaller set of candidates is then merged by value, so corners with different tuples but equal
+	// attributes still share a vertex, exactly as when deduplicating every corner by value.
+	const std::vector<VertexKey>& keys = mesh.corners;
+
+	uint32_t threadCount = keys.size() > PARALLEL_DEDUP_THRESHOLD ? getWorkerThreadCount() : 1;
+
+	std::vector<uint32_t> firstCorners, remap;
+
+	deduplicateVertexKeys(keys, threadCount, indices, firstCorners);
+
+	vertices.resize(firstCorners.size());
+
+	for (size_t i = 0; i < firstCorners.size(); i++)
+	{
+		const VertexKey& key = keys[firstCorners[i]];
+		Vertex& vertex = vertices[i];
+
+		vertex.position = {
+			mesh.positions[3 * key.position + 0],
+			mesh.positions[3 * key.position + 1],
+			mesh.positions[3 * key.position + 2]
+		};
+
+		vertex.color = { 1.0f, 1.0f, 1.0f };
+
+		vertex.uvs = {
+			mesh.texcoords[2 * key.texcoord + 0],
+			1.0f - mesh.texcoords[2 * key.texcoord + 1]
+		};
+	}
+
+	uint32_t vertexCount = deduplicateVertexValues(reinterpret_cast<float*>(vertices.data()), vertices.size(), sizeof(Vertex) / sizeof(float), remap);
+
+	vertices.resize(vertexCount);
+
+	for (uint32_t& index : indices)
+	{
+		index = remap[index];
+	}
+
+	optimizeMesh(vertices, indices);
+	generateLods(vertices, indices, lods);
+}
+
+void DrawModelApp::optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	if (indices.empty())
+	{
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	VertexCacheStatistics initialStatistics = analyzeVertexCache(indices, vertices.size());
+
+	std::vector<uint32_t> clusters;
+
+	optimizeVertexCache(indices, vertices.size(), VERTEX_CACHE_SIZE, clusters);
+
+	if (OPTIMIZE_MESH_OVERDRAW)
+	{
+		optimizeOverdraw(indices, clusters, &vertices[0].position.x, vertices.size(), sizeof(Vertex), VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+	}
+
+	// Vertices are moved to the order the indices first use them in.
+	std::vector<uint32_t> remap;
+	std::vector<Vertex> orderedVertices(optimizeVertexFetch(indices, vertices.size(), remap));
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (remap[i] != UINT32_MAX)
+		{
+			orderedVertices[remap[i]] = vertices[i];
+		}
+	}
+
+	vertices.swap(orderedVertices);
+
+	VertexCacheStatistics statistics = analyzeVertexCache(indices, vertices.size());
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	std::cout << "[INFO] MESH OPTIMIZED:" << std::endl;
+	std::cout << '\t' << "ACMR: " << initialStatistics.acmr << " -> " << statistics.acmr << " (" << VERTEX_CACHE_SIZE << " entry FIFO)" << std::endl;
+	std::cout << '\t' << "ATVR: " << initialStatistics.atvr << " -> " << statistics.atvr << std::endl;
+	std::cout << '\t' << "Clusters: " << clusters.size() << (OPTIMIZE_MESH_OVERDRAW ? " (overdraw reordered)" : "") << std::endl;
+	std::cout << '\t' << "Time: " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+}
+
+void DrawModelApp::generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+	lods.assign(1, MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f, 0 });
+
+	if (indices.empty())
+	{
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+
+	for (const Vertex& vertex : vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	float maxError = MODEL_LOD_MAX_ERROR * 0.5f * glm::length(maximum - minimum);
+
+	// Every level simplifies the previous one, so their errors add up.
+	while (lods.size() < MODEL_LOD_COUNT)
+	{
+		MeshLod previous = lods.back();
+
+		std::span<const uint32_t> previousIndices(indices.data() + previous.firstIndex, previous.indexCount);
+		size_t targetIndexCount = static_cast<size_t>(previous.indexCount / 3 * MODEL_LOD_REDUCTION) * 3;
+
+		float levelError = 0.0f;
+		std::vector<uint32_t> levelIndices = simplifyMesh(previousIndices, &vertices[0].position.x, vertices.size(), sizeof(Vertex), targetIndexCount,
+			maxError - previous.error, &levelError);
+
+		// Stalled on locked vertices or on the error budget, a level saving under a tenth isn't worth its indices.
+		if (levelIndices.empty() || levelIndices.size() > previous.indexCount * 0.9)
+		{
+			break;
+		}
+
+		std::vector<uint32_t> clusters;
+
+		optimizeVertexCache(levelIndices, vertices.size(), VERTEX_CACHE_SIZE, clusters);
+
+		lods.push_back(MeshLod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(levelIndices.size()), previous.error + levelError, 0 });
+
+		indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	std::cout << "[INFO] LOD CHAIN GENERATED:" << std::endl;
+
+	for (uint32_t level = 0; level < lods.size(); level++)
+	{
+		std::cout << '\t' << "Level " << level << ": " << lods[level].indexCount / 3 << " triangles, error " << lods[level].error << std::endl;
+	}
+
+	std::cout << '\t' << "Time: " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+}
+
+void DrawModelApp::buildModelMeshlets()
+{
+	if (!MODEL_MESHLET_CULLING || context.indices.empty())
+	{
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	context.meshlets.clear();
+	context.lodFirstMeshlets.clear();
+
+	// Every level on its own, so meshlets never straddle two of them.
+	for (const MeshLod& lod : context.lods)
+	{
+		std::vector<Meshlet> levelMeshlets = buildMeshlets(context.indices.subspan(lod.firstIndex, lod.indexCount), &context.vertices[0].position.x, context.vertices.size(), sizeof(Vertex));
+
+		for (Meshlet& meshlet : levelMeshlets)
+		{
+			meshlet.firstIndex += lod.firstIndex;
+		}
+
+		context.lodFirstMeshlets.push_back(static_cast<uint32_t>(context.meshlets.size()));
+		context.meshlets.insert(context.meshlets.end(), levelMeshlets.begin(), levelMeshlets.end());
+	}
+
+	context.lodFirstMeshlets.push_back(static_cast<uint32_t>(context.meshlets.size()));
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	uint64_t meshletVertices = 0;
+	uint32_t coneCulledMeshlets = 0;
+
+	for (const Meshlet& meshlet : context.meshlets)
+	{
+		meshletVertices += meshlet.vertexCount;
+		coneCulledMeshlets += meshlet.cone[3] < 1.0f ? 1 : 0;
+	}
+
+	std::cout << "[INFO] MESHLETS:" << std::endl;
+	std::cout << '\t' << "Count: " << context.meshlets.size() << " (at most " << MESHLET_MAX_VERTICES << " vertices and " << MESHLET_MAX_TRIANGLES << " triangles), "
+		<< context.lodFirstMeshlets[1] << " at level 0" << std::endl;
+	std::cout << '\t' << "Average: " << static_cast<double>(meshletVertices) / context.meshlets.size() << " vertices, "
+		<< context.indices.size() / 3.0 / context.meshlets.size() << " triangles" << std::endl;
+	std::cout << '\t' << "With a usable normal cone: " << coneCulledMeshlets << std::endl;
+	std::cout << '\t' << "Time: " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+}
+
+void DrawModelApp::createInstance()
+{
+	if (ENABLE_VALIDATION_LAYERS && !checkValidationLayerSupport())
+	{
+		throw std::runtime_error("Validation layers requested, but not available!");
+	}
+
+	std::vector<const char*> extensions = getRequiredInstanceExtensions();
+
+	VkApplicationInfo appInfo{};
+
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Vulkan Renderer";
+	appInfo.pEngineName = "No Engine";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo instanceCreateInfo{};
+
+	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceCreateInfo.pApplicationInfo = &appInfo;
+	instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
+
+	if (ENABLE_VALIDATION_LAYERS)
+	{
+		VkDebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo{};
+
+		debugMessengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		debugMessengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		debugMessengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		debugMessengerCreateInfo.pfnUserCallback = debugCallback;
+
+		instanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
+		instanceCreateInfo.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+
+		instanceCreateInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugMessengerCreateInfo;
+	}
+	else
+	{
+		instanceCreateInfo.enabledLayerCount = 0;
+
+		instanceCreateInfo.pNext = nullptr;
+	}
+
+	if (vkCreateInstance(&instanceCreateInfo, nullptr, &context.instance) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create VK instance!");
+	}
+}
+
+void DrawModelApp::createDebugMessenger()
+{
+	if (ENABLE_VALIDATION_LAYERS)
+	{
+		VkDebugUtilsMessengerCreateInfoEXT messengerCreateInfo{};
+
+		messengerCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		messengerCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+		messengerCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		messengerCreateInfo.pfnUserCallback = debugCallback;
+
+		if (createDebugUtilsMessengerEXT(context.instance, &messengerCreateInfo, nullptr, &context.debugMessenger) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to set up debug messenger!");
+		}
+	}
+}
+
+void DrawModelApp::createSurface(GLFWwindow* window)
+{
+	if (headless.enabled)
+	{
+		return;
+	}
+
+	if (glfwCreateWindowSurface(context.instance, window, nullptr, &context.surface) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create window surface!");
+	}
+}
+
+void DrawModelApp::selectPhysicalDevice()
+{
+	uint32_t deviceCount = 0;
+
+	vkEnumeratePhysicalDevices(context.instance, &deviceCount, nullptr);
+
+	if (deviceCount == 0)
+	{
+		throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+	}
+
+	std::vector<VkPhysicalDevice> availableDevices(deviceCount);
+
+	vkEnumeratePhysicalDevices(context.instance, &deviceCount, availableDevices.data());
+
+	for (const VkPhysicalDevice& device : availableDevices)
+	{
+		if (isDeviceSuitable(device))
+		{
+			context.gpu = device;
+			context.msaaSamples = getMaxUsableSampleCount();
+
+			break;
+		}
+	}
+
+	if (context.gpu == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Failed to find a suitable GPU!");
+	}
+}
+
+void DrawModelApp::createLogicalDevice()
+{
+	float queuePriority = 1.0f;
+
+	QueueFamilyIndices indices = findQueueFamilies(context.gpu);
+	uint32_t transferFamily = UploadContext::findTransferQueueFamily(context.gpu, indices.graphicsAndComputeFamily.value());
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value(), transferFamily };
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+
+	for (uint32_t queueFamily : uniqueQueueFamilies)
+	{
+		VkDeviceQueueCreateInfo queueCreateInfo{};
 
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
@@ -1140,14 +1834,30 @@ void DrawModelApp::createLogicalDevice()
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.sampleRateShading = VK_FALSE; // To enable/disable sample shading feature for the device.
 
+	std::vector<const char*> deviceExtensions = headless.enabled ? HEADLESS_DEVICE_EXTENSIONS : DEVICE_EXTENSIONS;
+
+	// Optional, the culler falls back to a zero filled multi draw without the count extension.
+	if (gpuCulling && GpuCuller::isSupported(context.gpu, instanceCount))
+	{
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+		context.drawIndirectCount = GpuCuller::isDrawIndirectCountSupported(context.gpu);
+
+		if (context.drawIndirectCount)
+		{
+			deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
+	}
+
 	VkDeviceCreateInfo deviceCreateInfo{};
 
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-	deviceCreateInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -1166,10 +1876,27 @@ void DrawModelApp::createLogicalDevice()
 
 	vkGetDeviceQueue(context.device, indices.graphicsAndComputeFamily.value(), 0, &context.graphicsQueue);
 	vkGetDeviceQueue(context.device, indices.presentFamily.value(), 0, &context.presentQueue);
+
+	context.allocator.init(context.gpu, context.device);
+	context.uploader.init(context.device, context.allocator, indices.graphicsAndComputeFamily.value(), transferFamily, STAGING_RING_SIZE);
+	context.pipelineCache.init(context.gpu, context.device, PIPELINE_CACHE_PATH);
+	context.profiler.init(context.gpu, context.device, indices.graphicsAndComputeFamily.value(), MAX_FRAMES_IN_FLIGHT);
 }
 
 void DrawModelApp::createSwapChain(GLFWwindow* window)
 {
+	if (headless.enabled)
+	{
+		context.swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
+		context.swapChainExtent = { headless.width, headless.height };
+
+		context.offscreenTarget.init(context.device, context.allocator, context.swapChainImageFormat, context.swapChainExtent, MAX_FRAMES_IN_FLIGHT, headless.readback);
+
+		context.swapChainImages = context.offscreenTarget.getImages();
+
+		return;
+	}
+
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(context.gpu);
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -1276,7 +2003,7 @@ void DrawModelApp::createRenderPass()
 	colorAttachmentResolveDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolveDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolveDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolveDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachmentResolveDescription.finalLayout = headless.enabled ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentReference{};
 
@@ -1354,8 +2081,8 @@ void DrawModelApp::createGraphicsPipeline()
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
+	VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription(vertexLayout);
+	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = Vertex::getAttributeDescriptions(vertexLayout);
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateInfo{};
 
@@ -1477,11 +2204,17 @@ void DrawModelApp::createGraphicsPipeline()
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineCreateInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &context.graphicsPipeline) != VK_SUCCESS)
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(context.device, context.pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &context.graphicsPipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
 
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	context.pipelineCache.reportCreationTime("DrawModelApp graphics pipeline", std::chrono::duration<double, std::milli>(endTime - startTime).count());
+
 	vkDestroyShaderModule(context.device, fragShaderModule, nullptr);
 	vkDestroyShaderModule(context.device, vertShaderModule, nullptr);
 }
@@ -1594,112 +2327,236 @@ void DrawModelApp::createSyncObjects()
 
 void DrawModelApp::createVertexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(context.vertices[0]) * context.vertices.size();
-	void* data;  // Allocated memory address.
+	VkDeviceSize bufferSize = 0;
+	StagingRegion staging;
 
-	VkBuffer stagingBuffer{};
-	VkDeviceMemory stagingBufferMemory{};
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// Compact vertices are written straight into the staging memory.
+	if (vertexLayout == VertexLayout::COMPACT)
+	{
+		bufferSize = sizeof(CompactVertex) * context.vertices.size();
+		staging = context.uploader.allocateStaging(bufferSize);
 
-	vkMapMemory(context.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, context.vertices.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(context.device, stagingBufferMemory);
+		quantizeVertices(static_cast<CompactVertex*>(staging.mapped));
+	}
+	else
+	{
+		bufferSize = sizeof(Vertex) * context.vertices.size();
+		staging = context.uploader.stage(context.vertices.data(), bufferSize);
+	}
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.vertexBuffer, context.vertexBufferMemory);
 
-	copyBuffer(stagingBuffer, context.vertexBuffer, bufferSize);
+	copyBuffer(staging.buffer, staging.offset, context.vertexBuffer, bufferSize);
+
+	std::cout << "[INFO] VERTEX BUFFER:" << std::endl;
+	std::cout << '\t' << "Layout: " << (vertexLayout == VertexLayout::COMPACT ? "compact" : "float") << " (" << bufferSize / std::max<size_t>(context.vertices.size(), 1) << " bytes per vertex)" << std::endl;
+	std::cout << '\t' << "Size: " << bufferSize / 1024.0 << " KB, float layout: " << sizeof(Vertex) * context.vertices.size() / 1024.0 << " KB" << std::endl;
+}
+
+void DrawModelApp::quantizeVertices(CompactVertex* compactVertices)
+{
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+
+	for (const Vertex& vertex : context.vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+
+	context.positionOffset = 0.5f * (minimum + maximum);
+	context.positionScale = 0.5f * (maximum - minimum);
+
+	// Flat axes keep a unit scale, their positions all quantize to 0.
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!(context.positionScale[axis] > 0.0f))
+		{
+			context.positionScale[axis] = 1.0f;
+		}
+	}
+
+	for (size_t i = 0; i < context.vertices.size(); i++)
+	{
+		const Vertex& vertex = context.vertices[i];
+		CompactVertex& compactVertex = compactVertices[i];
+
+		glm::vec3 normalized = glm::clamp((vertex.position - context.positionOffset) / context.positionScale, -1.0f, 1.0f);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			compactVertex.position[axis] = static_cast<int16_t>(std::round(normalized[axis] * 32767.0f));
+		}
+
+		compactVertex.position[3] = 0;
 
-	vkDestroyBuffer(context.device, stagingBuffer, nullptr);
-	vkFreeMemory(context.device, stagingBufferMemory, nullptr);
+		compactVertex.uvs[0] = static_cast<uint16_t>(glm::packHalf1x16(vertex.uvs.x));
+		compactVertex.uvs[1] = static_cast<uint16_t>(glm::packHalf1x16(vertex.uvs.y));
+	}
 }
 
 void DrawModelApp::createIndexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(context.indices[0]) * context.indices.size();
-	void* data; // Allocated memory address.
+	VkDeviceSize bufferSize = 0;
+	StagingRegion staging;
 
-	VkBuffer stagingBuffer{};
-	VkDeviceMemory stagingBufferMemory{};
+	// Every index of a mesh with up to 65536 vertices fits in 16 bits (primitive restart is disabled).
+	if (context.vertices.size() <= 65536)
+	{
+		context.indexType = VK_INDEX_TYPE_UINT16;
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		bufferSize = sizeof(uint16_t) * context.indices.size();
+		staging = context.uploader.allocateStaging(bufferSize);
 
-	vkMapMemory(context.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, context.indices.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(context.device, stagingBufferMemory);
+		uint16_t* indices = static_cast<uint16_t*>(staging.mapped);
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.indexBuffer, context.indexBufferMemory);
+		for (size_t i = 0; i < context.indices.size(); i++)
+		{
+			indices[i] = static_cast<uint16_t>(context.indices[i]);
+		}
+	}
+	else
+	{
+		context.indexType = VK_INDEX_TYPE_UINT32;
+
+		bufferSize = sizeof(uint32_t) * context.indices.size();
+		staging = context.uploader.stage(context.indices.data(), bufferSize);
+	}
 
-	copyBuffer(stagingBuffer, context.indexBuffer, bufferSize);
+	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.indexBuffer, context.indexBufferMemory);
 
-	vkDestroyBuffer(context.device, stagingBuffer, nullptr);
-	vkFreeMemory(context.device, stagingBufferMemory, nullptr);
+	copyBuffer(staging.buffer, staging.offset, context.indexBuffer, bufferSize);
 }
 
 void DrawModelApp::createTextureImage()
 {
-	int texWidth, texHeight, texChannels;
-	void* data;
+	// Precomputed levels are streamed from the texture cache during the first frames, smallest first.
+	if (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED)
+	{
+		context.textureStreamer.init(context.gpu, context.device, context.allocator, context.uploader, TEXTURE_STREAMING_BUDGET, MAX_FRAMES_IN_FLIGHT);
+		context.textureStreamer.load(texturePath, texturePath + ".texcache");
+		context.textureStreamer.update();
+
+		return;
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile source;
+
+	if (!source.open(texturePath))
+	{
+		throw std::runtime_error("Failed to load texture image!");
+	}
 
-	stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	createMipmappedTextureImage(source, startTime);
+}
+
+void DrawModelApp::createMipmappedTextureImage(const MappedFile& source, std::chrono::high_resolution_clock::time_point startTime)
+{
+	int texWidth, texHeight, texChannels;
 
-	context.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.getData()), static_cast<int>(source.getSize()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
 	if (!pixels)
 	{
 		throw std::runtime_error("Failed to load texture image!");
 	}
 
-	VkBuffer stagingBuffer{};
-	VkDeviceMemory stagingBufferMemory{};
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
 
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	context.textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+	context.mipLevels = getMipLevelCount(texWidth, texHeight);
 
-	vkMapMemory(context.device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(context.device, stagingBufferMemory);
+	StagingRegion staging = context.uploader.stage(pixels, imageSize);
 
 	stbi_image_free(pixels);
 
-	createImage(texWidth, texHeight, context.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.textureImage, context.textureImageMemory);
-	transitionImageLayout(context.textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, context.mipLevels);
-	copyBufferToImage(stagingBuffer, context.textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+	bool computeMipmaps = TEXTURE_MIPMAP_SOURCE == MipmapSource::COMPUTE && MipmapGenerator::isSupported(context.gpu);
+
+	if (computeMipmaps)
+	{
+		initMipmapGenerator();
+
+		// Storage images can't be sRGB, the image is written as UNORM and sampled through an sRGB view.
+		createImage(texWidth, texHeight, context.mipLevels, VK_SAMPLE_COUNT_1_BIT, MipmapGenerator::STORAGE_FORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.textureImage, context.textureImageMemory, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
+	}
+	else
+	{
+		createImage(texWidth, texHeight, context.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.textureImage, context.textureImageMemory);
+	}
+
+	transitionImageLayout(context.textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, context.mipLevels);
+	copyBufferToImage(staging.buffer, staging.offset, context.textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
 	// Transitioned to "VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL" while generating mipmaps.
-	// 
-	// transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	if (computeMipmaps)
+	{
+		context.mipmapGenerator.record(context.uploader.getGraphicsCommandBuffer(), context.textureImage, texWidth, texHeight, context.mipLevels, true);
+	}
+	else
+	{
+		generateMipmaps(context.textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, context.mipLevels);
+	}
+
+	logTextureImport(texWidth, texHeight, getEncodedChainSize(texWidth, texHeight, TextureEncoding::RGBA8), computeMipmaps ? "not used (compute mipmaps)" : "not used (blit mipmaps)", 0.0, startTime);
+}
+
+void DrawModelApp::logTextureImport(uint32_t width, uint32_t height, uint64_t textureSize, const char* cacheStatus, double importTime, std::chrono::high_resolution_clock::time_point startTime)
+{
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	uint64_t uncompressedSize = getEncodedChainSize(width, height, TextureEncoding::RGBA8);
 
-	generateMipmaps(context.textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, context.mipLevels);
+	std::cout << "[INFO] TEXTURE LOADED:" << std::endl;
+	std::cout << '\t' << "Source: " << texturePath << " (" << width << "x" << height << ", " << context.mipLevels << " levels)" << std::endl;
+	std::cout << '\t' << "Format: " << getTextureFormatName(context.textureFormat) << ", texture cache: " << cacheStatus << std::endl;
+	std::cout << '\t' << "VRAM: " << textureSize / 1024.0 << " KB, RGBA8 would take " << uncompressedSize / 1024.0 << " KB (saved "
+		<< 100.0 * (1.0 - static_cast<double>(textureSize) / uncompressedSize) << "%)" << std::endl;
+
+	if (importTime > 0.0)
+	{
+		std::cout << '\t' << "Import time: " << importTime << " ms" << std::endl;
+	}
 
-	vkDestroyBuffer(context.device, stagingBuffer, nullptr);
-	vkFreeMemory(context.device, stagingBufferMemory, nullptr);
+	std::cout << '\t' << "Time: " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms" << std::endl;
 }
 
 void DrawModelApp::createTextureImageView()
 {
-	context.textureImageView = createImageView(context.textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, context.mipLevels);
+	if (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED)
+	{
+		return; // Owned by the texture streamer.
+	}
+
+	// BC4 only stores red, single channel textures are read back as gray.
+	VkComponentMapping components{};
+
+	if (context.textureFormat == VK_FORMAT_BC4_UNORM_BLOCK)
+	{
+		components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+	}
+
+	context.textureImageView = createImageView(context.textureImage, context.textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, context.mipLevels, components);
 }
 
 void DrawModelApp::createTextureSampler()
 {
-	VkPhysicalDeviceProperties deviceProperties{};
-
-	vkGetPhysicalDeviceProperties(context.gpu, &deviceProperties);
+	if (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED)
+	{
+		return; // Owned by the texture streamer.
+	}
 
 	VkSamplerCreateInfo samplerCreateInfo{};
 
 	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 
-	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	setSamplerFiltering(context.gpu, context.textureFormat, samplerCreateInfo);
 
 	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 
-	samplerCreateInfo.anisotropyEnable = VK_TRUE;
-	samplerCreateInfo.maxAnisotropy = deviceProperties.limits.maxSamplerAnisotropy;
 	samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
 
 	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
@@ -1707,7 +2564,6 @@ void DrawModelApp::createTextureSampler()
 	samplerCreateInfo.compareEnable = VK_FALSE;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 
-	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerCreateInfo.minLod = 0.0f;
 	samplerCreateInfo.maxLod = static_cast<float>(context.mipLevels);
 	samplerCreateInfo.mipLodBias = 0.0f;
@@ -1730,8 +2586,110 @@ void DrawModelApp::createUniformBuffers()
 	{
 		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, context.uniformBuffers[i], context.uniformBuffersMemory[i]);
 
-		vkMapMemory(context.device, context.uniformBuffersMemory[i], 0, bufferSize, 0, &context.uniformBuffersMapped[i]);
+		context.uniformBuffersMapped[i] = context.uniformBuffersMemory[i].mapped;
+	}
+}
+
+void DrawModelApp::createInstanceBuffers()
+{
+	if (instanceCount == 0)
+	{
+		throw std::runtime_error("Failed to create instance buffers, at least one instance is required!");
+	}
+
+	uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+
+	context.instanceFieldExtent = (gridSide - 1) * MODEL_INSTANCE_SPACING;
+	context.instanceOrigins.resize(instanceCount);
+	context.instanceLods.assign(instanceCount, 0);
+	context.instanceSlots.resize(instanceCount);
+
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		float x = (i % gridSide) * MODEL_INSTANCE_SPACING - 0.5f * context.instanceFieldExtent;
+		float y = (i / gridSide) * MODEL_INSTANCE_SPACING - 0.5f * context.instanceFieldExtent;
+
+		// Golden angle steps, so neighbours never spin in sync. The first instance starts like the single model did.
+		float phase = std::fmod(i * 2.39996323f, glm::two_pi<float>());
+
+		context.instanceOrigins[i] = glm::vec4(x, y, 0.0f, phase);
+	}
+
+	VkDeviceSize bufferSize = sizeof(InstanceData) * instanceCount;
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	vkGetPhysicalDeviceProperties(context.gpu, &deviceProperties);
+
+	// The vertex shader binds every transform at once, the spec only guarantees 128 MB (2M instances).
+	if (bufferSize > deviceProperties.limits.maxStorageBufferRange)
+	{
+		throw std::runtime_error("Failed to create instance buffers, " + std::to_string(instanceCount) + " instances exceed the device \"maxStorageBufferRange\" of "
+			+ std::to_string(deviceProperties.limits.maxStorageBufferRange / sizeof(InstanceData)) + "!");
+	}
+
+	context.instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	context.instanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, context.instanceBuffers[i], context.instanceBuffersMemory[i]);
+	}
+
+	std::cout << "[INFO] MODEL INSTANCES:" << std::endl;
+	std::cout << '\t' << "Count: " << instanceCount << " (" << gridSide << "x" << gridSide << " grid)" << std::endl;
+	std::cout << '\t' << "Transforms: " << bufferSize / 1024.0 << " KB per frame in flight" << std::endl;
+}
+
+void DrawModelApp::createGpuCuller()
+{
+	if (!gpuCulling)
+	{
+		return;
+	}
+
+	if (!GpuCuller::isSupported(context.gpu, instanceCount))
+	{
+		std::cout << "[INFO] GPU CULLING: not supported by the device, instances are drawn without culling." << std::endl;
+
+		return;
+	}
+
+	context.drawRecords.resize(instanceCount);
+
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		GpuCuller::DrawRecord& record = context.drawRecords[i];
+
+		record.indexCount = context.lods[0].indexCount;
+		record.firstIndex = 0;
+		record.vertexOffset = 0;
+		record.transformIndex = i;
+		record.boundingSphere[0] = context.boundingSphere.x;
+		record.boundingSphere[1] = context.boundingSphere.y;
+		record.boundingSphere[2] = context.boundingSphere.z;
+		record.boundingSphere[3] = context.boundingSphere.w;
+	}
+
+	// Meshlets multiply the draw slots by the meshlets of the largest level, large instance counts are culled whole.
+	uint32_t levelMeshletCount = 0;
+
+	for (size_t level = 0; level + 1 < context.lodFirstMeshlets.size(); level++)
+	{
+		levelMeshletCount = std::max(levelMeshletCount, context.lodFirstMeshlets[level + 1] - context.lodFirstMeshlets[level]);
+	}
+
+	uint64_t meshletDrawCount = static_cast<uint64_t>(instanceCount) * levelMeshletCount;
+	std::span<const Meshlet> meshlets;
+
+	if (!context.meshlets.empty() && meshletDrawCount <= MESHLET_CULLING_MAX_DRAWS && GpuCuller::isSupported(context.gpu, meshletDrawCount))
+	{
+		meshlets = context.meshlets;
 	}
+
+	context.gpuCuller.init(context.device, context.allocator, context.uploader, context.pipelineCache, readFile(cullShaderPath), context.drawRecords, context.lods, meshlets,
+		context.uniformBuffers, sizeof(UniformBufferObject), context.instanceBuffers, context.drawIndirectCount);
+
+	context.cullMeshlets = !meshlets.empty();
 }
 
 void DrawModelApp::createDescriptorSetLayout()
@@ -1752,7 +2710,15 @@ void DrawModelApp::createDescriptorSetLayout()
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+	VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+
+	instanceLayoutBinding.binding = 2;
+	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	instanceLayoutBinding.descriptorCount = 1;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, samplerLayoutBinding, instanceLayoutBinding };
 
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
 
@@ -1768,12 +2734,14 @@ void DrawModelApp::createDescriptorSetLayout()
 
 void DrawModelApp::createDescriptorPool()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
 
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
 	VkDescriptorPoolCreateInfo poolCreateInfo{};
 
@@ -1800,6 +2768,7 @@ void DrawModelApp::createDescriptorSets()
 	descriptorSetAllocateInfo.pSetLayouts = layouts.data();
 
 	context.descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	context.descriptorSetTextureViews.resize(MAX_FRAMES_IN_FLIGHT);
 
 	if (vkAllocateDescriptorSets(context.device, &descriptorSetAllocateInfo, context.descriptorSets.data()) != VK_SUCCESS)
 	{
@@ -1814,13 +2783,15 @@ void DrawModelApp::createDescriptorSets()
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
-		VkDescriptorImageInfo imageInfo{};
+		VkDescriptorImageInfo imageInfo = getTextureDescriptorInfo();
 
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = context.textureImageView;
-		imageInfo.sampler = context.textureSampler;
+		VkDescriptorBufferInfo instanceBufferInfo{};
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		instanceBufferInfo.buffer = context.instanceBuffers[i];
+		instanceBufferInfo.offset = 0;
+		instanceBufferInfo.range = sizeof(InstanceData) * instanceCount;
+
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].dstSet = context.descriptorSets[i];
@@ -1838,6 +2809,57 @@ void DrawModelApp::createDescriptorSets()
 		descriptorWrites[1].descriptorCount = 1;
 		descriptorWrites[1].pImageInfo = &imageInfo;
 
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].dstSet = context.descriptorSets[i];
+		descriptorWrites[2].dstBinding = 2;
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].pBufferInfo = &instanceBufferInfo;
+
 		vkUpdateDescriptorSets(context.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+		context.descriptorSetTextureViews[i] = imageInfo.imageView;
+	}
+}
+
+VkDescriptorImageInfo DrawModelApp::getTextureDescriptorInfo()
+{
+	if (TEXTURE_MIPMAP_SOURCE == MipmapSource::PRECOMPUTED)
+	{
+		return context.textureStreamer.getDescriptorImageInfo();
+	}
+
+	VkDescriptorImageInfo imageInfo{};
+
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = context.textureImageView;
+	imageInfo.sampler = context.textureSampler;
+
+	return imageInfo;
+}
+
+void DrawModelApp::updateTextureDescriptor(uint32_t currentFrame)
+{
+	// The set isn't in use anymore, the fence of its last submission was waited on.
+	VkDescriptorImageInfo imageInfo = getTextureDescriptorInfo();
+
+	if (context.descriptorSetTextureViews[currentFrame] == imageInfo.imageView)
+	{
+		return;
 	}
+
+	VkWriteDescriptorSet descriptorWrite{};
+
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = context.descriptorSets[currentFrame];
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &descriptorWrite, 0, nullptr);
+
+	context.descriptorSetTextureViews[currentFrame] = imageInfo.imageView;
 }
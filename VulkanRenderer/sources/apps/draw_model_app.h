@@ -2,8 +2,6 @@
 
 #include "../application.h"
 
-#include <tol/tiny_obj_loader.h>
-
 class DrawModelApp : public Application
 {
 public:
@@ -15,6 +13,23 @@ public:
 	void update(float deltaTime);
 	void render(GLFWwindow* window, float deltaTime);
 
+	GpuProfiler& getProfiler() { return context.profiler; }
+
+	// Times the blit chain against the compute mipmap generator over a range of texture sizes, must be called after "setup".
+	void runMipmapBenchmark();
+
+	// Renders headless frames of the still model until the texture is fully resident, then returns the read back pixels
+	// (BGRA8) of the last one. Requires headless rendering with readback.
+	std::vector<uint8_t> captureFrame();
+
+	VertexLayout vertexLayout = MODEL_VERTEX_LAYOUT; // Must be set before "setup".
+	uint32_t instanceCount = MODEL_INSTANCE_COUNT;   // Must be set before "setup".
+	bool gpuCulling = MODEL_GPU_CULLING;             // Must be set before "setup".
+
+	// Renders headless frames and checks every visible count read back from the culling pass against the CPU reference,
+	// evaluated on the same uniform and instance data. Requires GPU culling, returns false on a mismatch.
+	bool verifyCulling(uint32_t frameCount);
+
 	struct Context
 	{
 		VkInstance instance = VK_NULL_HANDLE;
@@ -23,6 +38,15 @@ public:
 
 		VkDevice device = VK_NULL_HANDLE;
 
+		MemoryAllocator allocator;
+		UploadContext uploader;
+		PipelineCache pipelineCache;
+		GpuProfiler profiler;
+		OffscreenTarget offscreenTarget;
+		MipmapGenerator mipmapGenerator;
+		TextureStreamer textureStreamer;
+		GpuCuller gpuCuller;
+
 		VkQueue graphicsQueue = VK_NULL_HANDLE;
 		VkQueue presentQueue = VK_NULL_HANDLE;
 
@@ -36,11 +60,11 @@ public:
 		VkExtent2D swapChainExtent;
 
 		VkImage colorImage = VK_NULL_HANDLE;
-		VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+		MemoryAllocation colorImageMemory;
 		VkImageView colorImageView = VK_NULL_HANDLE;
 
 		VkImage depthImage = VK_NULL_HANDLE;
-		VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+		MemoryAllocation depthImageMemory;
 		VkImageView depthImageView = VK_NULL_HANDLE;
 
 		std::vector<VkFramebuffer> swapChainFramebuffers;
@@ -62,38 +86,76 @@ public:
 		VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
 
 		VkBuffer vertexBuffer = VK_NULL_HANDLE;
-		VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+		MemoryAllocation vertexBufferMemory;
 		VkBuffer indexBuffer = VK_NULL_HANDLE;
-		VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+		MemoryAllocation indexBufferMemory;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+		glm::vec3 positionScale = glm::vec3(1.0f); // Dequantization of compact vertex positions.
+		glm::vec3 positionOffset = glm::vec3(0.0f);
 
 		std::vector<VkBuffer> uniformBuffers;
-		std::vector<VkDeviceMemory> uniformBuffersMemory;
+		std::vector<MemoryAllocation> uniformBuffersMemory;
 		std::vector<void*> uniformBuffersMapped;
 
+		std::vector<VkBuffer> instanceBuffers; // Host visible, rewritten every frame through the persistent mapping.
+		std::vector<MemoryAllocation> instanceBuffersMemory;
+		std::vector<glm::vec4> instanceOrigins; // Grid position (xyz) and spin phase (w) of every instance.
+		float instanceFieldExtent = 0.0f;       // Distance between the first and the last grid column.
+
+		// Without GPU culling, levels are selected on the CPU and the instances grouped by level in the instance buffer.
+		std::vector<uint32_t> instanceLods; // Level every instance was last drawn at.
+		std::vector<uint32_t> instanceSlots;
+		std::array<uint32_t, GpuCuller::MAX_LEVELS_OF_DETAIL> lodInstanceCounts{};
+
+		std::array<uint64_t, GpuCuller::MAX_LEVELS_OF_DETAIL> lodTriangleSums{}; // Drawn at every level, over "lodStatisticsFrames".
+		uint64_t lodStatisticsFrames = 0;
+		uint64_t lodStatisticsCullingFrame = 0; // Last culling statistics added to the sums.
+
+		std::vector<GpuCuller::DrawRecord> drawRecords; // One per instance, kept for the CPU reference.
+		bool drawIndirectCount = false;                 // VK_KHR_draw_indirect_count is enabled.
+		bool cullMeshlets = false;                      // The culler draws "meshlets" instead of whole instances.
+
 		VkImage textureImage = VK_NULL_HANDLE;
-		VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+		MemoryAllocation textureImageMemory;
 		VkImageView textureImageView = VK_NULL_HANDLE;
 		VkSampler textureSampler = VK_NULL_HANDLE;
+		VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
 
 		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 		std::vector<VkDescriptorSet> descriptorSets;
+		std::vector<VkImageView> descriptorSetTextureViews; // What each set was last written with, streamed views change.
 
 		VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
+		MeshCache meshCache;
+
+		std::span<const Vertex> vertices; // Views into "meshCache".
+		std::span<const uint32_t> indices; // Every level of detail, back to back.
+		std::span<const MeshLod> lods;     // Level 0 is the full mesh.
+
+		glm::vec4 boundingSphere = glm::vec4(0.0f); // Object space center (xyz) and radius (w) of the full mesh.
+
+		std::vector<Meshlet> meshlets;          // Index ranges of "indices", built on load for every level in order.
+		std::vector<uint32_t> lodFirstMeshlets; // First meshlet of every level, followed by the meshlet count.
 
 		uint32_t mipLevels;
 
 		uint32_t currentFrame = 0;
+
+		float currentTime = 0.0f;
 	};
 
 private:
 	Context context;
 
+	float cameraFieldOfView = glm::radians(45.0f); // Vertical.
+
 	std::string vertShaderPath = "sources/shaders/draw_model_vs.spv";
 	std::string fragShaderPath = "sources/shaders/draw_model_fs.spv";
+	std::string mipmapShaderPath = "sources/shaders/generate_mipmaps_cs.spv";
+	std::string cullShaderPath = "sources/shaders/gpu_cull_cs.spv";
 	std::string texturePath = "resources/models/viking_room/viking_room.png";
 	std::string modelPath = "resources/models/viking_room/viking_room.obj";
 
@@ -109,7 +171,7 @@ private:
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, const VkComponentMapping& components = {});
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat();
@@ -120,19 +182,29 @@ private:
 
 	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+	void copyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size);
+	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory, VkImageCreateFlags flags = 0);
+	void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+	void copyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height);
 	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void initMipmapGenerator();
 
 	void updateUniformBuffer(uint32_t currentImage);
+	void updateInstanceBuffer(uint32_t currentImage);
+
+	glm::vec3 getCameraPosition();
+	float getLodErrorScale();
+	void logLodStatistics();
+
+	void createMipmappedTextureImage(const MappedFile& source, std::chrono::high_resolution_clock::time_point startTime);
+	void logTextureImport(uint32_t width, uint32_t height, uint64_t textureSize, const char* cacheStatus, double importTime, std::chrono::high_resolution_clock::time_point startTime);
 
 	void loadModel();
+	void importModel(const MappedFile& source, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+	void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	void generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+	void buildModelMeshlets();
 
 	void createInstance();
 	void createDebugMessenger();
@@ -158,6 +230,7 @@ private:
 	void createSyncObjects();
 
 	void createVertexBuffer();
+	void quantizeVertices(CompactVertex* compactVertices);
 	void createIndexBuffer();
 
 	void createTextureImage();
@@ -165,7 +238,12 @@ private:
 	void createTextureSampler();
 
 	void createUniformBuffers();
+	void createInstanceBuffers();
+	void createGpuCuller();
 	void createDescriptorSetLayout();
 	void createDescriptorPool();
 	void createDescriptorSets();
+
+	VkDescriptorImageInfo getTextureDescriptorInfo();
+	void updateTextureDescriptor(uint32_t currentFrame);
 };
@@ -32,29 +32,69 @@ void DrawParticlesApp::setup(GLFWwindow* window)
 
 	createFramebuffers();
 
-	createShaderStorageBuffers();
+	selectParticleChunks();
+	createParticleBuffers();
 	createUniformBuffers();
 
 	createDescriptorPool();
 	createDescriptorSets();
 
 	createSyncObjects();
+
+	// Every upload recorded above goes out in a single submission, frames are ordered behind it on the graphics queue.
+	context.uploader.submit();
 }
 
 void DrawParticlesApp::cleanUp()
 {
 	vkDeviceWaitIdle(context.device);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < STATE_COUNT; i++)
 	{
-		vkDestroyBuffer(context.device, context.shaderStorageBuffers[i], nullptr);
-		vkFreeMemory(context.device, context.shaderStorageBuffersMemory[i], nullptr);
+		vkDestroyBuffer(context.device, context.particlePositionBuffers[i], nullptr);
+		context.allocator.free(context.particlePositionBuffersMemory[i]);
+
+		vkDestroyBuffer(context.device, context.particleVelocityBuffers[i], nullptr);
+		context.allocator.free(context.particleVelocityBuffersMemory[i]);
+
+		vkDestroyBuffer(context.device, context.particleAliveBuffers[i], nullptr);
+		context.allocator.free(context.particleAliveBuffersMemory[i]);
 	}
 
+	vkDestroyBuffer(context.device, context.particleColorBuffer, nullptr);
+	context.allocator.free(context.particleColorBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleLifetimeBuffer, nullptr);
+	context.allocator.free(context.particleLifetimeBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleDeadBuffer, nullptr);
+	context.allocator.free(context.particleDeadBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleCounterBuffer, nullptr);
+	context.allocator.free(context.particleCounterBufferMemory);
+
+	for (size_t i = 0; i < context.liveCountReadbackBuffers.size(); i++)
+	{
+		vkDestroyBuffer(context.device, context.liveCountReadbackBuffers[i], nullptr);
+		context.allocator.free(context.liveCountReadbackBuffersMemory[i]);
+	}
+
+	vkDestroyBuffer(context.device, context.particleCellCountBuffer, nullptr);
+	context.allocator.free(context.particleCellCountBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleCellRangeBuffer, nullptr);
+	context.allocator.free(context.particleCellRangeBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleRankBuffer, nullptr);
+	context.allocator.free(context.particleRankBufferMemory);
+
+	vkDestroyBuffer(context.device, context.particleSortedBuffer, nullptr);
+	context.allocator.free(context.particleSortedBufferMemory);
+
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		vkDestroyBuffer(context.device, context.uniformBuffers[i], nullptr);
-		vkFreeMemory(context.device, context.uniformBuffersMemory[i], nullptr);
+		context.allocator.free(context.uniformBuffersMemory[i]);
 	}
 
 	if (ENABLE_VALIDATION_LAYERS)
@@ -81,11 +121,11 @@ void DrawParticlesApp::cleanUp()
 
 	vkDestroyImageView(context.device, context.depthImageView, nullptr);
 	vkDestroyImage(context.device, context.depthImage, nullptr);
-	vkFreeMemory(context.device, context.depthImageMemory, nullptr);
+	context.allocator.free(context.depthImageMemory);
 
 	vkDestroyImageView(context.device, context.colorImageView, nullptr);
 	vkDestroyImage(context.device, context.colorImage, nullptr);
-	vkFreeMemory(context.device, context.colorImageMemory, nullptr);
+	context.allocator.free(context.colorImageMemory);
 
 	vkDestroyPipeline(context.device, context.graphicsPipeline, nullptr);
 	vkDestroyPipeline(context.device, context.computePipeline, nullptr);
@@ -104,11 +144,31 @@ void DrawParticlesApp::cleanUp()
 		vkDestroyImageView(context.device, context.swapChainImageViews[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	if (headless.enabled)
+	{
+		context.offscreenTarget.destroy();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	}
+
+	context.uploader.destroy();
+	context.pipelineCache.destroy();
+
+	context.profiler.logStatistics();
+	logParticleBandwidth();
+	context.profiler.destroy();
+
+	context.allocator.logStatistics();
+	context.allocator.destroy();
 
 	vkDestroyDevice(context.device, nullptr);
 
-	vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
+	if (!headless.enabled)
+	{
+		vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
+	}
 
 	vkDestroyInstance(context.instance, nullptr);
 }
@@ -116,6 +176,50 @@ void DrawParticlesApp::cleanUp()
 void DrawParticlesApp::update(float deltaTime)
 {
 	context.currentTime += deltaTime;
+	context.stepAccumulator += deltaTime;
+
+	uint32_t steps = static_cast<uint32_t>(context.stepAccumulator / PARTICLE_TIME_STEP);
+
+	// A long frame (a stall, a window drag) would otherwise ask for more steps than fit in the next one.
+	if (steps > PARTICLE_MAX_SUBSTEPS)
+	{
+		context.droppedSteps += steps - PARTICLE_MAX_SUBSTEPS;
+		context.stepAccumulator -= (steps - PARTICLE_MAX_SUBSTEPS) * PARTICLE_TIME_STEP;
+
+		steps = PARTICLE_MAX_SUBSTEPS;
+	}
+
+	context.stepAccumulator = std::max(context.stepAccumulator - steps * PARTICLE_TIME_STEP, 0.0f);
+
+	// Emission is decided here, the GPU only clamps it to the dead particles left.
+	size_t emitterCount = std::min<size_t>(emitters.size(), MAX_PARTICLE_EMITTERS);
+
+	context.pendingEmissions.assign(steps, {});
+
+	// The first step emits what every emitter keeps alive, so the pool starts as full as it stays.
+	bool firstStep = context.simulatedSteps == 0;
+
+	for (std::array<uint32_t, MAX_PARTICLE_EMITTERS>& emitterEnds : context.pendingEmissions)
+	{
+		uint32_t emitted = 0;
+
+		for (size_t i = 0; i < MAX_PARTICLE_EMITTERS; i++)
+		{
+			if (i < emitterCount)
+			{
+				context.emissionAccumulators[i] += emitters[i].rate * (firstStep ? emitters[i].lifetime : PARTICLE_TIME_STEP);
+
+				uint32_t count = static_cast<uint32_t>(context.emissionAccumulators[i]);
+
+				context.emissionAccumulators[i] -= count;
+				emitted += count;
+			}
+
+			emitterEnds[i] = emitted;
+		}
+
+		firstStep = false;
+	}
 }
 
 void DrawParticlesApp::render(GLFWwindow* window, float deltaTime)
@@ -123,6 +227,18 @@ void DrawParticlesApp::render(GLFWwindow* window, float deltaTime)
 	// Compute submission.
 	vkWaitForFences(context.device, 1, &context.computeSubmitFences[context.currentFrame], VK_TRUE, UINT64_MAX);
 
+	context.uploader.collect();
+	context.profiler.collect(2 * context.currentFrame);
+	collectLiveParticles(context.currentFrame);
+
+	if (profileExportRequested)
+	{
+		context.profiler.exportCsv(GPU_PROFILE_PATH + ".csv");
+		context.profiler.exportJson(GPU_PROFILE_PATH + ".json");
+
+		profileExportRequested = false;
+	}
+
 	updateUniformBuffer(context.currentFrame);
 
 	vkResetFences(context.device, 1, &context.computeSubmitFences[context.currentFrame]);
@@ -147,17 +263,24 @@ void DrawParticlesApp::render(GLFWwindow* window, float deltaTime)
 	// Graphics submission.
 	vkWaitForFences(context.device, 1, &context.graphicsSubmitFences[context.currentFrame], VK_TRUE, UINT64_MAX);
 
-	uint32_t imageIndex;
-	VkResult acquireResult = vkAcquireNextImageKHR(context.device, context.swapChain, UINT64_MAX, context.swapChainAcquireSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+	context.profiler.collect(2 * context.currentFrame + 1);
+	context.offscreenTarget.collect(context.currentFrame);
 
-	if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_SUBOPTIMAL_KHR)
-	{
-		recreateSwapChain(window);
-		return;
-	}
-	else if (acquireResult != VK_SUCCESS)
+	uint32_t imageIndex = context.currentFrame; // Offscreen images rotate with the frames in flight.
+
+	if (!headless.enabled)
 	{
-		throw std::runtime_error("Failed to acquire swap chain image!");
+		VkResult acquireResult = vkAcquireNextImageKHR(context.device, context.swapChain, UINT64_MAX, context.swapChainAcquireSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_SUBOPTIMAL_KHR)
+		{
+			recreateSwapChain(window);
+			return;
+		}
+		else if (acquireResult != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to acquire swap chain image!");
+		}
 	}
 
 	vkResetFences(context.device, 1, &context.graphicsSubmitFences[context.currentFrame]); // Only reset the fence if we are submitting some work...
@@ -167,17 +290,17 @@ void DrawParticlesApp::render(GLFWwindow* window, float deltaTime)
 	recordGraphicsCommandBuffer(context.graphicsCommandBuffers[context.currentFrame], imageIndex);
 
 	VkSemaphore waitSemaphores[] = { context.computeFinishedSemaphores[context.currentFrame], context.swapChainAcquireSemaphores[context.currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
 	VkSubmitInfo graphicsSubmitInfo{};
 
 	graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	graphicsSubmitInfo.waitSemaphoreCount = 2; // Attention to this number.
+	graphicsSubmitInfo.waitSemaphoreCount = headless.enabled ? 1 : 2; // Attention to this number, headless runs only wait on the compute submission.
 	graphicsSubmitInfo.pWaitSemaphores = waitSemaphores;
 	graphicsSubmitInfo.pWaitDstStageMask = waitStages;
 	graphicsSubmitInfo.commandBufferCount = 1;
 	graphicsSubmitInfo.pCommandBuffers = &context.graphicsCommandBuffers[context.currentFrame];
-	graphicsSubmitInfo.signalSemaphoreCount = 1;
+	graphicsSubmitInfo.signalSemaphoreCount = headless.enabled ? 0 : 1;
 	graphicsSubmitInfo.pSignalSemaphores = &context.swapChainReleaseSemaphores[context.currentFrame];
 
 	if (vkQueueSubmit(context.graphicsQueue, 1, &graphicsSubmitInfo, context.graphicsSubmitFences[context.currentFrame]) != VK_SUCCESS)
@@ -185,6 +308,13 @@ void DrawParticlesApp::render(GLFWwindow* window, float deltaTime)
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
 
+	if (headless.enabled)
+	{
+		context.currentFrame = (context.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+		return;
+	}
+
 	VkSwapchainKHR swapChains[] = { context.swapChain };
 
 	VkPresentInfoKHR presentInfo{};
@@ -265,10 +395,16 @@ bool DrawParticlesApp::checkValidationLayerSupport()
 
 std::vector<const char*> DrawParticlesApp::getRequiredInstanceExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// GLFW isn't initialized when rendering headless, and no surface is created.
+	if (!headless.enabled)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -288,7 +424,7 @@ bool DrawParticlesApp::checkDeviceExtensionSupport(VkPhysicalDevice device)
 
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	for (const char* extensionName : DEVICE_EXTENSIONS)
+	for (const char* extensionName : headless.enabled ? HEADLESS_DEVICE_EXTENSIONS : DEVICE_EXTENSIONS)
 	{
 		bool extensionFound = false;
 
@@ -327,7 +463,15 @@ QueueFamilyIndices DrawParticlesApp::findQueueFamilies(VkPhysicalDevice device)
 		const VkQueueFamilyProperties& queueFamily = queueFamilies[i];
 		VkBool32 presentSupport = false;
 
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentSupport);
+		// Nothing is presented when rendering headless, the graphics queue stands in for the present queue.
+		if (headless.enabled)
+		{
+			presentSupport = ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentSupport);
+		}
 
 		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
 		{
@@ -391,9 +535,9 @@ bool DrawParticlesApp::isDeviceSuitable(VkPhysicalDevice device)
 
 	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(device);
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	bool swapChainAdequate = false;
+	bool swapChainAdequate = headless.enabled;
 
-	if (extensionsSupported)
+	if (extensionsSupported && !headless.enabled)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 
@@ -402,7 +546,7 @@ bool DrawParticlesApp::isDeviceSuitable(VkPhysicalDevice device)
 
 	bool suitable = true;
 
-	suitable = suitable && deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+	suitable = suitable && (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || headless.enabled); // Headless runs also accept software devices (e.g. lavapipe).
 	suitable = suitable && deviceFeatures.geometryShader && deviceFeatures.samplerAnisotropy;
 	suitable = suitable && queueFamilyIndices.isComplete();
 	suitable = suitable && extensionsSupported && swapChainAdequate;
@@ -561,7 +705,22 @@ void DrawParticlesApp::cleanUpSwapChain()
 		vkDestroyImageView(context.device, context.swapChainImageViews[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	vkDestroyImageView(context.device, context.depthImageView, nullptr);
+	vkDestroyImage(context.device, context.depthImage, nullptr);
+	context.allocator.free(context.depthImageMemory);
+
+	vkDestroyImageView(context.device, context.colorImageView, nullptr);
+	vkDestroyImage(context.device, context.colorImage, nullptr);
+	context.allocator.free(context.colorImageMemory);
+
+	if (headless.enabled)
+	{
+		context.offscreenTarget.destroy();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(context.device, context.swapChain, nullptr);
+	}
 }
 
 void DrawParticlesApp::recreateSwapChain(GLFWwindow* window)
@@ -600,6 +759,9 @@ void DrawParticlesApp::recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer
 		throw std::runtime_error("Failed to begin recording graphics command buffer!");
 	}
 
+	context.profiler.beginRecording(commandBuffer, 2 * context.currentFrame + 1);
+	context.profiler.beginScope(commandBuffer, "render pass");
+
 	std::array<VkClearValue, 2> clearValues{}; // The order of "clearValues" should be identical to the order of your attachments.
 
 	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -637,14 +799,31 @@ void DrawParticlesApp::recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer
 
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	VkDeviceSize offsets[] = { 0 };
+	// Drawn between the last two steps, by the share of a step already elapsed past the last one.
+	uint32_t lastState = context.particleState;
+	float interpolation = std::min(context.stepAccumulator / PARTICLE_TIME_STEP, 1.0f);
+
+	VkBuffer vertexBuffers[] = { context.particlePositionBuffers[lastState], context.particleColorBuffer, context.particlePositionBuffers[1 - lastState] };
+	VkDeviceSize offsets[] = { 0, 0, 0 };
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 3, vertexBuffers, offsets);
 
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &context.shaderStorageBuffers[context.currentFrame], offsets);
+	// Only the live particles are drawn, listed and counted by the last step. The commands offset the chunk relative indices.
+	vkCmdBindIndexBuffer(commandBuffer, context.particleAliveBuffers[lastState], 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDraw(commandBuffer, particleCount, 1, 0, 0);
+	vkCmdPushConstants(commandBuffer, context.graphicsPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float), &interpolation);
+
+	for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, context.particleCounterBuffer, chunk * COUNTERS_STRIDE + offsetof(ParticleCounters, drawCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
 
 	vkCmdEndRenderPass(commandBuffer);
 
+	context.profiler.endScope(commandBuffer);
+
+	context.offscreenTarget.recordReadback(commandBuffer, imageIndex);
+
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to record graphics command buffer!");
@@ -664,83 +843,190 @@ void DrawParticlesApp::recordComputeCommandBuffer(VkCommandBuffer commandBuffer)
 		throw std::runtime_error("Failed to begin recording compute command buffer!");
 	}
 
+	context.profiler.beginRecording(commandBuffer, 2 * context.currentFrame);
+	context.profiler.beginScope(commandBuffer, "particle dispatch");
+
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, context.computePipeline);
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, context.computePipelineLayout, 0, 1, &context.descriptorSets[context.currentFrame], 0, nullptr);
+	// Every step reads the state the previous one wrote and writes the other one, which the draws of the previous frame
+	// may still read (submissions share the queue, so a barrier orders them). Every pass of a step depends on the last
+	// one, through the lists, the counters or the indirect commands, so the barriers cover all of them.
+	auto recordBarrier = [commandBuffer](VkPipelineStageFlags srcStageMask)
+	{
+		VkMemoryBarrier barrier{};
 
-	vkCmdDispatch(commandBuffer, particleCount / 256, 1, 1);
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	};
+
+	auto recordPass = [&](uint32_t chunk, const ComputePushConstants& pushConstants)
 	{
-		throw std::runtime_error("Failed to record compute command buffer!");
-	}
-}
+		VkDescriptorSet descriptorSet = context.descriptorSets[(STATE_COUNT * context.currentFrame + context.particleState) * context.particleChunkCount + chunk];
 
-VkCommandBuffer DrawParticlesApp::beginSingleTimeCommands()
-{
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, context.computePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBufferAllocateInfo.commandPool = context.commandPool;
-	commandBufferAllocateInfo.commandBufferCount = 1;
+		vkCmdPushConstants(commandBuffer, context.computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+	};
 
-	VkCommandBuffer commandBuffer;
+	VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
-	vkAllocateCommandBuffers(context.device, &commandBufferAllocateInfo, &commandBuffer);
+	for (const std::array<uint32_t, MAX_PARTICLE_EMITTERS>& emitterEnds : context.pendingEmissions)
+	{
+		ComputePushConstants pushConstants{};
 
-	VkCommandBufferBeginInfo beginInfo{};
+		pushConstants.readState = context.particleState;
+		pushConstants.seed = static_cast<uint32_t>(context.simulatedSteps++);
+		pushConstants.interactions = static_cast<uint32_t>(interactions);
 
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		std::copy(emitterEnds.begin(), emitterEnds.end(), pushConstants.emitterEnds);
 
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		recordBarrier(srcStageMask);
 
-	return commandBuffer;
-}
+		srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
-void DrawParticlesApp::endSingleTimeCommands(VkCommandBuffer commandBuffer)
-{
-	vkEndCommandBuffer(commandBuffer);
+		// Passes over the live particles are sized by the last step, through the indirect command.
+		if (interactions == ParticleInteractions::GRID)
+		{
+			context.profiler.beginScope(commandBuffer, "particle grid");
 
-	VkSubmitInfo submitInfo{};
+			for (ComputePass pass : { HASH_PASS, SCAN_PASS, SORT_PASS })
+			{
+				pushConstants.pass = pass;
+
+				for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+				{
+					recordPass(chunk, pushConstants);
+
+					if (pass == SCAN_PASS)
+					{
+						vkCmdDispatch(commandBuffer, 1, 1, 1);
+					}
+					else
+					{
+						vkCmdDispatchIndirect(commandBuffer, context.particleCounterBuffer, chunk * COUNTERS_STRIDE + offsetof(ParticleCounters, dispatchCommand));
+					}
+				}
+
+				recordBarrier(srcStageMask);
+			}
 
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+			context.profiler.endScope(commandBuffer);
+		}
 
-	vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		context.profiler.beginScope(commandBuffer, "particle simulation");
 
-	vkQueueWaitIdle(context.graphicsQueue);
+		pushConstants.pass = SIMULATE_PASS;
 
-	vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
-}
+		for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+		{
+			recordPass(chunk, pushConstants);
 
-uint32_t DrawParticlesApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties memoryProperties{};
+			vkCmdDispatchIndirect(commandBuffer, context.particleCounterBuffer, chunk * COUNTERS_STRIDE + offsetof(ParticleCounters, dispatchCommand));
+		}
 
-	vkGetPhysicalDeviceMemoryProperties(context.gpu, &memoryProperties);
+		context.profiler.endScope(commandBuffer);
 
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-	{
-		if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		recordBarrier(srcStageMask);
+
+		// The emitted particles are shared evenly between the chunks, rounded up, the shader skips the invocations past them.
+		uint32_t emitCount = emitterEnds.back();
+
+		pushConstants.pass = EMIT_PASS;
+
+		for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+		{
+			pushConstants.firstEmitted = chunk * (emitCount / context.particleChunkCount) + std::min(chunk, emitCount % context.particleChunkCount);
+			pushConstants.emitCount = std::min(emitCount / context.particleChunkCount + (chunk < emitCount % context.particleChunkCount ? 1 : 0), context.particleChunkSize);
+
+			if (pushConstants.emitCount == 0)
+			{
+				continue;
+			}
+
+			recordPass(chunk, pushConstants);
+
+			vkCmdDispatch(commandBuffer, (pushConstants.emitCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+		}
+
+		recordBarrier(srcStageMask);
+
+		pushConstants.pass = PREPARE_PASS;
+
+		for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
 		{
-			return i;
+			recordPass(chunk, pushConstants);
+
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
 		}
+
+		context.particleState = 1 - context.particleState;
+	}
+
+	context.simulatedFrames++;
+	context.pendingEmissions.clear();
+
+	context.profiler.endScope(commandBuffer);
+
+	// The live counts the frame draws are copied back, "collectLiveParticles" reads them once the slot's fence signals.
+	VkMemoryBarrier countBarrier{};
+
+	countBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	countBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	countBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &countBarrier, 0, nullptr, 0, nullptr);
+
+	std::vector<VkBufferCopy> copyRegions(context.particleChunkCount);
+
+	for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+	{
+		copyRegions[chunk].srcOffset = chunk * COUNTERS_STRIDE + offsetof(ParticleCounters, drawCommand) + offsetof(VkDrawIndexedIndirectCommand, indexCount);
+		copyRegions[chunk].dstOffset = chunk * sizeof(uint32_t);
+		copyRegions[chunk].size = sizeof(uint32_t);
 	}
 
-	throw std::runtime_error("Failed to find suitable memory type!");
+	vkCmdCopyBuffer(commandBuffer, context.particleCounterBuffer, context.liveCountReadbackBuffers[context.currentFrame], static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+	VkMemoryBarrier readbackBarrier{};
+
+	readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+	context.liveCountsPending[context.currentFrame] = true;
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record compute command buffer!");
+	}
 }
 
-void DrawParticlesApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void DrawParticlesApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory)
 {
 	VkBufferCreateInfo bufferCreateInfo{};
 
 	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferCreateInfo.size = size;
 	bufferCreateInfo.usage = usage;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Upload destinations are written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices = context.uploader.getQueueFamilyIndices();
+
+	if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && context.uploader.hasDedicatedTransferQueue())
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateBuffer(context.device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
 	{
@@ -751,36 +1037,25 @@ void DrawParticlesApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 
 	vkGetBufferMemoryRequirements(context.device, buffer, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAllocateInfo{};
-
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+	bufferMemory = context.allocator.allocate(memoryRequirements, properties, LINEAR_RESOURCE);
 
-	if (vkAllocateMemory(context.device, &memoryAllocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate buffer memory!");
-	}
-
-	vkBindBufferMemory(context.device, buffer, bufferMemory, 0);
+	vkBindBufferMemory(context.device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void DrawParticlesApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void DrawParticlesApp::copyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = context.uploader.getTransferCommandBuffer();
 
 	VkBufferCopy copyRegion{};
 
-	copyRegion.srcOffset = 0;
+	copyRegion.srcOffset = srcOffset;
 	copyRegion.dstOffset = 0;
 	copyRegion.size = size;
 
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	endSingleTimeCommands(commandBuffer);
 }
 
-void DrawParticlesApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+void DrawParticlesApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory)
 {
 	VkImageCreateInfo imageCreateInfo{};
 
@@ -796,7 +1071,20 @@ void DrawParticlesApp::createImage(uint32_t width, uint32_t height, uint32_t mip
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCreateInfo.usage = usage;
 	imageCreateInfo.samples = numSamples;
-	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Upload destinations are written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices = context.uploader.getQueueFamilyIndices();
+
+	if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && context.uploader.hasDedicatedTransferQueue())
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	if (vkCreateImage(context.device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
 	{
@@ -807,27 +1095,85 @@ void DrawParticlesApp::createImage(uint32_t width, uint32_t height, uint32_t mip
 
 	vkGetImageMemoryRequirements(context.device, image, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAllocateInfo{};
+	// Render targets are recreated along with the swap chain, so they get their own memory instead of fragmenting the pools.
+	bool dedicated = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+	AllocationType type = tiling == VK_IMAGE_TILING_OPTIMAL ? OPTIMAL_RESOURCE : LINEAR_RESOURCE;
+
+	imageMemory = context.allocator.allocate(memoryRequirements, properties, type, dedicated);
+
+	vkBindImageMemory(context.device, image, imageMemory.memory, imageMemory.offset);
+}
+
+void DrawParticlesApp::updateUniformBuffer(uint32_t currentImage)
+{
+	ParticleUniformBufferObject ubo{};
+
+	ubo.emitterCount = static_cast<uint32_t>(std::min<size_t>(emitters.size(), MAX_PARTICLE_EMITTERS));
+	ubo.timeStep = PARTICLE_TIME_STEP;
+	ubo.aspectRatio = static_cast<float>(context.swapChainExtent.height) / context.swapChainExtent.width;
+	ubo.interactionRadius = PARTICLE_INTERACTION_RADIUS;
+	ubo.separation = PARTICLE_SEPARATION;
+	ubo.cohesion = PARTICLE_COHESION;
+	ubo.gridSize = context.particleGridSize;
+	ubo.cellCount = context.particleCellCount;
+
+	std::copy(emitters.begin(), emitters.begin() + ubo.emitterCount, ubo.emitters);
+
+	memcpy(context.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+}
+
+void DrawParticlesApp::collectLiveParticles(uint32_t frame)
+{
+	if (!context.liveCountsPending[frame])
+	{
+		return;
+	}
 
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+	const uint32_t* liveCounts = static_cast<const uint32_t*>(context.liveCountReadbackBuffersMemory[frame].mapped);
 
-	if (vkAllocateMemory(context.device, &memoryAllocateInfo, nullptr, &imageMemory) != VK_SUCCESS)
+	for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
 	{
-		throw std::runtime_error("Failed to allocate image memory!");
+		context.liveParticleSum += liveCounts[chunk];
 	}
 
-	vkBindImageMemory(context.device, image, imageMemory, 0);
+	context.collectedFrames++;
+	context.liveCountsPending[frame] = false;
 }
 
-void DrawParticlesApp::updateUniformBuffer(uint32_t currentImage)
+void DrawParticlesApp::logParticleBandwidth() const
 {
-	UniformBufferObject ubo{};
+	// Bytes every live particle moves per frame, the dead ones cost nothing. The simulation reads and writes positions,
+	// velocities, lifetimes and list entries, the draw reads positions of both steps, colors and list entries. The grid
+	// reads list entries and positions twice, writes and reads ranks, counts the cell and reads its range, then writes
+	// the sorted position (the neighbour reads mostly hit the caches, they aren't counted). The rates use the mean live
+	// count of the collected frames, a full pool until one was collected.
+	const double gridBytes = 2.0 * (sizeof(ParticleStreams::Index) + sizeof(ParticleStreams::Position)) + 4.0 * sizeof(uint32_t) + sizeof(ParticleStreams::Position);
+	const double simulatedBytes = 2.0 * (sizeof(ParticleStreams::Position) + sizeof(ParticleStreams::Velocity) + sizeof(ParticleStreams::Lifetime) + sizeof(ParticleStreams::Index))
+		+ (interactions == ParticleInteractions::GRID ? gridBytes : 0.0);
+	const double drawnBytes = 2.0 * sizeof(ParticleStreams::Position) + sizeof(ParticleStreams::Color) + sizeof(ParticleStreams::Index);
 
-	ubo.time = context.currentTime * 0.5f;
+	double stepsPerFrame = static_cast<double>(context.simulatedSteps) / std::max<uint64_t>(context.simulatedFrames, 1);
+	double liveParticles = context.collectedFrames > 0 ? static_cast<double>(context.liveParticleSum) / context.collectedFrames : static_cast<double>(particleCount);
 
-	memcpy(context.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	std::cout << "[INFO] PARTICLE BANDWIDTH:" << std::endl;
+	std::cout << '\t' << "Particles: " << liveParticles << " live on average, " << particleCount << " at most" << std::endl;
+	std::cout << '\t' << "Steps: " << context.simulatedSteps << " (" << stepsPerFrame << " per frame), " << context.droppedSteps << " dropped" << std::endl;
+
+	for (const GpuProfiler::ScopeStatistics& scope : context.profiler.getStatistics())
+	{
+		bool simulation = scope.name == "particle dispatch";
+
+		if ((!simulation && scope.name != "render pass") || scope.avgTime <= 0.0)
+		{
+			continue;
+		}
+
+		double bytes = simulation ? simulatedBytes : drawnBytes;
+		double frameBytes = bytes * liveParticles * (simulation ? stepsPerFrame : 1.0);
+
+		std::cout << '\t' << (simulation ? "Simulation: " : "Draw: ") << bytes << " B per live particle" << (simulation ? " and step, " : ", ")
+			<< frameBytes / (scope.avgTime * 1e6) << " GB/s in " << scope.avgTime << " ms" << std::endl;
+	}
 }
 
 void DrawParticlesApp::createInstance()
@@ -902,6 +1248,11 @@ void DrawParticlesApp::createDebugMessenger()
 
 void DrawParticlesApp::createSurface(GLFWwindow* window)
 {
+	if (headless.enabled)
+	{
+		return;
+	}
+
 	if (glfwCreateWindowSurface(context.instance, window, nullptr, &context.surface) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create window surface!");
@@ -945,7 +1296,8 @@ void DrawParticlesApp::createLogicalDevice()
 	float queuePriority = 1.0f;
 
 	QueueFamilyIndices indices = findQueueFamilies(context.gpu);
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value() };
+	uint32_t transferFamily = UploadContext::findTransferQueueFamily(context.gpu, indices.graphicsAndComputeFamily.value());
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsAndComputeFamily.value(), indices.presentFamily.value(), transferFamily };
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -971,8 +1323,10 @@ void DrawParticlesApp::createLogicalDevice()
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-	deviceCreateInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	const std::vector<const char*>& deviceExtensions = headless.enabled ? HEADLESS_DEVICE_EXTENSIONS : DEVICE_EXTENSIONS;
+
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -992,10 +1346,29 @@ void DrawParticlesApp::createLogicalDevice()
 	vkGetDeviceQueue(context.device, indices.graphicsAndComputeFamily.value(), 0, &context.graphicsQueue);
 	vkGetDeviceQueue(context.device, indices.graphicsAndComputeFamily.value(), 0, &context.computeQueue); // Using same index as graphics queue.
 	vkGetDeviceQueue(context.device, indices.presentFamily.value(), 0, &context.presentQueue);
+
+	context.allocator.init(context.gpu, context.device);
+	context.uploader.init(context.device, context.allocator, indices.graphicsAndComputeFamily.value(), transferFamily, STAGING_RING_SIZE);
+	context.pipelineCache.init(context.gpu, context.device, PIPELINE_CACHE_PATH);
+
+	// One profiler slot per frame in flight for each of the compute and graphics command buffers.
+	context.profiler.init(context.gpu, context.device, indices.graphicsAndComputeFamily.value(), 2 * MAX_FRAMES_IN_FLIGHT);
 }
 
 void DrawParticlesApp::createSwapChain(GLFWwindow* window)
 {
+	if (headless.enabled)
+	{
+		context.swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
+		context.swapChainExtent = { headless.width, headless.height };
+
+		context.offscreenTarget.init(context.device, context.allocator, context.swapChainImageFormat, context.swapChainExtent, MAX_FRAMES_IN_FLIGHT, headless.readback);
+
+		context.swapChainImages = context.offscreenTarget.getImages();
+
+		return;
+	}
+
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(context.gpu);
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -1102,7 +1475,7 @@ void DrawParticlesApp::createRenderPass()
 	colorAttachmentResolveDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolveDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolveDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolveDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachmentResolveDescription.finalLayout = headless.enabled ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentReference{};
 
@@ -1180,14 +1553,14 @@ void DrawParticlesApp::createGraphicsPipeline()
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	VkVertexInputBindingDescription bindingDescription = Particle::getBindingDescription();
-	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = Particle::getAttributeDescriptions();
+	std::array<VkVertexInputBindingDescription, 3> bindingDescriptions = ParticleStreams::getBindingDescriptions();
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = ParticleStreams::getAttributeDescriptions();
 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateInfo{};
 
 	vertexInputStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputStateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputStateInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputStateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+	vertexInputStateInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputStateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	vertexInputStateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -1271,13 +1644,19 @@ void DrawParticlesApp::createGraphicsPipeline()
 	dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
 	dynamicStateInfo.pDynamicStates = dynamicStates.data();
 
+	VkPushConstantRange pushConstantRange{};
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(float); // Interpolation between the last two steps.
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = 1;
 	pipelineLayoutCreateInfo.pSetLayouts = &context.descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(context.device, &pipelineLayoutCreateInfo, nullptr, &context.graphicsPipelineLayout) != VK_SUCCESS)
 	{
@@ -1303,11 +1682,17 @@ void DrawParticlesApp::createGraphicsPipeline()
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineCreateInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &context.graphicsPipeline) != VK_SUCCESS)
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(context.device, context.pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &context.graphicsPipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
 
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	context.pipelineCache.reportCreationTime("DrawParticlesApp graphics pipeline", std::chrono::duration<double, std::milli>(endTime - startTime).count());
+
 	vkDestroyShaderModule(context.device, fragShaderModule, nullptr);
 	vkDestroyShaderModule(context.device, vertShaderModule, nullptr);
 }
@@ -1326,13 +1711,19 @@ void DrawParticlesApp::createComputePipeline()
 	compShaderStageInfo.pName = "main";
 	compShaderStageInfo.pSpecializationInfo = nullptr;
 
+	VkPushConstantRange pushConstantRange{};
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ComputePushConstants);
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = 1;
 	pipelineLayoutCreateInfo.pSetLayouts = &context.descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(context.device, &pipelineLayoutCreateInfo, nullptr, &context.computePipelineLayout) != VK_SUCCESS)
 	{
@@ -1345,11 +1736,17 @@ void DrawParticlesApp::createComputePipeline()
 	pipelineCreateInfo.layout = context.computePipelineLayout;
 	pipelineCreateInfo.stage = compShaderStageInfo;
 
-	if (vkCreateComputePipelines(context.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &context.computePipeline) != VK_SUCCESS)
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateComputePipelines(context.device, context.pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &context.computePipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create compute pipeline!");
 	}
 
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	context.pipelineCache.reportCreationTime("DrawParticlesApp compute pipeline", std::chrono::duration<double, std::milli>(endTime - startTime).count());
+
 	vkDestroyShaderModule(context.device, compShaderModule, nullptr);
 }
 
@@ -1492,56 +1889,172 @@ void DrawParticlesApp::createSyncObjects()
 	}
 }
 
-void DrawParticlesApp::createShaderStorageBuffers()
+void DrawParticlesApp::selectParticleChunks()
+{
+	if (particleCount == 0)
+	{
+		throw std::runtime_error("Failed to create particles, the particle count is zero!");
+	}
+
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	vkGetPhysicalDeviceProperties(context.gpu, &deviceProperties);
+
+	if (deviceProperties.limits.maxPerStageDescriptorStorageBuffers < STORAGE_BINDING_COUNT)
+	{
+		throw std::runtime_error("Failed to create particles, the compute stage can't bind enough storage buffers!");
+	}
+
+	// Whole workgroups per chunk, which also keeps the chunk offsets aligned to "minStorageBufferOffsetAlignment" (256 bytes at most).
+	uint64_t maxChunkSize = std::min<uint64_t>(deviceProperties.limits.maxStorageBufferRange / sizeof(ParticleStreams::Position), uint64_t(deviceProperties.limits.maxComputeWorkGroupCount[0]) * PARTICLE_WORKGROUP_SIZE);
+
+	maxChunkSize = std::min<uint64_t>(maxChunkSize, uint64_t(deviceProperties.limits.maxDrawIndexedIndexValue) + 1);
+
+	maxChunkSize -= maxChunkSize % PARTICLE_WORKGROUP_SIZE;
+
+	if (maxChunkSize == 0)
+	{
+		throw std::runtime_error("Failed to fit a particle workgroup in a storage buffer binding!");
+	}
+
+	// Chunks of even size, so the padding stays below a workgroup per chunk.
+	uint64_t chunkCount = (particleCount + maxChunkSize - 1) / maxChunkSize;
+	uint64_t chunkSize = (particleCount + chunkCount - 1) / chunkCount;
+
+	chunkSize = (chunkSize + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE * PARTICLE_WORKGROUP_SIZE;
+
+	context.particleChunkSize = static_cast<uint32_t>(chunkSize);
+	context.particleChunkCount = static_cast<uint32_t>(chunkCount);
+
+	// The grid covers the screen with cells as large as the interaction radius. The scan splits the cells evenly
+	// between the invocations of its workgroup, so they are padded to a whole one.
+	uint32_t gridSize = static_cast<uint32_t>(std::ceil(2.0f / PARTICLE_INTERACTION_RADIUS));
+
+	context.particleGridSize = gridSize;
+	context.particleCellCount = (gridSize * gridSize + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE * PARTICLE_WORKGROUP_SIZE;
+
+	std::cout << "[INFO] PARTICLES:" << std::endl;
+	std::cout << '\t' << "Capacity: " << particleCount << std::endl;
+	std::cout << '\t' << "Chunks: " << context.particleChunkCount << " of " << context.particleChunkSize << " particles at most" << std::endl;
+	std::cout << '\t' << "Buffer size: " << chunkCount * chunkSize * (sizeof(ParticleStreams::Position) + sizeof(ParticleStreams::Velocity) + sizeof(ParticleStreams::Index)) / (1024 * 1024) << " MiB per state" << std::endl;
+	std::cout << '\t' << "Grid: " << gridSize << "x" << gridSize << " cells per chunk, " << static_cast<double>(particleCount) / (chunkCount * gridSize * gridSize) << " particles per cell in a full pool" << std::endl;
+}
+
+void DrawParticlesApp::createParticleBuffers()
 {
-	float width = static_cast<float>(context.swapChainExtent.width);
-	float height = static_cast<float>(context.swapChainExtent.height);
-	std::default_random_engine rndEngine(static_cast<unsigned>(time(nullptr)));
+	if (emitters.empty())
+	{
+		ParticleEmitter emitter;
+
+		emitter.rate = particleCount / emitter.lifetime;
+
+		emitters.push_back(emitter);
+	}
+
+	if (emitters.size() > MAX_PARTICLE_EMITTERS)
+	{
+		throw std::runtime_error("Failed to create particles, too many emitters!");
+	}
+
+	std::default_random_engine rndEngine(randomSeed.value_or(static_cast<unsigned>(time(nullptr))));
 	std::uniform_real_distribution<float> rndDistribution(0.0f, 1.0f);
 
-	std::vector<Particle> particles(particleCount);
+	// Colors belong to the slots, every particle emitted in one gets its color. Everything else starts dead.
+	std::vector<ParticleStreams::Color> colors(particleCount);
 
-	for (auto& particle : particles)
+	for (ParticleStreams::Color& color : colors)
 	{
-		float r = 0.25f * std::sqrt(rndDistribution(rndEngine));
-		float theta = rndDistribution(rndEngine) * 2.0f * 3.14159265358979323846f;
-		float x = r * std::cos(theta) * height / width;
-		float y = r * std::sin(theta);
+		color = glm::vec4(rndDistribution(rndEngine), rndDistribution(rndEngine), rndDistribution(rndEngine), 1.0f);
+	}
+
+	// The simulated streams are padded to a whole number of chunks, see "selectParticleChunks".
+	VkDeviceSize paddedCount = static_cast<VkDeviceSize>(context.particleChunkSize) * context.particleChunkCount;
+
+	std::vector<ParticleStreams::Index> deadIndices(paddedCount);
+	std::vector<uint8_t> counters(context.particleChunkCount * COUNTERS_STRIDE, 0);
 
-		particle.position = glm::vec2(x, y);
-		particle.velocity = glm::normalize(glm::vec2(x, y)) * 0.00025f;
-		particle.color = glm::vec4(rndDistribution(rndEngine), rndDistribution(rndEngine), rndDistribution(rndEngine), 1.0f);
+	for (uint32_t chunk = 0; chunk < context.particleChunkCount; chunk++)
+	{
+		uint32_t firstParticle = chunk * context.particleChunkSize;
+		uint32_t chunkParticleCount = std::min(context.particleChunkSize, particleCount - firstParticle);
+
+		// Popped from the top, so the first slots are used first.
+		for (uint32_t i = 0; i < chunkParticleCount; i++)
+		{
+			deadIndices[firstParticle + i] = chunkParticleCount - 1 - i;
+		}
+
+		ParticleCounters chunkCounters{};
+
+		chunkCounters.deadCount = static_cast<int32_t>(chunkParticleCount);
+		chunkCounters.dispatchCommand = { 0, 1, 1 };
+		chunkCounters.drawCommand.indexCount = 0;
+		chunkCounters.drawCommand.instanceCount = 1;
+		chunkCounters.drawCommand.firstIndex = firstParticle;
+		chunkCounters.drawCommand.vertexOffset = static_cast<int32_t>(firstParticle);
+		chunkCounters.drawCommand.firstInstance = 0;
+
+		memcpy(counters.data() + chunk * COUNTERS_STRIDE, &chunkCounters, sizeof(ParticleCounters));
 	}
 
-	VkDeviceSize bufferSize = sizeof(Particle) * particleCount;
-	void* data;  // Allocated memory address.
+	VkDeviceSize colorsSize = sizeof(ParticleStreams::Color) * particleCount;
+	VkDeviceSize deadIndicesSize = sizeof(ParticleStreams::Index) * paddedCount;
+	VkDeviceSize countersSize = counters.size();
 
-	VkBuffer stagingBuffer{};
-	VkDeviceMemory stagingBufferMemory{};
-	
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	StagingRegion colorsStaging = context.uploader.stage(colors.data(), colorsSize);
+	StagingRegion deadIndicesStaging = context.uploader.stage(deadIndices.data(), deadIndicesSize);
+	StagingRegion countersStaging = context.uploader.stage(counters.data(), countersSize);
+
+	// Counts start cleared, then the scan clears them every step.
+	VkDeviceSize cellCountsSize = sizeof(uint32_t) * context.particleCellCount * context.particleChunkCount;
+
+	std::vector<uint32_t> cellCounts(context.particleCellCount * context.particleChunkCount, 0);
+
+	StagingRegion cellCountsStaging = context.uploader.stage(cellCounts.data(), cellCountsSize);
+
+	context.particlePositionBuffers.resize(STATE_COUNT);
+	context.particlePositionBuffersMemory.resize(STATE_COUNT);
+	context.particleVelocityBuffers.resize(STATE_COUNT);
+	context.particleVelocityBuffersMemory.resize(STATE_COUNT);
+	context.particleAliveBuffers.resize(STATE_COUNT);
+	context.particleAliveBuffersMemory.resize(STATE_COUNT);
+
+	for (size_t i = 0; i < STATE_COUNT; i++)
+	{
+		createBuffer(sizeof(ParticleStreams::Position) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particlePositionBuffers[i], context.particlePositionBuffersMemory[i]);
+		createBuffer(sizeof(ParticleStreams::Velocity) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleVelocityBuffers[i], context.particleVelocityBuffersMemory[i]);
+		createBuffer(sizeof(ParticleStreams::Index) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleAliveBuffers[i], context.particleAliveBuffersMemory[i]);
+	}
+
+	createBuffer(sizeof(ParticleStreams::Lifetime) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleLifetimeBuffer, context.particleLifetimeBufferMemory);
 
-	vkMapMemory(context.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, particles.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(context.device, stagingBufferMemory);
+	createBuffer(colorsSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleColorBuffer, context.particleColorBufferMemory);
+	createBuffer(deadIndicesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleDeadBuffer, context.particleDeadBufferMemory);
+	createBuffer(countersSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleCounterBuffer, context.particleCounterBufferMemory);
 
-	context.shaderStorageBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	context.shaderStorageBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	context.liveCountReadbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	context.liveCountReadbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	context.liveCountsPending.assign(MAX_FRAMES_IN_FLIGHT, false);
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.shaderStorageBuffers[i], context.shaderStorageBuffersMemory[i]);
-		
-		copyBuffer(stagingBuffer, context.shaderStorageBuffers[i], bufferSize);
+		createBuffer(sizeof(uint32_t) * context.particleChunkCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, context.liveCountReadbackBuffers[i], context.liveCountReadbackBuffersMemory[i]);
 	}
 
-	vkDestroyBuffer(context.device, stagingBuffer, nullptr);
-	vkFreeMemory(context.device, stagingBufferMemory, nullptr);
+	createBuffer(cellCountsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleCellCountBuffer, context.particleCellCountBufferMemory);
+	createBuffer(2 * cellCountsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleCellRangeBuffer, context.particleCellRangeBufferMemory);
+	createBuffer(sizeof(uint32_t) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleRankBuffer, context.particleRankBufferMemory);
+	createBuffer(sizeof(ParticleStreams::Position) * paddedCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context.particleSortedBuffer, context.particleSortedBufferMemory);
+
+	copyBuffer(colorsStaging.buffer, colorsStaging.offset, context.particleColorBuffer, colorsSize);
+	copyBuffer(deadIndicesStaging.buffer, deadIndicesStaging.offset, context.particleDeadBuffer, deadIndicesSize);
+	copyBuffer(countersStaging.buffer, countersStaging.offset, context.particleCounterBuffer, countersSize);
+	copyBuffer(cellCountsStaging.buffer, cellCountsStaging.offset, context.particleCellCountBuffer, cellCountsSize);
 }
 
 void DrawParticlesApp::createUniformBuffers()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkDeviceSize bufferSize = sizeof(ParticleUniformBufferObject);
 
 	context.uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 	context.uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1551,37 +2064,23 @@ void DrawParticlesApp::createUniformBuffers()
 	{
 		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, context.uniformBuffers[i], context.uniformBuffersMemory[i]);
 
-		vkMapMemory(context.device, context.uniformBuffersMemory[i], 0, bufferSize, 0, &context.uniformBuffersMapped[i]);
+		context.uniformBuffersMapped[i] = context.uniformBuffersMemory[i].mapped;
 	}
 }
 
 void DrawParticlesApp::createDescriptorSetLayout()
 {
-	VkDescriptorSetLayoutBinding uboLayoutBinding{};
-
-	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-	uboLayoutBinding.pImmutableSamplers = nullptr;
-
-	VkDescriptorSetLayoutBinding ssboInLayoutBinding{};
-
-	ssboInLayoutBinding.binding = 1;
-	ssboInLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	ssboInLayoutBinding.descriptorCount = 1;
-	ssboInLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-	ssboInLayoutBinding.pImmutableSamplers = nullptr;
-
-	VkDescriptorSetLayoutBinding ssboOutLayoutBinding{};
-
-	ssboOutLayoutBinding.binding = 2;
-	ssboOutLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	ssboOutLayoutBinding.descriptorCount = 1;
-	ssboOutLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-	ssboOutLayoutBinding.pImmutableSamplers = nullptr;
+	// The uniform buffer, then the storage buffers, see the particle compute shader.
+	std::array<VkDescriptorSetLayoutBinding, 1 + STORAGE_BINDING_COUNT> bindings{};
 
-	std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, ssboInLayoutBinding, ssboOutLayoutBinding };
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
 
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
 
@@ -1597,19 +2096,21 @@ void DrawParticlesApp::createDescriptorSetLayout()
 
 void DrawParticlesApp::createDescriptorPool()
 {
+	uint32_t setCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * STATE_COUNT * context.particleChunkCount;
+
 	std::array<VkDescriptorPoolSize, 2> poolSizes{};
 
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[0].descriptorCount = setCount;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+	poolSizes[1].descriptorCount = setCount * STORAGE_BINDING_COUNT;
 
 	VkDescriptorPoolCreateInfo poolCreateInfo{};
 
 	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolCreateInfo.pPoolSizes = poolSizes.data();
-	poolCreateInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolCreateInfo.maxSets = setCount;
 
 	if (vkCreateDescriptorPool(context.device, &poolCreateInfo, nullptr, &context.descriptorPool) != VK_SUCCESS)
 	{
@@ -1619,67 +2120,81 @@ void DrawParticlesApp::createDescriptorPool()
 
 void DrawParticlesApp::createDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, context.descriptorSetLayout);
+	uint32_t setCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * STATE_COUNT * context.particleChunkCount;
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, context.descriptorSetLayout);
 
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
 
 	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	descriptorSetAllocateInfo.descriptorPool = context.descriptorPool;
-	descriptorSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	descriptorSetAllocateInfo.descriptorSetCount = setCount;
 	descriptorSetAllocateInfo.pSetLayouts = layouts.data();
 
-	context.descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	context.descriptorSets.resize(setCount);
 
 	if (vkAllocateDescriptorSets(context.device, &descriptorSetAllocateInfo, context.descriptorSets.data()) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (uint32_t i = 0; i < setCount; i++)
 	{
-		VkDescriptorBufferInfo uniformBufferInfo{};
-
-		uniformBufferInfo.buffer = context.uniformBuffers[i];
-		uniformBufferInfo.offset = 0;
-		uniformBufferInfo.range = sizeof(UniformBufferObject);
-
-		VkDescriptorBufferInfo storageBufferInfoLastFrame{};
-
-		storageBufferInfoLastFrame.buffer = context.shaderStorageBuffers[(i - 1) % MAX_FRAMES_IN_FLIGHT];
-		storageBufferInfoLastFrame.offset = 0;
-		storageBufferInfoLastFrame.range = sizeof(Particle) * particleCount;
-
-		VkDescriptorBufferInfo storageBufferInfoCurrentFrame{};
-
-		storageBufferInfoCurrentFrame.buffer = context.shaderStorageBuffers[i];
-		storageBufferInfoCurrentFrame.offset = 0;
-		storageBufferInfoCurrentFrame.range = sizeof(Particle) * particleCount;
-
-		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
-
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = context.descriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &uniformBufferInfo;
-
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = context.descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pBufferInfo = &storageBufferInfoLastFrame;
-
-		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[2].dstSet = context.descriptorSets[i];
-		descriptorWrites[2].dstBinding = 2;
-		descriptorWrites[2].dstArrayElement = 0;
-		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		descriptorWrites[2].descriptorCount = 1;
-		descriptorWrites[2].pBufferInfo = &storageBufferInfoCurrentFrame;
+		uint32_t chunk = i % context.particleChunkCount;
+		uint32_t readState = i / context.particleChunkCount % STATE_COUNT, writtenState = (readState + 1) % STATE_COUNT;
+		uint32_t frame = i / context.particleChunkCount / STATE_COUNT;
+
+		// Every stream is bound over the particles of the chunk only.
+		auto chunkRange = [this, chunk](VkDescriptorBufferInfo& bufferInfo, VkBuffer buffer, VkDeviceSize elementSize)
+		{
+			bufferInfo.buffer = buffer;
+			bufferInfo.offset = elementSize * chunk * context.particleChunkSize;
+			bufferInfo.range = elementSize * context.particleChunkSize;
+		};
+
+		std::array<VkDescriptorBufferInfo, 1 + STORAGE_BINDING_COUNT> bufferInfos{};
+
+		bufferInfos[0].buffer = context.uniformBuffers[frame];
+		bufferInfos[0].offset = 0;
+		bufferInfos[0].range = sizeof(ParticleUniformBufferObject);
+
+		chunkRange(bufferInfos[1], context.particlePositionBuffers[readState], sizeof(ParticleStreams::Position));
+		chunkRange(bufferInfos[2], context.particleVelocityBuffers[readState], sizeof(ParticleStreams::Velocity));
+		chunkRange(bufferInfos[3], context.particlePositionBuffers[writtenState], sizeof(ParticleStreams::Position));
+		chunkRange(bufferInfos[4], context.particleVelocityBuffers[writtenState], sizeof(ParticleStreams::Velocity));
+		chunkRange(bufferInfos[5], context.particleLifetimeBuffer, sizeof(ParticleStreams::Lifetime));
+		chunkRange(bufferInfos[6], context.particleAliveBuffers[readState], sizeof(ParticleStreams::Index));
+		chunkRange(bufferInfos[7], context.particleAliveBuffers[writtenState], sizeof(ParticleStreams::Index));
+		chunkRange(bufferInfos[8], context.particleDeadBuffer, sizeof(ParticleStreams::Index));
+
+		bufferInfos[9].buffer = context.particleCounterBuffer;
+		bufferInfos[9].offset = chunk * COUNTERS_STRIDE;
+		bufferInfos[9].range = sizeof(ParticleCounters);
+
+		// A whole grid per chunk, aligned since the cells are padded to whole workgroups.
+		bufferInfos[10].buffer = context.particleCellCountBuffer;
+		bufferInfos[10].offset = sizeof(uint32_t) * chunk * context.particleCellCount;
+		bufferInfos[10].range = sizeof(uint32_t) * context.particleCellCount;
+
+		bufferInfos[11].buffer = context.particleCellRangeBuffer;
+		bufferInfos[11].offset = 2 * sizeof(uint32_t) * chunk * context.particleCellCount;
+		bufferInfos[11].range = 2 * sizeof(uint32_t) * context.particleCellCount;
+
+		chunkRange(bufferInfos[12], context.particleRankBuffer, sizeof(uint32_t));
+		chunkRange(bufferInfos[13], context.particleSortedBuffer, sizeof(ParticleStreams::Position));
+
+		std::array<VkWriteDescriptorSet, 1 + STORAGE_BINDING_COUNT> descriptorWrites{};
+
+		for (uint32_t j = 0; j < descriptorWrites.size(); j++)
+		{
+			descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[j].dstSet = context.descriptorSets[i];
+			descriptorWrites[j].dstBinding = j;
+			descriptorWrites[j].dstArrayElement = 0;
+			descriptorWrites[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[j].descriptorCount = 1;
+			descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+		}
 
 		vkUpdateDescriptorSets(context.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
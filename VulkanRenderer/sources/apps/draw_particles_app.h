@@ -13,6 +13,15 @@ public:
 	void update(float deltaTime);
 	void render(GLFWwindow* window, float deltaTime);
 
+	GpuProfiler& getProfiler() { return context.profiler; }
+
+	uint32_t particleCount = PARTICLE_COUNT; // Must be set before "setup".
+
+	// Read every frame, at most MAX_PARTICLE_EMITTERS. Left empty, "setup" adds one at the center filling the pool.
+	std::vector<ParticleEmitter> emitters;
+
+	ParticleInteractions interactions = PARTICLE_INTERACTIONS; // Read every frame.
+
 	struct Context
 	{
 		VkInstance instance = VK_NULL_HANDLE;
@@ -21,6 +30,12 @@ public:
 
 		VkDevice device = VK_NULL_HANDLE;
 
+		MemoryAllocator allocator;
+		UploadContext uploader;
+		PipelineCache pipelineCache;
+		GpuProfiler profiler;
+		OffscreenTarget offscreenTarget;
+
 		VkQueue graphicsQueue = VK_NULL_HANDLE;
 		VkQueue computeQueue = VK_NULL_HANDLE;
 		VkQueue presentQueue = VK_NULL_HANDLE;
@@ -35,11 +50,11 @@ public:
 		VkExtent2D swapChainExtent;
 
 		VkImage colorImage = VK_NULL_HANDLE;
-		VkDeviceMemory colorImageMemory = VK_NULL_HANDLE;
+		MemoryAllocation colorImageMemory;
 		VkImageView colorImageView = VK_NULL_HANDLE;
 
 		VkImage depthImage = VK_NULL_HANDLE;
-		VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+		MemoryAllocation depthImageMemory;
 		VkImageView depthImageView = VK_NULL_HANDLE;
 
 		std::vector<VkFramebuffer> swapChainFramebuffers;
@@ -66,16 +81,62 @@ public:
 
 		VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
 
-		std::vector<VkBuffer> shaderStorageBuffers;
-		std::vector<VkDeviceMemory> shaderStorageBuffersMemory;
+		// Simulation states, indexed by "particleState" for the last step and by the other index for the step before.
+		std::vector<VkBuffer> particlePositionBuffers;
+		std::vector<MemoryAllocation> particlePositionBuffersMemory;
+
+		std::vector<VkBuffer> particleVelocityBuffers;
+		std::vector<MemoryAllocation> particleVelocityBuffersMemory;
+
+		std::vector<VkBuffer> particleAliveBuffers; // Live particles of every state, also the index buffers of the draws.
+		std::vector<MemoryAllocation> particleAliveBuffersMemory;
+
+		VkBuffer particleColorBuffer = VK_NULL_HANDLE;
+		MemoryAllocation particleColorBufferMemory;
+
+		VkBuffer particleLifetimeBuffer = VK_NULL_HANDLE; // Seconds left to live.
+		MemoryAllocation particleLifetimeBufferMemory;
+
+		VkBuffer particleDeadBuffer = VK_NULL_HANDLE; // Stack of the dead particles.
+		MemoryAllocation particleDeadBufferMemory;
+
+		VkBuffer particleCounterBuffer = VK_NULL_HANDLE; // A "ParticleCounters" per chunk.
+		MemoryAllocation particleCounterBufferMemory;
+
+		// Host visible copies of the live count of every chunk, per frame in flight, written once the frame's steps ran.
+		std::vector<VkBuffer> liveCountReadbackBuffers;
+		std::vector<MemoryAllocation> liveCountReadbackBuffersMemory;
+		std::vector<bool> liveCountsPending;
+
+		// Uniform grid of the neighbour search, rebuilt every step, a whole grid per chunk.
+		VkBuffer particleCellCountBuffer = VK_NULL_HANDLE; // Particles hashed into every cell, cleared once scanned.
+		MemoryAllocation particleCellCountBufferMemory;
+
+		VkBuffer particleCellRangeBuffer = VK_NULL_HANDLE; // First and past the last sorted particle of every cell.
+		MemoryAllocation particleCellRangeBufferMemory;
+
+		VkBuffer particleRankBuffer = VK_NULL_HANDLE; // Of every live particle within its cell, in the order of the read list.
+		MemoryAllocation particleRankBufferMemory;
+
+		VkBuffer particleSortedBuffer = VK_NULL_HANDLE; // Positions of the live particles, sorted by cell.
+		MemoryAllocation particleSortedBufferMemory;
+
+		uint32_t particleGridSize = 0;
+		uint32_t particleCellCount = 0;
+
+		// The pool is split into chunks, each one with its own lists and counters, indexing its particles from its first
+		// one. So no binding exceeds "maxStorageBufferRange", no dispatch exceeds "maxComputeWorkGroupCount" and no index
+		// exceeds "maxDrawIndexedIndexValue". The buffers are padded to a whole number of chunks.
+		uint32_t particleChunkSize = 0;
+		uint32_t particleChunkCount = 0;
 
 		std::vector<VkBuffer> uniformBuffers;
-		std::vector<VkDeviceMemory> uniformBuffersMemory;
+		std::vector<MemoryAllocation> uniformBuffersMemory;
 		std::vector<void*> uniformBuffersMapped;
 
 		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-		std::vector<VkDescriptorSet> descriptorSets;
+		std::vector<VkDescriptorSet> descriptorSets; // Per frame in flight, read state and chunk, in that order.
 
 		VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -84,6 +145,21 @@ public:
 		uint32_t currentFrame = 0;
 
 		float currentTime = 0.0f;
+
+		// Fixed time step simulation, "update" turns the elapsed time into steps and the next compute recording runs them.
+		float stepAccumulator = 0.0f; // Time not simulated yet, less than a step once the pending steps run.
+		uint32_t particleState = 0;
+
+		// Particles every pending step emits up to every emitter, included.
+		std::vector<std::array<uint32_t, MAX_PARTICLE_EMITTERS>> pendingEmissions;
+		std::array<float, MAX_PARTICLE_EMITTERS> emissionAccumulators = {}; // Fractions of particles left to emit.
+
+		uint64_t simulatedSteps = 0;
+		uint64_t droppedSteps = 0; // Past "PARTICLE_MAX_SUBSTEPS" in a frame.
+		uint64_t simulatedFrames = 0;
+
+		uint64_t liveParticleSum = 0; // Over the collected frames.
+		uint64_t collectedFrames = 0;
 	};
 
 private:
@@ -93,7 +169,49 @@ private:
 	std::string fragShaderPath = "sources/shaders/draw_particles_fs.spv";
 	std::string compShaderPath = "sources/shaders/draw_particles_cs.spv";
 
-	uint32_t particleCount = 8192;
+	static const uint32_t STATE_COUNT = 2; // The last simulation step and the one before.
+
+	// Passes of the particle compute shader, every step runs them in order over every chunk, the first three only with
+	// the grid. They counting sort the live particles by cell.
+	enum ComputePass : uint32_t
+	{
+		HASH_PASS,     // Counts the live particles of every cell, ranking each of them within its cell.
+		SCAN_PASS,     // Turns the counts into the ranges of the cells (a single workgroup), and clears them.
+		SORT_PASS,     // Copies the position of every live particle to the range of its cell.
+		SIMULATE_PASS, // Over the live particles of the read state, kills or moves them to the written state.
+		EMIT_PASS,     // Pops dead particles and spawns them live in the written state.
+		PREPARE_PASS   // Turns the live count into the indirect commands, and clears the count of the read state.
+	};
+
+	// Matches the push constants of the particle compute shader.
+	struct ComputePushConstants
+	{
+		uint32_t pass;
+		uint32_t readState;
+
+		uint32_t firstEmitted; // Of the chunk, among the particles the step emits.
+		uint32_t emitCount;    // By the chunk.
+		uint32_t seed;
+		uint32_t interactions; // A "ParticleInteractions".
+
+		uint32_t emitterEnds[MAX_PARTICLE_EMITTERS]; // Particles the step emits up to every emitter, included.
+	};
+
+	// Matches the std430 counters of the particle compute shader.
+	struct ParticleCounters
+	{
+		uint32_t aliveCounts[STATE_COUNT];
+		int32_t deadCount;
+		uint32_t padding;
+
+		VkDispatchIndirectCommand dispatchCommand; // Simulates the live particles of the last step.
+		uint32_t padding1;
+
+		VkDrawIndexedIndirectCommand drawCommand; // Draws them.
+	};
+
+	static const VkDeviceSize COUNTERS_STRIDE = 256; // Keeps every chunk's counters aligned to "minStorageBufferOffsetAlignment".
+	static const uint32_t STORAGE_BINDING_COUNT = 13;
 
 	void logExtensionSupport();
 	bool checkValidationLayerSupport();
@@ -119,15 +237,15 @@ private:
 	void recordGraphicsCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 	void recordComputeCommandBuffer(VkCommandBuffer commandBuffer);
 
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+	void copyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size);
+	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory);
 
 	void updateUniformBuffer(uint32_t currentImage);
 
+	void collectLiveParticles(uint32_t frame);
+	void logParticleBandwidth() const;
+
 	void createInstance();
 	void createDebugMessenger();
 	void createSurface(GLFWwindow* window);
@@ -153,7 +271,8 @@ private:
 
 	void createSyncObjects();
 
-	void createShaderStorageBuffers();
+	void selectParticleChunks();
+	void createParticleBuffers();
 	void createUniformBuffers();
 	void createDescriptorSetLayout();
 	void createDescriptorPool();
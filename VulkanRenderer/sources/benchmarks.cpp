@@ -0,0 +1,439 @@
+#include "benchmarks.h"
+
+#include "application.h"
+
+#include <tol/tiny_obj_loader.h>
+
+#include <cmath>
+#include <iomanip>
+#include <unordered_map>
+
+static_assert(sizeof(VertexKey) == sizeof(tinyobj::index_t));
+
+static Vertex makeVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
+{
+	Vertex vertex{};
+
+	vertex.position = {
+		attrib.vertices[3 * index.vertex_index + 0],
+		attrib.vertices[3 * index.vertex_index + 1],
+		attrib.vertices[3 * index.vertex_index + 2]
+	};
+
+	vertex.color = { 1.0f, 1.0f, 1.0f };
+
+	vertex.uvs = {
+		attrib.texcoords[2 * index.texcoord_index + 0],
+		1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+	};
+
+	return vertex;
+}
+
+static double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point startTime)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+void generateGridModel(const std::string& path, uint32_t resolution)
+{
+	std::ofstream output(path, std::ios::trunc);
+
+	if (!output.is_open())
+	{
+		throw std::runtime_error("Failed to open file!");
+	}
+
+	uint32_t side = resolution + 1;
+
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			output << "v " << float(x) / resolution - 0.5f << ' ' << float(y) / resolution - 0.5f << " 0\n";
+		}
+	}
+
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			output << "vt " << float(x) / resolution << ' ' << float(y) / resolution << '\n';
+		}
+	}
+
+	output << "vn 0 0 1\n";
+
+	for (uint32_t y = 0; y < resolution; y++)
+	{
+		for (uint32_t x = 0; x < resolution; x++)
+		{
+			// OBJ indices are one based.
+			uint32_t a = y * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+
+			output << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 " << d << '/' << d << "/1\n";
+			output << "f " << a << '/' << a << "/1 " << d << '/' << d << "/1 " << c << '/' << c << "/1\n";
+		}
+	}
+
+	if (!output.good())
+	{
+		throw std::runtime_error("Failed to write file!");
+	}
+
+	std::cout << "[INFO] GRID MODEL WRITTEN:" << std::endl;
+	std::cout << '\t' << "Path: " << path << std::endl;
+	std::cout << '\t' << "Triangles: " << 2ull * resolution * resolution << std::endl;
+}
+
+void runDedupBenchmark(const std::string& path)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string error;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, path.c_str()))
+	{
+		throw std::runtime_error(error);
+	}
+
+	std::vector<VertexKey> keys;
+
+	for (const auto& shape : shapes)
+	{
+		keys.insert(keys.end(), reinterpret_cast<const VertexKey*>(shape.mesh.indices.data()), reinterpret_cast<const VertexKey*>(shape.mesh.indices.data() + shape.mesh.indices.size()));
+	}
+
+	std::cout << "[INFO] DEDUP BENCHMARK:" << std::endl;
+	std::cout << '\t' << "Source: " << path << std::endl;
+	std::cout << '\t' << "Triangles: " << keys.size() / 3 << std::endl;
+
+	// Reference, the original per-corner deduplication by value.
+	std::vector<Vertex> referenceVertices;
+	std::vector<uint32_t> referenceIndices;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+
+	for (const auto& shape : shapes)
+	{
+		for (const auto& index : shape.mesh.indices)
+		{
+			Vertex vertex = makeVertex(attrib, index);
+
+			if (uniqueVertices.count(vertex) == 0)
+			{
+				uniqueVertices[vertex] = static_cast<uint32_t>(referenceVertices.size());
+
+				referenceVertices.push_back(vertex);
+			}
+
+			referenceIndices.push_back(uniqueVertices[vertex]);
+		}
+	}
+
+	double referenceTime = elapsedMilliseconds(startTime);
+
+	std::cout << '\t' << "unordered_map: " << referenceTime << " ms (" << referenceVertices.size() << " vertices)" << std::endl;
+
+	uint32_t threadCounts[] = { 1, getWorkerThreadCount() };
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices, firstCorners, remap;
+
+		startTime = std::chrono::high_resolution_clock::now();
+
+		deduplicateVertexKeys(keys, threadCount, indices, firstCorners);
+
+		vertices.resize(firstCorners.size());
+
+		for (size_t i = 0; i < firstCorners.size(); i++)
+		{
+			vertices[i] = makeVertex(attrib, reinterpret_cast<const tinyobj::index_t&>(keys[firstCorners[i]]));
+		}
+
+		vertices.resize(deduplicateVertexValues(reinterpret_cast<float*>(vertices.data()), vertices.size(), sizeof(Vertex) / sizeof(float), remap));
+
+		for (uint32_t& index : indices)
+		{
+			index = remap[index];
+		}
+
+		double time = elapsedMilliseconds(startTime);
+		bool identical = vertices == referenceVertices && indices == referenceIndices;
+
+		std::cout << '\t' << "Index tuple (" << threadCount << (threadCount == 1 ? " thread): " : " threads): ") << time << " ms, "
+			<< referenceTime / time << "x, " << (identical ? "identical" : "MISMATCH") << std::endl;
+	}
+}
+
+void runObjParserBenchmark(const std::string& path)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string error;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, path.c_str()))
+	{
+		throw std::runtime_error(error);
+	}
+
+	double referenceTime = elapsedMilliseconds(startTime);
+
+	std::vector<VertexKey> keys;
+
+	for (const auto& shape : shapes)
+	{
+		keys.insert(keys.end(), reinterpret_cast<const VertexKey*>(shape.mesh.indices.data()), reinterpret_cast<const VertexKey*>(shape.mesh.indices.data() + shape.mesh.indices.size()));
+	}
+
+	MappedFile source;
+
+	if (!source.open(path))
+	{
+		throw std::runtime_error("Failed to open model file!");
+	}
+
+	std::cout << "[INFO] OBJ PARSER BENCHMARK:" << std::endl;
+	std::cout << '\t' << "Source: " << path << " (" << source.getSize() / (1024.0 * 1024.0) << " MB)" << std::endl;
+	std::cout << '\t' << "Triangles: " << keys.size() / 3 << std::endl;
+	std::cout << '\t' << "tinyobj: " << referenceTime << " ms" << std::endl;
+
+	uint32_t threadCounts[] = { 1, getWorkerThreadCount() };
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		ObjMesh mesh;
+
+		startTime = std::chrono::high_resolution_clock::now();
+
+		parseObj(source.getData(), source.getSize(), threadCount, mesh);
+
+		double time = elapsedMilliseconds(startTime);
+		bool identical = mesh.positions == attrib.vertices && mesh.normals == attrib.normals && mesh.texcoords == attrib.texcoords
+			&& mesh.corners.size() == keys.size() && memcmp(mesh.corners.data(), keys.data(), keys.size() * sizeof(VertexKey)) == 0;
+
+		std::cout << '\t' << "Chunked (" << threadCount << (threadCount == 1 ? " thread): " : " threads): ") << time << " ms, "
+			<< referenceTime / time << "x, " << (identical ? "identical" : "MISMATCH") << std::endl;
+	}
+}
+
+FrameTimeStatistics computeFrameTimeStatistics(std::vector<double> samples)
+{
+	FrameTimeStatistics statistics;
+
+	if (samples.empty())
+	{
+		return statistics;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	auto percentile = [&samples](double fraction)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(samples.size() * fraction));
+
+		return samples[std::max<size_t>(rank, 1) - 1];
+	};
+
+	double sum = 0.0;
+
+	for (double sample : samples)
+	{
+		sum += sample;
+	}
+
+	statistics.mean = sum / samples.size();
+	statistics.p50 = percentile(0.50);
+	statistics.p95 = percentile(0.95);
+	statistics.p99 = percentile(0.99);
+	statistics.max = samples.back();
+
+	return statistics;
+}
+
+static void writeFrameTimeStatistics(std::ostream& output, const char* name, size_t sampleCount, const FrameTimeStatistics& statistics)
+{
+	output << "\t\"" << name << "\": { \"samples\": " << sampleCount << ", \"meanMs\": " << statistics.mean << ", \"p50Ms\": " << statistics.p50
+		<< ", \"p95Ms\": " << statistics.p95 << ", \"p99Ms\": " << statistics.p99 << ", \"maxMs\": " << statistics.max << " }";
+}
+
+void writeFrameBenchmarkReport(const std::string& path, const FrameBenchmarkResult& result)
+{
+	FrameTimeStatistics cpuStatistics = computeFrameTimeStatistics(result.cpuFrameTimes);
+	FrameTimeStatistics gpuStatistics = computeFrameTimeStatistics(result.gpuFrameTimes);
+
+	std::cout << "[INFO] FRAME BENCHMARK:" << std::endl;
+	std::cout << '\t' << "App: " << result.appName << (result.headless ? " (headless)" : "") << std::endl;
+
+	if (result.instanceCount > 1)
+	{
+		std::cout << '\t' << "Instances: " << result.instanceCount << std::endl;
+	}
+
+	if (result.particleCount > 0)
+	{
+		std::cout << '\t' << "Particles: " << result.particleCount << (result.particleInteractions.empty() ? "" : ", " + result.particleInteractions + " interactions") << std::endl;
+	}
+
+	std::cout << '\t' << "Frames: " << result.warmupFrames << " warm-up, " << result.cpuFrameTimes.size() << " measured" << std::endl;
+	std::cout << '\t' << "Startup time: " << result.startupTime << " ms" << std::endl;
+	std::cout << '\t' << "CPU frame time: mean " << cpuStatistics.mean << " ms, p50 " << cpuStatistics.p50 << " ms, p95 " << cpuStatistics.p95
+		<< " ms, p99 " << cpuStatistics.p99 << " ms, max " << cpuStatistics.max << " ms" << std::endl;
+
+	if (!result.gpuFrameTimes.empty())
+	{
+		std::cout << '\t' << "GPU frame time: mean " << gpuStatistics.mean << " ms, p50 " << gpuStatistics.p50 << " ms, p95 " << gpuStatistics.p95
+			<< " ms, p99 " << gpuStatistics.p99 << " ms, max " << gpuStatistics.max << " ms" << std::endl;
+	}
+
+	if (path.empty())
+	{
+		return;
+	}
+
+	std::ofstream output(path, std::ios::trunc);
+
+	output << std::setprecision(9);
+	output << "{\n";
+	output << "\t\"app\": \"" << result.appName << "\",\n";
+	output << "\t\"seed\": " << result.seed << ",\n";
+	output << "\t\"timeStep\": " << result.timeStep << ",\n";
+	output << "\t\"warmupFrames\": " << result.warmupFrames << ",\n";
+	output << "\t\"headless\": " << (result.headless ? "true" : "false") << ",\n";
+	output << "\t\"width\": " << result.width << ",\n";
+	output << "\t\"height\": " << result.height << ",\n";
+	output << "\t\"instances\": " << result.instanceCount << ",\n";
+	output << "\t\"particles\": " << result.particleCount << ",\n";
+	output << "\t\"particleInteractions\": \"" << result.particleInteractions << "\",\n";
+	output << "\t\"startupMs\": " << result.startupTime << ",\n";
+
+	writeFrameTimeStatistics(output, "cpuFrameTime", result.cpuFrameTimes.size(), cpuStatistics);
+	output << ",\n";
+	writeFrameTimeStatistics(output, "gpuFrameTime", result.gpuFrameTimes.size(), gpuStatistics);
+	output << "\n}\n";
+
+	if (output.good())
+	{
+		std::cout << '\t' << "Report: " << path << std::endl;
+	}
+	else
+	{
+		std::cerr << "[WARNING] Failed to write benchmark report to \"" << path << "\"." << std::endl;
+	}
+}
+
+void writeSweepBenchmarkReport(const std::string& path, const std::string& parameterName, const std::vector<uint32_t>& parameterValues, const std::vector<FrameBenchmarkResult>& results)
+{
+	std::cout << "[INFO] SWEEP BENCHMARK (" << parameterName << "):" << std::endl;
+
+	std::ofstream output(path, std::ios::trunc);
+
+	output << std::setprecision(9);
+	output << "{\n";
+	output << "\t\"parameter\": \"" << parameterName << "\",\n";
+	output << "\t\"runs\": [\n";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const FrameBenchmarkResult& result = results[i];
+
+		FrameTimeStatistics cpuStatistics = computeFrameTimeStatistics(result.cpuFrameTimes);
+		FrameTimeStatistics gpuStatistics = computeFrameTimeStatistics(result.gpuFrameTimes);
+
+		std::cout << '\t' << parameterName << " " << parameterValues[i] << (result.particleInteractions.empty() ? "" : " (" + result.particleInteractions + ")") << ": CPU mean " << cpuStatistics.mean << " ms, p95 " << cpuStatistics.p95 << " ms";
+
+		if (!result.gpuFrameTimes.empty())
+		{
+			std::cout << " | GPU mean " << gpuStatistics.mean << " ms, p95 " << gpuStatistics.p95 << " ms";
+		}
+
+		for (const auto& [name, time] : result.gpuScopeTimes)
+		{
+			std::cout << " | " << name << " " << time << " ms";
+		}
+
+		std::cout << std::endl;
+
+		output << "\t{\n";
+		output << "\t\t\"" << parameterName << "\": " << parameterValues[i] << ",\n";
+		output << "\t\t\"app\": \"" << result.appName << "\",\n";
+		output << "\t\t\"particleInteractions\": \"" << result.particleInteractions << "\",\n";
+		output << "\t\t\"headless\": " << (result.headless ? "true" : "false") << ",\n";
+		output << "\t\t\"startupMs\": " << result.startupTime << ",\n";
+
+		output << "\t\t\"gpuScopeMeanMs\": {";
+
+		for (size_t j = 0; j < result.gpuScopeTimes.size(); j++)
+		{
+			output << (j > 0 ? ", " : " ") << "\"" << result.gpuScopeTimes[j].first << "\": " << result.gpuScopeTimes[j].second;
+		}
+
+		output << " },\n";
+
+		output << '\t';
+		writeFrameTimeStatistics(output, "cpuFrameTime", result.cpuFrameTimes.size(), cpuStatistics);
+		output << ",\n\t";
+		writeFrameTimeStatistics(output, "gpuFrameTime", result.gpuFrameTimes.size(), gpuStatistics);
+		output << "\n\t}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	output << "\t]\n}\n";
+
+	if (output.good())
+	{
+		std::cout << '\t' << "Report: " << path << std::endl;
+	}
+	else
+	{
+		std::cerr << "[WARNING] Failed to write benchmark report to \"" << path << "\"." << std::endl;
+	}
+}
+
+ImageDifference compareImages(const std::vector<uint8_t>& first, const std::vector<uint8_t>& second, uint32_t tolerance)
+{
+	if (first.size() != second.size() || first.size() % 4 != 0)
+	{
+		throw std::runtime_error("Compared images don't have the same size!");
+	}
+
+	ImageDifference difference;
+
+	size_t pixelCount = first.size() / 4;
+	size_t differingPixels = 0;
+	double squaredError = 0.0;
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint32_t pixelDifference = 0;
+
+		for (size_t channel = 0; channel < 3; channel++)
+		{
+			int channelDifference = std::abs(static_cast<int>(first[i * 4 + channel]) - static_cast<int>(second[i * 4 + channel]));
+
+			pixelDifference = std::max(pixelDifference, static_cast<uint32_t>(channelDifference));
+			squaredError += static_cast<double>(channelDifference) * channelDifference;
+		}
+
+		difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+
+		if (pixelDifference > tolerance)
+		{
+			differingPixels++;
+		}
+	}
+
+	double meanSquaredError = squaredError / std::max<size_t>(pixelCount * 3, 1);
+
+	difference.differingPixels = 100.0 * differingPixels / std::max<size_t>(pixelCount, 1);
+	difference.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+
+	return difference;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Writes a "resolution" x "resolution" quad grid as an OBJ file (two triangles per quad), used to
+// produce arbitrarily large models for the benchmarks.
+void generateGridModel(const std::string& path, uint32_t resolution);
+
+// Loads an OBJ file and times the original per-corner "std::unordered_map" deduplication against the
+// index tuple deduplication, serial and sharded, checking that all of them produce the same buffers.
+void runDedupBenchmark(const std::string& path);
+
+// Times "tinyobj::LoadObj" against the chunked parser with one and with every worker thread, checking
+// that they produce the same attributes and corners.
+void runObjParserBenchmark(const std::string& path);
+
+struct FrameTimeStatistics
+{
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+// Nearest rank percentiles, all zeros for no samples.
+FrameTimeStatistics computeFrameTimeStatistics(std::vector<double> samples);
+
+// Everything a frame benchmark run produces, times in milliseconds.
+struct FrameBenchmarkResult
+{
+	std::string appName;
+
+	uint32_t seed = 0;
+	float timeStep = 0.0f;
+	uint32_t warmupFrames = 0;
+
+	bool headless = false;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	uint32_t instanceCount = 1; // Model instances drawn per frame, 1 for the other apps.
+	uint32_t particleCount = 0; // Particles simulated and drawn per frame, 0 for the other apps.
+	std::string particleInteractions; // Neighbour search of the particle app ("none", "grid" or "brute-force"), empty for the other apps.
+
+	double startupTime = 0.0;
+
+	std::vector<double> cpuFrameTimes;
+	std::vector<double> gpuFrameTimes; // Sum of the outermost GPU profiler scopes, empty without timestamp support.
+
+	std::vector<std::pair<std::string, double>> gpuScopeTimes; // Mean time of every GPU profiler scope, over its last samples.
+};
+
+// Logs the statistics and writes them, with the run parameters, as a JSON file to "path" (only logs for an empty path).
+void writeFrameBenchmarkReport(const std::string& path, const FrameBenchmarkResult& result);
+
+// Logs a table of the mean and p95 frame times (and the mean GPU scope times) of runs differing by a single parameter,
+// and writes every run as a JSON array to "path". "parameterName" names the varying field of the results, "parameterValues" holds its values.
+void writeSweepBenchmarkReport(const std::string& path, const std::string& parameterName, const std::vector<uint32_t>& parameterValues, const std::vector<FrameBenchmarkResult>& results);
+
+struct ImageDifference
+{
+	uint32_t maxDifference = 0;   // Largest channel difference, out of 255.
+	double differingPixels = 0.0; // Percentage of pixels with a channel differing by more than the tolerance.
+	double psnr = 0.0;            // Over the color channels, infinite for identical images.
+};
+
+// Compares two images of the same size with 4 bytes per pixel, the fourth (alpha) is ignored.
+ImageDifference compareImages(const std::vector<uint8_t>& first, const std::vector<uint8_t>& second, uint32_t tolerance);
@@ -0,0 +1,653 @@
+#include "gpu_culler.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+static_assert(sizeof(GpuCuller::DrawRecord) == 32, "DrawRecord must match the std430 layout of the culling shader!");
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout of the culling shader!");
+
+static const float MIN_LOD_DISTANCE = 1e-6f; // Inside of the bounding sphere, the full mesh is drawn.
+
+bool GpuCuller::isSupported(VkPhysicalDevice gpu, uint64_t drawCount)
+{
+	VkPhysicalDeviceFeatures features{};
+	VkPhysicalDeviceProperties properties{};
+
+	vkGetPhysicalDeviceFeatures(gpu, &features);
+	vkGetPhysicalDeviceProperties(gpu, &properties);
+
+	return features.multiDrawIndirect && features.drawIndirectFirstInstance && drawCount <= properties.limits.maxDrawIndirectCount;
+}
+
+bool GpuCuller::isDrawIndirectCountSupported(VkPhysicalDevice gpu)
+{
+	uint32_t extensionCount = 0;
+
+	vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+
+	vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, extensions.data());
+
+	for (const VkExtensionProperties& extension : extensions)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void GpuCuller::init(VkDevice device, MemoryAllocator& allocator, UploadContext& uploader, PipelineCache& pipelineCache, const std::vector<char>& shaderCode,
+	std::span<const DrawRecord> records, std::span<const MeshLod> lods, std::span<const Meshlet> meshlets, const std::vector<VkBuffer>& uniformBuffers,
+	VkDeviceSize uniformBufferSize, const std::vector<VkBuffer>& transformBuffers, bool drawIndirectCount)
+{
+	static_assert(sizeof(LodRange) == 32, "LodRange must match the std430 layout of the culling shader!");
+
+	this->device = device;
+	this->allocator = &allocator;
+
+	recordCount = static_cast<uint32_t>(records.size());
+	lodCount = static_cast<uint32_t>(lods.size());
+
+	if (lodCount > MAX_LEVELS_OF_DETAIL)
+	{
+		throw std::runtime_error("Failed to initialize GPU culling, there are too many levels of detail!");
+	}
+
+	// The meshlets of every level, found by their first index.
+	std::vector<LodRange> lodRanges(std::max(lodCount, 1u), LodRange{});
+	uint32_t meshletCursor = 0;
+
+	for (uint32_t level = 0; level < lodCount; level++)
+	{
+		LodRange& range = lodRanges[level];
+
+		range.firstIndex = lods[level].firstIndex;
+		range.indexCount = lods[level].indexCount;
+		range.firstMeshlet = meshletCursor;
+		range.error = lods[level].error;
+
+		while (meshletCursor < meshlets.size() && meshlets[meshletCursor].firstIndex < range.firstIndex + range.indexCount)
+		{
+			meshletCursor++;
+		}
+
+		range.meshletCount = meshletCursor - range.firstMeshlet;
+		meshletCount = std::max(meshletCount, range.meshletCount);
+	}
+
+	if (lodCount == 0)
+	{
+		meshletCount = static_cast<uint32_t>(meshlets.size());
+	}
+
+	uint64_t drawCount = static_cast<uint64_t>(recordCount) * std::max(meshletCount, 1u);
+
+	if (recordCount == 0 || drawCount > UINT32_MAX)
+	{
+		throw std::runtime_error("Failed to initialize GPU culling, there are no draw records or too many draws!");
+	}
+
+	maxDrawCount = static_cast<uint32_t>(drawCount);
+
+	if (drawIndirectCount)
+	{
+		drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+
+	VkDeviceSize recordBufferSize = sizeof(DrawRecord) * recordCount;
+
+	uploadBuffer(uploader, records.data(), recordBufferSize, recordBuffer, recordBufferMemory);
+
+	Meshlet emptyMeshlet{};
+
+	uploadBuffer(uploader, !meshlets.empty() ? meshlets.data() : &emptyMeshlet, sizeof(Meshlet) * std::max<size_t>(meshlets.size(), 1), meshletBuffer, meshletBufferMemory);
+	uploadBuffer(uploader, lodRanges.data(), sizeof(LodRange) * lodRanges.size(), lodBuffer, lodBufferMemory);
+
+	// Every record starts at the full mesh.
+	std::vector<uint32_t> lodStates(recordCount, 0);
+
+	uploadBuffer(uploader, lodStates.data(), sizeof(uint32_t) * recordCount, lodStateBuffer, lodStateBufferMemory);
+
+	slots.resize(uniformBuffers.size());
+
+	for (Slot& slot : slots)
+	{
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxDrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.drawBuffer, slot.drawBufferMemory);
+		createBuffer(sizeof(Counters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.countBuffer, slot.countBufferMemory);
+		createBuffer(sizeof(Counters), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.readbackBuffer, slot.readbackBufferMemory);
+	}
+
+	createPipeline(pipelineCache, shaderCode);
+	createDescriptorSets(uniformBuffers, uniformBufferSize, transformBuffers);
+
+	statistics.recordCount = recordCount;
+
+	for (const DrawRecord& record : records)
+	{
+		statistics.submittedTriangles += record.indexCount / 3;
+	}
+
+	std::cout << "[INFO] GPU CULLING:" << std::endl;
+	std::cout << '\t' << "Draw records: " << recordCount << " (" << recordBufferSize / 1024.0 << " KB)" << std::endl;
+	std::cout << '\t' << "Meshlets per record: " << (meshletCount > 0 ? std::to_string(meshletCount) + " at most (sphere and cone culled)" : "none, whole records") << std::endl;
+	std::cout << '\t' << "Levels of detail: " << (lodCount > 0 ? std::to_string(lodCount) + " (selected by projected error)" : "none") << std::endl;
+	std::cout << '\t' << "Draw slots: " << maxDrawCount << " per frame in flight" << std::endl;
+	std::cout << '\t' << "Draw path: " << (usesDrawIndirectCount() ? "vkCmdDrawIndexedIndirectCountKHR" : "vkCmdDrawIndexedIndirect (zero filled)") << std::endl;
+}
+
+void GpuCuller::destroy()
+{
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+	for (Slot& slot : slots)
+	{
+		vkDestroyBuffer(device, slot.drawBuffer, nullptr);
+		vkDestroyBuffer(device, slot.countBuffer, nullptr);
+		vkDestroyBuffer(device, slot.readbackBuffer, nullptr);
+
+		allocator->free(slot.drawBufferMemory);
+		allocator->free(slot.countBufferMemory);
+		allocator->free(slot.readbackBufferMemory);
+	}
+
+	vkDestroyBuffer(device, recordBuffer, nullptr);
+	allocator->free(recordBufferMemory);
+
+	vkDestroyBuffer(device, meshletBuffer, nullptr);
+	allocator->free(meshletBufferMemory);
+
+	vkDestroyBuffer(device, lodBuffer, nullptr);
+	allocator->free(lodBufferMemory);
+
+	vkDestroyBuffer(device, lodStateBuffer, nullptr);
+	allocator->free(lodStateBufferMemory);
+
+	slots.clear();
+
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+	recordBuffer = VK_NULL_HANDLE;
+	meshletBuffer = VK_NULL_HANDLE;
+	lodBuffer = VK_NULL_HANDLE;
+	lodStateBuffer = VK_NULL_HANDLE;
+}
+
+void GpuCuller::recordCulling(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+{
+	Slot& slot = slots[slotIndex];
+
+	// The previous submission of the slot has completed, its commands and counters can be overwritten.
+	vkCmdFillBuffer(commandBuffer, slot.countBuffer, 0, sizeof(Counters), 0);
+
+	if (!usesDrawIndirectCount())
+	{
+		vkCmdFillBuffer(commandBuffer, slot.drawBuffer, 0, VK_WHOLE_SIZE, 0); // Zero instances, the draws past the count do nothing.
+	}
+
+	// Also orders the level states against the culling pass submitted before, whatever its slot.
+	VkMemoryBarrier clearBarrier{};
+
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	// One invocation per draw slot, rows of workgroups past the dispatch size limit (65535 is the minimum guaranteed).
+	uint32_t groupCount = (maxDrawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+	uint32_t dispatchWidth = std::min(groupCount, 65535u);
+
+	PushConstants pushConstants{};
+
+	pushConstants.recordCount = recordCount;
+	pushConstants.meshletCount = meshletCount;
+	pushConstants.dispatchWidth = dispatchWidth;
+	pushConstants.lodCount = lodCount;
+	pushConstants.lodErrorScale = lodErrorScale;
+	pushConstants.lodHysteresis = LOD_HYSTERESIS;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &slot.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+	vkCmdDispatch(commandBuffer, dispatchWidth, (groupCount + dispatchWidth - 1) / dispatchWidth, 1);
+
+	VkMemoryBarrier cullBarrier{};
+
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy copyRegion{};
+
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = sizeof(Counters);
+
+	vkCmdCopyBuffer(commandBuffer, slot.countBuffer, slot.readbackBuffer, 1, &copyRegion);
+
+	VkMemoryBarrier readbackBarrier{};
+
+	readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+	slot.frame = ++recordedFrames;
+	slot.pending = true;
+}
+
+void GpuCuller::recordDraw(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+{
+	const Slot& slot = slots[slotIndex];
+
+	if (usesDrawIndirectCount())
+	{
+		drawIndexedIndirectCount(commandBuffer, slot.drawBuffer, 0, slot.countBuffer, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, slot.drawBuffer, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void GpuCuller::collect(uint32_t slotIndex)
+{
+	if (slotIndex >= slots.size() || !slots[slotIndex].pending)
+	{
+		return;
+	}
+
+	Slot& slot = slots[slotIndex];
+
+	const Counters* counters = static_cast<const Counters*>(slot.readbackBufferMemory.mapped);
+
+	statistics.frame = slot.frame;
+	statistics.visibleCount = counters->drawCount;
+	statistics.drawnTriangles = 0;
+
+	for (uint32_t level = 0; level < MAX_LEVELS_OF_DETAIL; level++)
+	{
+		statistics.lodTriangles[level] = (static_cast<uint64_t>(counters->lodTriangles[level][1]) << 32) | counters->lodTriangles[level][0];
+		statistics.drawnTriangles += statistics.lodTriangles[level];
+	}
+
+	collectedFrames++;
+	drawnTrianglesSum += statistics.drawnTriangles;
+	minDrawnTriangles = std::min(minDrawnTriangles, statistics.drawnTriangles);
+	maxDrawnTriangles = std::max(maxDrawnTriangles, statistics.drawnTriangles);
+
+	slot.pending = false;
+}
+
+void GpuCuller::logStatistics() const
+{
+	if (collectedFrames == 0)
+	{
+		return;
+	}
+
+	double meanDrawnTriangles = static_cast<double>(drawnTrianglesSum) / collectedFrames;
+
+	std::cout << "[INFO] CULLING STATISTICS:" << std::endl;
+	std::cout << '\t' << "Frames: " << collectedFrames << std::endl;
+	std::cout << '\t' << "Triangles submitted per frame: " << statistics.submittedTriangles << std::endl;
+	std::cout << '\t' << "Triangles drawn per frame: mean " << meanDrawnTriangles << " (" << 100.0 * meanDrawnTriangles / std::max<uint64_t>(statistics.submittedTriangles, 1)
+		<< "%), min " << minDrawnTriangles << ", max " << maxDrawnTriangles << std::endl;
+}
+
+// Length of the longest axis of "model".
+static float getScale(const float* model)
+{
+	float scale = 0.0f;
+
+	for (uint32_t column = 0; column < 3; column++)
+	{
+		const float* axis = &model[column * 4];
+
+		scale = std::max(scale, std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]));
+	}
+
+	return scale;
+}
+
+// Moves a sphere by "model", the radius is scaled by the longest axis.
+static void transformSphere(const float* sphere, const float* model, float* center, float& radius)
+{
+	for (uint32_t row = 0; row < 3; row++)
+	{
+		center[row] = model[12 + row];
+
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			center[row] += model[column * 4 + row] * sphere[column];
+		}
+	}
+
+	radius = sphere[3] * getScale(model);
+}
+
+// The view is a rigid transform, the camera sits at -transpose(rotation) * translation.
+static void getCameraPosition(const float* view, float* position)
+{
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		position[k] = -(view[k * 4 + 0] * view[12] + view[k * 4 + 1] * view[13] + view[k * 4 + 2] * view[14]);
+	}
+}
+
+static bool isSphereInFrustum(const float* center, float radius, const float* viewProjection)
+{
+	// Planes from the rows of the view projection matrix (Gribb and Hartmann), for a [0, 1] depth range.
+	auto row = [viewProjection](uint32_t index, uint32_t component) { return viewProjection[component * 4 + index]; };
+
+	for (uint32_t plane = 0; plane < 6; plane++)
+	{
+		float coefficients[4];
+
+		for (uint32_t component = 0; component < 4; component++)
+		{
+			float w = row(3, component);
+
+			switch (plane)
+			{
+			case 0: coefficients[component] = w + row(0, component); break;
+			case 1: coefficients[component] = w - row(0, component); break;
+			case 2: coefficients[component] = w + row(1, component); break;
+			case 3: coefficients[component] = w - row(1, component); break;
+			case 4: coefficients[component] = row(2, component); break;
+			default: coefficients[component] = w - row(2, component); break;
+			}
+		}
+
+		float distance = coefficients[0] * center[0] + coefficients[1] * center[1] + coefficients[2] * center[2] + coefficients[3];
+		float normalLength = std::sqrt(coefficients[0] * coefficients[0] + coefficients[1] * coefficients[1] + coefficients[2] * coefficients[2]);
+
+		if (distance < -radius * normalLength)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool GpuCuller::isVisible(const DrawRecord& record, const Meshlet* meshlet, const float* viewProjection, const float* view, const float* model)
+{
+	// Same operations as the shader.
+	float center[3], radius;
+
+	transformSphere(record.boundingSphere, model, center, radius);
+
+	if (!isSphereInFrustum(center, radius, viewProjection))
+	{
+		return false;
+	}
+
+	if (meshlet == nullptr)
+	{
+		return true;
+	}
+
+	transformSphere(meshlet->boundingSphere, model, center, radius);
+
+	if (!isSphereInFrustum(center, radius, viewProjection))
+	{
+		return false;
+	}
+
+	float cameraPosition[3], offset[3], axis[3];
+
+	getCameraPosition(view, cameraPosition);
+
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		offset[k] = center[k] - cameraPosition[k];
+		axis[k] = model[0 + k] * meshlet->cone[0] + model[4 + k] * meshlet->cone[1] + model[8 + k] * meshlet->cone[2];
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float offsetLength = std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+
+	if (axisLength <= 0.0f)
+	{
+		return true;
+	}
+
+	float projection = (offset[0] * axis[0] + offset[1] * axis[1] + offset[2] * axis[2]) / axisLength;
+
+	return projection < meshlet->cone[3] * offsetLength + radius; // Otherwise every triangle faces away from the camera.
+}
+
+uint32_t GpuCuller::selectLevelOfDetail(std::span<const MeshLod> lods, uint32_t previous, const DrawRecord& record, const float* view, const float* model, float errorScale)
+{
+	// Same operations as the shader, errors are projected from the nearest point of the bounding sphere.
+	float center[3], radius, cameraPosition[3];
+
+	transformSphere(record.boundingSphere, model, center, radius);
+	getCameraPosition(view, cameraPosition);
+
+	float offset[3] = { center[0] - cameraPosition[0], center[1] - cameraPosition[1], center[2] - cameraPosition[2] };
+	float distance = std::max(std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]) - radius, MIN_LOD_DISTANCE);
+
+	return selectMeshLod(lods, previous, errorScale * getScale(model) / distance);
+}
+
+void GpuCuller::uploadBuffer(UploadContext& uploader, const void* data, VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& bufferMemory)
+{
+	createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory, &uploader);
+
+	StagingRegion staging = uploader.stage(data, size);
+
+	VkBufferCopy copyRegion{};
+
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = size;
+
+	vkCmdCopyBuffer(uploader.getTransferCommandBuffer(), staging.buffer, buffer, 1, &copyRegion);
+}
+
+void GpuCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, const UploadContext* uploader)
+{
+	VkBufferCreateInfo bufferCreateInfo{};
+
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = size;
+	bufferCreateInfo.usage = usage;
+
+	// Upload destinations are written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices{};
+
+	if (uploader != nullptr && uploader->hasDedicatedTransferQueue())
+	{
+		queueFamilyIndices = uploader->getQueueFamilyIndices();
+
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create GPU culling buffer!");
+	}
+
+	VkMemoryRequirements memoryRequirements{};
+
+	vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+	bufferMemory = allocator->allocate(memoryRequirements, properties, LINEAR_RESOURCE);
+
+	vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+void GpuCuller::createPipeline(PipelineCache& pipelineCache, const std::vector<char>& shaderCode)
+{
+	std::array<VkDescriptorSetLayoutBinding, 8> bindings{};
+
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create GPU culling descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create GPU culling pipeline layout!");
+	}
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = shaderCode.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+
+	if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module!");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateComputePipelines(device, pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create GPU culling pipeline!");
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	pipelineCache.reportCreationTime("GpuCuller compute pipeline", std::chrono::duration<double, std::milli>(endTime - startTime).count());
+
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void GpuCuller::createDescriptorSets(const std::vector<VkBuffer>& uniformBuffers, VkDeviceSize uniformBufferSize, const std::vector<VkBuffer>& transformBuffers)
+{
+	uint32_t slotCount = static_cast<uint32_t>(slots.size());
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = slotCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = slotCount * 7;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo{};
+
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+	poolCreateInfo.maxSets = slotCount;
+
+	if (vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create GPU culling descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(slotCount, descriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = descriptorPool;
+	allocateInfo.descriptorSetCount = slotCount;
+	allocateInfo.pSetLayouts = layouts.data();
+
+	std::vector<VkDescriptorSet> descriptorSets(slotCount);
+
+	if (vkAllocateDescriptorSets(device, &allocateInfo, descriptorSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate GPU culling descriptor sets!");
+	}
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		slots[i].descriptorSet = descriptorSets[i];
+
+		std::array<VkDescriptorBufferInfo, 8> bufferInfos{};
+
+		bufferInfos[0] = { uniformBuffers[i], 0, uniformBufferSize };
+		bufferInfos[1] = { recordBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { transformBuffers[i], 0, VK_WHOLE_SIZE };
+		bufferInfos[3] = { slots[i].drawBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[4] = { slots[i].countBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[5] = { meshletBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[6] = { lodBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[7] = { lodStateBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
+
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+		{
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = descriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include "memory_allocator.h"
+#include "upload_context.h"
+#include "pipeline_cache.h"
+#include "meshlet_builder.h"
+#include "mesh_simplifier.h"
+
+// Frustum culling of draw records on the GPU. The records stay in a device local buffer, every frame a compute
+// pass tests their bounding spheres against the frustum of the camera (read from the frame's uniform buffer)
+// and appends a VkDrawIndexedIndirectCommand per visible record, counted atomically. The commands are drawn
+// with "vkCmdDrawIndexedIndirectCountKHR" when VK_KHR_draw_indirect_count is enabled, otherwise with a single
+// "vkCmdDrawIndexedIndirect" over every slot, the ones past the count are zeroed first. Either way, recording a
+// frame costs the same for any number of records. With meshlets, every record is split into the same meshlets
+// (index ranges relative to its first index), and each of them is culled on its own, by bounding sphere and by
+// normal cone, for a draw per visible meshlet. With a LOD chain, every visible record also picks the level it's
+// drawn at from its projected error, with the hysteresis of "selectMeshLod" (the chosen levels persist on the
+// GPU between frames). The counts of every frame are copied back to host memory and read in "collect", so
+// reading never blocks.
+class GpuCuller
+{
+public:
+	// Matches the std430 layout of the culling shader.
+	struct DrawRecord
+	{
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t transformIndex; // Becomes "firstInstance", so the vertex shader finds the transform at "gl_InstanceIndex".
+
+		float boundingSphere[4]; // Object space center and radius.
+	};
+
+	static constexpr uint32_t MAX_LEVELS_OF_DETAIL = 8;
+
+	struct Statistics
+	{
+		uint64_t frame = 0; // Recording the counts come from, starting at 1 (0 until something was collected).
+
+		uint32_t recordCount = 0;
+		uint32_t visibleCount = 0; // Draws, of whole records or of meshlets.
+
+		uint64_t submittedTriangles = 0; // Every triangle of every record.
+		uint64_t drawnTriangles = 0;
+		uint64_t lodTriangles[MAX_LEVELS_OF_DETAIL] = {}; // Drawn at each level of detail.
+	};
+
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	GpuCuller() = default;
+
+	// Multi draw indirect with non zero first instances is required, and "drawCount" draws in a single call.
+	static bool isSupported(VkPhysicalDevice gpu, uint64_t drawCount);
+	static bool isDrawIndirectCountSupported(VkPhysicalDevice gpu);
+
+	// Every slot reads its own uniform buffer (a "UniformBufferObject") and transform buffer (a mat4 per transform
+	// index), both written by the host before submission. Every record is drawn at one of "lods" (none to draw its
+	// own range), the meshlets (none to cull whole records) follow the levels in order. Index ranges of both are
+	// relative to the first index of the record. Everything is uploaded through "uploader". "drawIndirectCount"
+	// may only be set when the extension was enabled on the device.
+	void init(VkDevice device, MemoryAllocator& allocator, UploadContext& uploader, PipelineCache& pipelineCache, const std::vector<char>& shaderCode,
+		std::span<const DrawRecord> records, std::span<const MeshLod> lods, std::span<const Meshlet> meshlets, const std::vector<VkBuffer>& uniformBuffers,
+		VkDeviceSize uniformBufferSize, const std::vector<VkBuffer>& transformBuffers, bool drawIndirectCount);
+	void destroy();
+
+	bool isInitialized() const { return pipeline != VK_NULL_HANDLE; }
+	bool usesDrawIndirectCount() const { return drawIndexedIndirectCount != nullptr; }
+
+	// Converts object space errors at a distance of 1 to multiples of the tolerated one, for the next recordings.
+	void setLodErrorScale(float scale) { lodErrorScale = scale; }
+
+	// Outside of a render pass, before "recordDraw" of the same slot.
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// Inside of a render pass, with the graphics pipeline, the vertex and the index buffers bound.
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// Must be called once the fence of the slot's last submission has signaled.
+	void collect(uint32_t slot);
+
+	const Statistics& getStatistics() const { return statistics; }
+
+	// Triangles drawn per collected frame, over the whole run.
+	void logStatistics() const;
+
+	// CPU reference of the culling shader, for a whole record without "meshlet". The matrices are column major.
+	static bool isVisible(const DrawRecord& record, const Meshlet* meshlet, const float* viewProjection, const float* view, const float* model);
+
+	// CPU reference of the level selection, for a visible record previously drawn at "previous".
+	static uint32_t selectLevelOfDetail(std::span<const MeshLod> lods, uint32_t previous, const DrawRecord& record, const float* view, const float* model, float errorScale);
+
+private:
+	// Matches the std430 layout of the culling shader.
+	struct LodRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
+
+		float error;
+		uint32_t padding[3];
+	};
+
+	struct PushConstants
+	{
+		uint32_t recordCount;
+		uint32_t meshletCount;  // Invocations per record, the meshlets of its largest level.
+		uint32_t dispatchWidth; // Workgroups per row of the dispatch, rows cover the invocations past the limit.
+		uint32_t lodCount;
+
+		float lodErrorScale;
+		float lodHysteresis;
+	};
+
+	// Matches the count buffer of the culling shader, the draw count comes first for the indirect count.
+	struct Counters
+	{
+		uint32_t drawCount;
+		uint32_t padding[3];
+
+		uint32_t lodTriangles[MAX_LEVELS_OF_DETAIL][2]; // 64 bits, low half first, the shader carries into the high one.
+	};
+
+	struct Slot
+	{
+		VkBuffer drawBuffer = VK_NULL_HANDLE; // Compacted indirect commands.
+		MemoryAllocation drawBufferMemory;
+
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		MemoryAllocation countBufferMemory;
+
+		VkBuffer readbackBuffer = VK_NULL_HANDLE; // Host visible copy of the counters.
+		MemoryAllocation readbackBufferMemory;
+
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		uint64_t frame = 0;
+		bool pending = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+
+	uint32_t recordCount = 0;
+	uint32_t meshletCount = 0;
+	uint32_t lodCount = 0;
+	uint32_t maxDrawCount = 0;
+
+	float lodErrorScale = 0.0f;
+
+	VkBuffer recordBuffer = VK_NULL_HANDLE;
+	MemoryAllocation recordBufferMemory;
+
+	VkBuffer meshletBuffer = VK_NULL_HANDLE; // A single zeroed meshlet when culling whole records.
+	MemoryAllocation meshletBufferMemory;
+
+	VkBuffer lodBuffer = VK_NULL_HANDLE; // A single zeroed level without a LOD chain.
+	MemoryAllocation lodBufferMemory;
+
+	VkBuffer lodStateBuffer = VK_NULL_HANDLE; // Level every record was last drawn at, shared by the slots.
+	MemoryAllocation lodStateBufferMemory;
+
+	std::vector<Slot> slots;
+	uint64_t recordedFrames = 0;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;
+
+	Statistics statistics;
+
+	uint64_t collectedFrames = 0;
+	uint64_t drawnTrianglesSum = 0;
+	uint64_t minDrawnTriangles = UINT64_MAX;
+	uint64_t maxDrawnTriangles = 0;
+
+	void uploadBuffer(UploadContext& uploader, const void* data, VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, const UploadContext* uploader = nullptr);
+
+	void createPipeline(PipelineCache& pipelineCache, const std::vector<char>& shaderCode);
+	void createDescriptorSets(const std::vector<VkBuffer>& uniformBuffers, VkDeviceSize uniformBufferSize, const std::vector<VkBuffer>& transformBuffers);
+};
@@ -0,0 +1,287 @@
+#include "gpu_profiler.h"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+void GpuProfiler::init(VkPhysicalDevice gpu, VkDevice device, uint32_t queueFamilyIndex, uint32_t slotCount)
+{
+	this->device = device;
+
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	vkGetPhysicalDeviceProperties(gpu, &deviceProperties);
+
+	uint32_t queueFamilyCount = 0;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+
+	if (validBits == 0)
+	{
+		std::cerr << "[WARNING] Timestamp queries aren't supported, GPU profiling is disabled." << std::endl;
+
+		return;
+	}
+
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo{};
+
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = slotCount * MAX_QUERIES_PER_SLOT;
+
+	if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create query pool!");
+	}
+
+	slots.resize(slotCount);
+}
+
+void GpuProfiler::destroy()
+{
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, queryPool, nullptr);
+
+		queryPool = VK_NULL_HANDLE;
+	}
+
+	slots.clear();
+}
+
+void GpuProfiler::beginRecording(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	recordingSlot = slot;
+	openScopes.clear();
+
+	slots[slot].scopes.clear();
+	slots[slot].queryCount = 0;
+	slots[slot].pending = true;
+
+	vkCmdResetQueryPool(commandBuffer, queryPool, slot * MAX_QUERIES_PER_SLOT, MAX_QUERIES_PER_SLOT);
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	Slot& slot = slots[recordingSlot];
+
+	if (slot.queryCount + 2 > MAX_QUERIES_PER_SLOT)
+	{
+		openScopes.push_back(UINT32_MAX);
+		droppedScopes++;
+
+		return;
+	}
+
+	auto found = historyIndices.find(name);
+
+	if (found == historyIndices.end())
+	{
+		found = historyIndices.emplace(name, static_cast<uint32_t>(histories.size())).first;
+
+		histories.push_back(History{ name, {}, 0 });
+	}
+
+	Scope scope{ found->second, recordingSlot * MAX_QUERIES_PER_SLOT + slot.queryCount, openScopes.empty() };
+
+	slot.queryCount += 2;
+
+	openScopes.push_back(static_cast<uint32_t>(slot.scopes.size()));
+	slot.scopes.push_back(scope);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, scope.firstQuery);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer)
+{
+	if (queryPool == VK_NULL_HANDLE || openScopes.empty())
+	{
+		return;
+	}
+
+	uint32_t scopeIndex = openScopes.back();
+
+	openScopes.pop_back();
+
+	if (scopeIndex != UINT32_MAX)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, slots[recordingSlot].scopes[scopeIndex].firstQuery + 1);
+	}
+}
+
+void GpuProfiler::collect(uint32_t slotIndex)
+{
+	if (queryPool == VK_NULL_HANDLE || !slots[slotIndex].pending)
+	{
+		return;
+	}
+
+	Slot& slot = slots[slotIndex];
+
+	slot.pending = false;
+
+	if (slot.queryCount == 0)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> timestamps(slot.queryCount);
+
+	// No wait flag, the submission already finished. Anything not ready is dropped, the slot is reset next.
+	VkResult result = vkGetQueryPoolResults(device, queryPool, slotIndex * MAX_QUERIES_PER_SLOT, slot.queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+	{
+		droppedResults++;
+
+		return;
+	}
+
+	for (const Scope& scope : slot.scopes)
+	{
+		uint32_t query = scope.firstQuery - slotIndex * MAX_QUERIES_PER_SLOT;
+		uint64_t ticks = (timestamps[query + 1] - timestamps[query]) & timestampMask;
+
+		History& history = histories[scope.historyIndex];
+		double time = static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+
+		if (history.samples.size() < HISTORY_SIZE)
+		{
+			history.samples.push_back(time);
+		}
+		else
+		{
+			history.samples[history.sampleCount % HISTORY_SIZE] = time;
+		}
+
+		history.sampleCount++;
+
+		if (scope.outermost)
+		{
+			collectedTime += time;
+			collectedAny = true;
+		}
+	}
+}
+
+bool GpuProfiler::takeCollectedTime(double& time)
+{
+	time = collectedTime;
+
+	bool collected = collectedAny;
+
+	collectedTime = 0.0;
+	collectedAny = false;
+
+	return collected;
+}
+
+std::vector<GpuProfiler::ScopeStatistics> GpuProfiler::getStatistics() const
+{
+	std::vector<ScopeStatistics> statistics;
+
+	for (const History& history : histories)
+	{
+		if (history.samples.empty())
+		{
+			continue;
+		}
+
+		std::vector<double> samples = history.samples;
+
+		std::sort(samples.begin(), samples.end());
+
+		double sum = 0.0;
+
+		for (double sample : samples)
+		{
+			sum += sample;
+		}
+
+		size_t p99Index = static_cast<size_t>(std::ceil(samples.size() * 0.99)) - 1;
+
+		statistics.push_back({ history.name, history.sampleCount, samples.front(), sum / samples.size(), samples[p99Index] });
+	}
+
+	return statistics;
+}
+
+void GpuProfiler::logStatistics() const
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::cout << "[INFO] GPU PROFILER:" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+
+	for (const ScopeStatistics& scope : getStatistics())
+	{
+		std::cout << '\t' << scope.name << ": min " << scope.minTime << " ms, avg " << scope.avgTime << " ms, p99 " << scope.p99Time << " ms (" << scope.sampleCount << " samples)" << std::endl;
+	}
+
+	std::cout << '\t' << "Dropped scopes: " << droppedScopes << ", dropped results: " << droppedResults << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+bool GpuProfiler::exportCsv(const std::string& path) const
+{
+	std::ofstream output(path, std::ios::trunc);
+
+	output << "scope,samples,min_ms,avg_ms,p99_ms\n";
+	output << std::fixed << std::setprecision(6);
+
+	for (const ScopeStatistics& scope : getStatistics())
+	{
+		output << '"' << scope.name << "\"," << scope.sampleCount << ',' << scope.minTime << ',' << scope.avgTime << ',' << scope.p99Time << '\n';
+	}
+
+	return output.good();
+}
+
+bool GpuProfiler::exportJson(const std::string& path) const
+{
+	std::ofstream output(path, std::ios::trunc);
+
+	output << "{\n\t\"scopes\": [";
+	output << std::fixed << std::setprecision(6);
+
+	std::vector<ScopeStatistics> statistics = getStatistics();
+
+	for (size_t i = 0; i < statistics.size(); i++)
+	{
+		const ScopeStatistics& scope = statistics[i];
+
+		output << (i == 0 ? "\n" : ",\n");
+		output << "\t\t{ \"name\": \"" << scope.name << "\", \"samples\": " << scope.sampleCount
+			<< ", \"minMs\": " << scope.minTime << ", \"avgMs\": " << scope.avgTime << ", \"p99Ms\": " << scope.p99Time << " }";
+	}
+
+	output << "\n\t]\n}\n";
+
+	return output.good();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// Named GPU timestamp scopes. Every command buffer recorded per frame in flight owns a "slot", a range of
+// a single VkQueryPool that is reset when the command buffer is recorded again. Results are only read in
+// "collect", which must be called once the fence of the slot's last submission has signaled, so reading
+// never blocks. Does nothing when the queue family has no timestamp support.
+class GpuProfiler
+{
+public:
+	struct ScopeStatistics
+	{
+		std::string name;
+
+		uint64_t sampleCount; // All samples, the times below cover the last "HISTORY_SIZE" only.
+
+		double minTime;
+		double avgTime;
+		double p99Time;
+	};
+
+	GpuProfiler() = default;
+
+	void init(VkPhysicalDevice gpu, VkDevice device, uint32_t queueFamilyIndex, uint32_t slotCount);
+	void destroy();
+
+	// Must be recorded outside of a render pass, before any scope of the slot.
+	void beginRecording(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// Scopes nest, each "endScope" closes the last open one.
+	void beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+	void endScope(VkCommandBuffer commandBuffer);
+
+	void collect(uint32_t slot);
+
+	// Sum of the outermost scopes collected since the last call, in milliseconds. False when nothing was collected.
+	bool takeCollectedTime(double& time);
+
+	// Times in milliseconds.
+	std::vector<ScopeStatistics> getStatistics() const;
+
+	void logStatistics() const;
+
+	bool exportCsv(const std::string& path) const;
+	bool exportJson(const std::string& path) const;
+
+private:
+	struct Scope
+	{
+		uint32_t historyIndex;
+		uint32_t firstQuery;
+
+		bool outermost;
+	};
+
+	struct Slot
+	{
+		std::vector<Scope> scopes;
+		uint32_t queryCount = 0;
+
+		bool pending = false;
+	};
+
+	struct History
+	{
+		std::string name;
+		std::vector<double> samples; // Ring of the last "HISTORY_SIZE" samples.
+
+		uint64_t sampleCount = 0;
+	};
+
+	static const uint32_t MAX_QUERIES_PER_SLOT = 64;
+	static const uint32_t HISTORY_SIZE = 256;
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+
+	double timestampPeriod = 0.0; // Nanoseconds per tick.
+	uint64_t timestampMask = 0;
+
+	std::vector<Slot> slots;
+	uint32_t recordingSlot = 0;
+	std::vector<uint32_t> openScopes; // Indices into the scopes of the recording slot, UINT32_MAX for dropped ones.
+
+	std::vector<History> histories;
+	std::unordered_map<std::string, uint32_t> historyIndices;
+
+	double collectedTime = 0.0;
+	bool collectedAny = false;
+
+	uint64_t droppedScopes = 0;
+	uint64_t droppedResults = 0;
+};
@@ -0,0 +1,153 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+
+	// Empty files can't be mapped.
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+
+	data = static_cast<const char*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStatus{};
+
+	// Empty files can't be mapped.
+	if (fstat(file, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		::close(file);
+
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+	// The mapping keeps its own reference to the file.
+	::close(file);
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<const char*>(view);
+	size = static_cast<size_t>(fileStatus.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	munmap(const_cast<char*>(data), size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+bool writeFileAtomically(const std::string& path, std::initializer_list<std::span<const char>> parts)
+{
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+	for (std::span<const char> part : parts)
+	{
+		file.write(part.data(), part.size());
+	}
+
+	file.close();
+
+	std::error_code error;
+
+	if (file.good())
+	{
+		std::filesystem::rename(temporaryPath, path, error);
+	}
+
+	if (!file.good() || error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+
+		return false;
+	}
+
+	return true;
+}
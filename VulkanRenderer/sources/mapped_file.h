@@ -0,0 +1,38 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstddef>
+#include <initializer_list>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return data != nullptr; }
+
+	const char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+// Writes the concatenated "parts" through a temporary file next to "path", so a crash never leaves a half
+// written file behind. Returns false, keeping any previous file, when it can't be written.
+bool writeFileAtomically(const std::string& path, std::initializer_list<std::span<const char>> parts);
@@ -0,0 +1,346 @@
+#include "memory_allocator.h"
+
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+static uint32_t getSizeClass(VkDeviceSize size)
+{
+	uint32_t sizeClass = 0;
+
+	while ((VkDeviceSize(1) << sizeClass) < size)
+	{
+		sizeClass++;
+	}
+
+	return sizeClass;
+}
+
+static double toMebibytes(VkDeviceSize bytes)
+{
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void MemoryAllocator::init(VkPhysicalDevice gpu, VkDevice device)
+{
+	this->device = device;
+
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	vkGetPhysicalDeviceProperties(gpu, &deviceProperties);
+	vkGetPhysicalDeviceMemoryProperties(gpu, &memoryProperties);
+
+	bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+}
+
+void MemoryAllocator::destroy()
+{
+	for (Pool& pool : pools)
+	{
+		for (Block& block : pool.blocks)
+		{
+			if (block.memory != VK_NULL_HANDLE)
+			{
+				freeDeviceMemory(block.memory, VkDeviceSize(1) << pool.blockSizeClass, block.mapped != nullptr);
+			}
+		}
+	}
+
+	if (statistics.liveAllocations > 0)
+	{
+		std::cerr << "[WARNING] Memory allocator destroyed with " << statistics.liveAllocations << " live allocations." << std::endl;
+	}
+
+	pools.clear();
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationType type, bool dedicated)
+{
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t poolIndex = getPoolIndex(memoryTypeIndex, type);
+	uint32_t sizeClass = std::max(getSizeClass(std::max(requirements.size, requirements.alignment)), MIN_SIZE_CLASS);
+
+	MemoryAllocation allocation{};
+
+	allocation.size = requirements.size;
+
+	if (dedicated || sizeClass >= pools[poolIndex].blockSizeClass)
+	{
+		allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+		allocation.poolIndex = UINT32_MAX;
+
+		statistics.dedicatedAllocations++;
+
+		trackAllocation(allocation.size);
+
+		return allocation;
+	}
+
+	Pool& pool = pools[poolIndex];
+
+	allocation.blockIndex = UINT32_MAX;
+
+	for (uint32_t i = 0; i < pool.blocks.size(); i++)
+	{
+		Block& block = pool.blocks[i];
+
+		if (block.memory != VK_NULL_HANDLE && allocateFromBlock(block, pool.blockSizeClass, sizeClass, allocation.offset))
+		{
+			allocation.blockIndex = i;
+			break;
+		}
+	}
+
+	if (allocation.blockIndex == UINT32_MAX)
+	{
+		// Reuse a released slot before growing the block list, so "blockIndex" stays stable for live allocations.
+		auto emptySlot = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const Block& block) { return block.memory == VK_NULL_HANDLE; });
+
+		if (emptySlot == pool.blocks.end())
+		{
+			emptySlot = pool.blocks.insert(pool.blocks.end(), Block{});
+		}
+
+		Block& block = *emptySlot;
+
+		block.memory = allocateDeviceMemory(VkDeviceSize(1) << pool.blockSizeClass, memoryTypeIndex, &block.mapped);
+		block.freeLists.assign(pool.blockSizeClass + 1, {});
+		block.freeLists[pool.blockSizeClass].insert(0);
+
+		allocation.blockIndex = static_cast<uint32_t>(emptySlot - pool.blocks.begin());
+
+		allocateFromBlock(block, pool.blockSizeClass, sizeClass, allocation.offset);
+	}
+
+	Block& block = pool.blocks[allocation.blockIndex];
+
+	block.liveAllocations++;
+
+	allocation.memory = block.memory;
+	allocation.poolIndex = poolIndex;
+	allocation.sizeClass = sizeClass;
+	allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+
+	trackAllocation(allocation.size);
+
+	return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (allocation.poolIndex == UINT32_MAX)
+	{
+		freeDeviceMemory(allocation.memory, allocation.size, allocation.mapped != nullptr);
+
+		statistics.dedicatedAllocations--;
+	}
+	else
+	{
+		Pool& pool = pools[allocation.poolIndex];
+		Block& block = pool.blocks[allocation.blockIndex];
+
+		freeToBlock(block, pool.blockSizeClass, allocation.sizeClass, allocation.offset);
+
+		// Keep one empty block per pool around to avoid thrashing "vkAllocateMemory" on alloc/free patterns.
+		if (--block.liveAllocations == 0)
+		{
+			uint32_t emptyBlocks = 0;
+
+			for (const Block& other : pool.blocks)
+			{
+				emptyBlocks += (other.memory != VK_NULL_HANDLE && other.liveAllocations == 0) ? 1 : 0;
+			}
+
+			if (emptyBlocks > 1)
+			{
+				freeDeviceMemory(block.memory, VkDeviceSize(1) << pool.blockSizeClass, block.mapped != nullptr);
+
+				block = Block{};
+			}
+		}
+	}
+
+	trackFree(allocation.size);
+
+	allocation = MemoryAllocation{};
+}
+
+void MemoryAllocator::logStatistics() const
+{
+	std::cout << "[INFO] MEMORY ALLOCATOR:" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << '\t' << "Device allocations: " << statistics.deviceAllocations << " (peak " << statistics.peakDeviceAllocations << ", dedicated " << statistics.dedicatedAllocations << ")" << std::endl;
+	std::cout << '\t' << "Live allocations: " << statistics.liveAllocations << " (peak " << statistics.peakLiveAllocations << ")" << std::endl;
+	std::cout << '\t' << "Live bytes: " << toMebibytes(statistics.liveBytes) << " MiB (peak " << toMebibytes(statistics.peakLiveBytes) << " MiB)" << std::endl;
+	std::cout << '\t' << "Reserved bytes: " << toMebibytes(statistics.reservedBytes) << " MiB (peak " << toMebibytes(statistics.peakReservedBytes) << " MiB)" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+uint32_t MemoryAllocator::getPoolIndex(uint32_t memoryTypeIndex, AllocationType type)
+{
+	// With a granularity of 1 the distinction is meaningless, so everything shares the linear pool.
+	if (bufferImageGranularity <= 1)
+	{
+		type = LINEAR_RESOURCE;
+	}
+
+	for (uint32_t i = 0; i < pools.size(); i++)
+	{
+		if (pools[i].memoryTypeIndex == memoryTypeIndex && pools[i].type == type)
+		{
+			return i;
+		}
+	}
+
+	// Small heaps (e.g. host visible device local memory) get smaller blocks.
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	uint32_t blockSizeClass = MAX_BLOCK_SIZE_CLASS;
+
+	while (blockSizeClass > MIN_BLOCK_SIZE_CLASS && (VkDeviceSize(1) << blockSizeClass) > heapSize / 8)
+	{
+		blockSizeClass--;
+	}
+
+	Pool pool{};
+
+	pool.memoryTypeIndex = memoryTypeIndex;
+	pool.type = type;
+	pool.blockSizeClass = blockSizeClass;
+
+	pools.push_back(pool);
+
+	return static_cast<uint32_t>(pools.size() - 1);
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+{
+	return (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped)
+{
+	VkMemoryAllocateInfo memoryAllocateInfo{};
+
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.allocationSize = size;
+	memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+
+	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate device memory!");
+	}
+
+	*mapped = nullptr;
+
+	// A memory object can only be mapped once, so host visible memory stays mapped for its whole lifetime.
+	if (isHostVisible(memoryTypeIndex) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to map device memory!");
+	}
+
+	statistics.deviceAllocations++;
+	statistics.peakDeviceAllocations = std::max(statistics.peakDeviceAllocations, statistics.deviceAllocations);
+	statistics.reservedBytes += size;
+	statistics.peakReservedBytes = std::max(statistics.peakReservedBytes, statistics.reservedBytes);
+
+	return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, bool mapped)
+{
+	if (mapped)
+	{
+		vkUnmapMemory(device, memory);
+	}
+
+	vkFreeMemory(device, memory, nullptr);
+
+	statistics.deviceAllocations--;
+	statistics.reservedBytes -= size;
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, uint32_t blockSizeClass, uint32_t sizeClass, VkDeviceSize& offset)
+{
+	uint32_t availableClass = sizeClass;
+
+	while (availableClass <= blockSizeClass && block.freeLists[availableClass].empty())
+	{
+		availableClass++;
+	}
+
+	if (availableClass > blockSizeClass)
+	{
+		return false;
+	}
+
+	offset = *block.freeLists[availableClass].begin();
+
+	block.freeLists[availableClass].erase(block.freeLists[availableClass].begin());
+
+	// Split down to the requested class, releasing the upper halves.
+	while (availableClass > sizeClass)
+	{
+		availableClass--;
+
+		block.freeLists[availableClass].insert(offset + (VkDeviceSize(1) << availableClass));
+	}
+
+	return true;
+}
+
+void MemoryAllocator::freeToBlock(Block& block, uint32_t blockSizeClass, uint32_t sizeClass, VkDeviceSize offset)
+{
+	// Merge with the buddy while it is free as well.
+	while (sizeClass < blockSizeClass)
+	{
+		VkDeviceSize buddy = offset ^ (VkDeviceSize(1) << sizeClass);
+		auto it = block.freeLists[sizeClass].find(buddy);
+
+		if (it == block.freeLists[sizeClass].end())
+		{
+			break;
+		}
+
+		block.freeLists[sizeClass].erase(it);
+
+		offset = std::min(offset, buddy);
+		sizeClass++;
+	}
+
+	block.freeLists[sizeClass].insert(offset);
+}
+
+void MemoryAllocator::trackAllocation(VkDeviceSize size)
+{
+	statistics.liveAllocations++;
+	statistics.peakLiveAllocations = std::max(statistics.peakLiveAllocations, statistics.liveAllocations);
+	statistics.liveBytes += size;
+	statistics.peakLiveBytes = std::max(statistics.peakLiveBytes, statistics.liveBytes);
+}
+
+void MemoryAllocator::trackFree(VkDeviceSize size)
+{
+	statistics.liveAllocations--;
+	statistics.liveBytes -= size;
+}
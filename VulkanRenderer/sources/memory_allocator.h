@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <set>
+#include <vector>
+#include <cstdint>
+
+// Linear resources (buffers, linear images) and optimal tiling images are kept in separate pools, so
+// "bufferImageGranularity" never has to be honoured between neighbouring sub-allocations.
+enum AllocationType
+{
+	LINEAR_RESOURCE, OPTIMAL_RESOURCE
+};
+
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+
+	void* mapped = nullptr; // Persistently mapped address of "offset", only for host visible memory.
+
+	uint32_t poolIndex = UINT32_MAX; // UINT32_MAX for dedicated allocations.
+	uint32_t blockIndex = 0;
+	uint32_t sizeClass = 0;
+};
+
+class MemoryAllocator
+{
+public:
+	struct Statistics
+	{
+		VkDeviceSize liveBytes = 0;
+		VkDeviceSize peakLiveBytes = 0;
+		VkDeviceSize reservedBytes = 0;
+		VkDeviceSize peakReservedBytes = 0;
+
+		uint32_t liveAllocations = 0;
+		uint32_t peakLiveAllocations = 0;
+		uint32_t deviceAllocations = 0;
+		uint32_t peakDeviceAllocations = 0;
+		uint32_t dedicatedAllocations = 0;
+	};
+
+	MemoryAllocator() = default;
+
+	void init(VkPhysicalDevice gpu, VkDevice device);
+	void destroy();
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	// Large requests and explicitly "dedicated" ones (render targets) get their own device memory object.
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationType type, bool dedicated = false);
+	void free(MemoryAllocation& allocation);
+
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return memoryProperties; }
+	const Statistics& getStatistics() const { return statistics; }
+
+	void logStatistics() const;
+
+private:
+	// Every block is split as a buddy system: one free list per power-of-two size class, so a
+	// sub-allocation of class "k" always starts at a multiple of 2^k and satisfies any smaller alignment.
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+
+		std::vector<std::set<VkDeviceSize>> freeLists;
+
+		uint32_t liveAllocations = 0;
+	};
+
+	struct Pool
+	{
+		uint32_t memoryTypeIndex = 0;
+		AllocationType type = LINEAR_RESOURCE;
+
+		uint32_t blockSizeClass = 0;
+
+		std::vector<Block> blocks;
+	};
+
+	static const uint32_t MIN_SIZE_CLASS = 8; // 256 bytes.
+	static const uint32_t MAX_BLOCK_SIZE_CLASS = 26; // 64 MiB.
+	static const uint32_t MIN_BLOCK_SIZE_CLASS = 20; // 1 MiB.
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDeviceSize bufferImageGranularity = 1;
+
+	std::vector<Pool> pools;
+
+	Statistics statistics;
+
+	uint32_t getPoolIndex(uint32_t memoryTypeIndex, AllocationType type);
+	bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+	VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+	void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, bool mapped);
+
+	bool allocateFromBlock(Block& block, uint32_t blockSizeClass, uint32_t sizeClass, VkDeviceSize& offset);
+	void freeToBlock(Block& block, uint32_t blockSizeClass, uint32_t sizeClass, VkDeviceSize offset);
+
+	void trackAllocation(VkDeviceSize size);
+	void trackFree(VkDeviceSize size);
+};
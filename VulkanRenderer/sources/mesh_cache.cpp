@@ -0,0 +1,132 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <iostream>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t mix(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+
+	return value;
+}
+
+uint64_t MeshCache::hashData(const char* data, size_t size)
+{
+	// Word at a time multiply/rotate hash, only used to detect changes of the source file.
+	uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+	size_t i = 0;
+
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+
+		memcpy(&word, data + i, sizeof(word));
+
+		hash ^= mix(word * 0x87c37b91114253d5ull);
+		hash = (hash << 27 | hash >> 37) * 5 + 0x52dce729;
+	}
+
+	uint64_t tail = 0;
+
+	memcpy(&tail, data + i, size - i);
+
+	return mix(hash ^ mix(tail * 0x87c37b91114253d5ull));
+}
+
+bool MeshCache::open(const std::string& cachePath, uint64_t sourceHash, uint32_t vertexStride)
+{
+	close();
+
+	if (!file.open(cachePath) || file.getSize() < sizeof(Header))
+	{
+		file.close();
+
+		return false;
+	}
+
+	memcpy(&header, file.getData(), sizeof(Header));
+
+	uint64_t vertexBytes = header.vertexCount * vertexStride;
+	uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+	uint64_t lodBytes = header.lodCount * sizeof(MeshLod);
+
+	bool valid = header.magic == FILE_MAGIC && header.version == FILE_VERSION
+		&& header.sourceHash == sourceHash && header.vertexStride == vertexStride
+		&& header.vertexCount <= file.getSize() / vertexStride && header.indexCount <= file.getSize() / sizeof(uint32_t)
+		&& header.vertexOffset % SECTION_ALIGNMENT == 0 && header.indexOffset % SECTION_ALIGNMENT == 0
+		&& header.vertexOffset >= sizeof(Header) && header.vertexOffset <= file.getSize() - vertexBytes
+		&& header.indexOffset >= sizeof(Header) && header.indexOffset <= file.getSize() - indexBytes
+		&& header.lodCount <= file.getSize() / sizeof(MeshLod) && header.lodOffset % SECTION_ALIGNMENT == 0
+		&& header.lodOffset >= sizeof(Header) && header.lodOffset <= file.getSize() - lodBytes;
+
+	for (uint64_t i = 0; valid && i < header.lodCount; i++)
+	{
+		MeshLod lod;
+
+		memcpy(&lod, file.getData() + header.lodOffset + i * sizeof(MeshLod), sizeof(MeshLod));
+
+		valid = lod.firstIndex <= header.indexCount && lod.indexCount <= header.indexCount - lod.firstIndex;
+	}
+
+	if (!valid)
+	{
+		file.close();
+
+		header = Header{};
+
+		return false;
+	}
+
+	data = file.getData();
+
+	return true;
+}
+
+void MeshCache::store(const std::string& cachePath, uint64_t sourceHash, uint32_t vertexStride, const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	const MeshLod* lods, size_t lodCount)
+{
+	close();
+
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexStride = vertexStride;
+	header.vertexCount = vertexCount;
+	header.vertexOffset = alignUp(sizeof(Header), SECTION_ALIGNMENT);
+	header.indexCount = indexCount;
+	header.indexOffset = alignUp(header.vertexOffset + vertexCount * vertexStride, SECTION_ALIGNMENT);
+	header.lodCount = lodCount;
+	header.lodOffset = alignUp(header.indexOffset + indexCount * sizeof(uint32_t), SECTION_ALIGNMENT);
+
+	ownedData.assign(static_cast<size_t>(header.lodOffset + lodCount * sizeof(MeshLod)), 0);
+
+	memcpy(ownedData.data(), &header, sizeof(Header));
+	memcpy(ownedData.data() + header.vertexOffset, vertices, vertexCount * vertexStride);
+	memcpy(ownedData.data() + header.indexOffset, indices, indexCount * sizeof(uint32_t));
+	memcpy(ownedData.data() + header.lodOffset, lods, lodCount * sizeof(MeshLod));
+
+	data = ownedData.data();
+
+	if (!writeFileAtomically(cachePath, { ownedData }))
+	{
+		std::cerr << "[WARNING] Failed to write mesh cache to \"" << cachePath << "\"." << std::endl;
+	}
+}
+
+void MeshCache::close()
+{
+	file.close();
+
+	ownedData.clear();
+	ownedData.shrink_to_fit();
+
+	data = nullptr;
+	header = Header{};
+}
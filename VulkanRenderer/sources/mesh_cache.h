@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mapped_file.h"
+#include "mesh_simplifier.h"
+
+// Deduplicated vertex/index data, with its LOD chain, stored in a flat binary file that is memory mapped on load.
+// The file is keyed by a content hash of the source model, so editing the source invalidates it.
+class MeshCache
+{
+public:
+	MeshCache() = default;
+
+	static uint64_t hashData(const char* data, size_t size);
+
+	// Returns false when the file is missing, stale (source hash or vertex layout mismatch) or damaged.
+	bool open(const std::string& cachePath, uint64_t sourceHash, uint32_t vertexStride);
+
+	// Serializes the mesh and writes it to "cachePath". The serialized image is used as the backing
+	// storage from now on, even if writing the file fails. The levels index ranges of "indices".
+	void store(const std::string& cachePath, uint64_t sourceHash, uint32_t vertexStride, const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+		const MeshLod* lods, size_t lodCount);
+
+	void close();
+
+	const void* getVertexData() const { return data + header.vertexOffset; }
+	size_t getVertexCount() const { return static_cast<size_t>(header.vertexCount); }
+
+	const uint32_t* getIndexData() const { return reinterpret_cast<const uint32_t*>(data + header.indexOffset); }
+	size_t getIndexCount() const { return static_cast<size_t>(header.indexCount); }
+
+	const MeshLod* getLodData() const { return reinterpret_cast<const MeshLod*>(data + header.lodOffset); }
+	size_t getLodCount() const { return static_cast<size_t>(header.lodCount); }
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+
+		uint32_t vertexStride;
+		uint32_t reserved;
+
+		uint64_t vertexCount;
+		uint64_t vertexOffset;
+
+		uint64_t indexCount;
+		uint64_t indexOffset;
+
+		uint64_t lodCount;
+		uint64_t lodOffset;
+	};
+
+	static const uint32_t FILE_MAGIC = 0x434d5256; // "VRMC".
+	static const uint32_t FILE_VERSION = 3; // 2: meshes are stored optimized for the vertex cache and fetch. 3: LOD chains.
+	static const uint64_t SECTION_ALIGNMENT = 16;
+
+	MappedFile file;
+	std::vector<char> ownedData;
+
+	const char* data = nullptr;
+	Header header{};
+};
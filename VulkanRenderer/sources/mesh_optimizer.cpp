@@ -0,0 +1,332 @@
+#include "mesh_optimizer.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+static const uint32_t UNUSED_VERTEX = UINT32_MAX;
+
+VertexCacheStatistics analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics;
+
+	if (indices.empty())
+	{
+		return statistics;
+	}
+
+	// A vertex is cached while fewer than "cacheSize" others were inserted after it.
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+
+	uint32_t time = cacheSize + 1;
+	size_t misses = 0, usedVertices = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (time - timestamps[index] > cacheSize)
+		{
+			timestamps[index] = time++;
+			misses++;
+		}
+
+		if (!used[index])
+		{
+			used[index] = true;
+			usedVertices++;
+		}
+	}
+
+	statistics.acmr = static_cast<double>(misses) / (indices.size() / 3);
+	statistics.atvr = static_cast<double>(misses) / usedVertices;
+
+	return statistics;
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	clusters.clear();
+
+	// Triangles around every vertex, the ones not emitted yet are counted by "liveTriangles".
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+
+	for (uint32_t index : indices)
+	{
+		liveTriangles[index]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+
+	std::inclusive_scan(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> adjacencyCursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[adjacencyCursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> deadEnds, candidates, output;
+
+	output.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	// Recently used vertices first, then the input order.
+	auto skipDeadEnd = [&]() -> int64_t
+	{
+		while (!deadEnds.empty())
+		{
+			uint32_t vertex = deadEnds.back();
+
+			deadEnds.pop_back();
+
+			if (liveTriangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				return static_cast<int64_t>(cursor);
+			}
+		}
+
+		return -1;
+	};
+
+	int64_t fanningVertex = skipDeadEnd();
+	bool deadEnd = true;
+
+	while (fanningVertex >= 0)
+	{
+		if (deadEnd)
+		{
+			clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+		}
+
+		candidates.clear();
+
+		for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++)
+		{
+			uint32_t triangle = adjacency[i];
+
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+
+				liveTriangles[vertex]--;
+
+				if (time - timestamps[vertex] > cacheSize)
+				{
+					timestamps[vertex] = time++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// The candidate staying in the cache the longest, as long as fanning its remaining triangles won't evict it.
+		int64_t nextVertex = -1;
+		int64_t bestPriority = -1;
+
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+			{
+				continue;
+			}
+
+			int64_t age = time - timestamps[vertex];
+			int64_t priority = age + 2 * liveTriangles[vertex] <= cacheSize ? age : 0;
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = vertex;
+			}
+		}
+
+		deadEnd = nextVertex < 0;
+		fanningVertex = deadEnd ? skipDeadEnd() : nextVertex;
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const uint32_t> clusters, const float* positions, size_t vertexCount, size_t positionStride, uint32_t cacheSize, float threshold)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	double targetAcmr = analyzeVertexCache(indices, vertexCount, cacheSize).acmr * threshold;
+
+	// Every split starts from a cold cache, so it's only taken once the cluster has already done as well as the target.
+	std::vector<uint32_t> softClusters;
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+
+	uint32_t time = cacheSize + 1;
+
+	for (size_t i = 0; i < std::max<size_t>(clusters.size(), 1); i++)
+	{
+		uint32_t begin = clusters.empty() ? 0 : clusters[i];
+		uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+		uint32_t start = begin;
+		size_t misses = 0;
+
+		softClusters.push_back(begin);
+
+		time += cacheSize + 1;
+
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+
+				if (time - timestamps[vertex] > cacheSize)
+				{
+					timestamps[vertex] = time++;
+					misses++;
+				}
+			}
+
+			if (triangle + 1 < end && misses <= targetAcmr * (triangle + 1 - start))
+			{
+				softClusters.push_back(triangle + 1);
+
+				start = triangle + 1;
+				misses = 0;
+				time += cacheSize + 1;
+			}
+		}
+	}
+
+	auto position = [&](uint32_t vertex, uint32_t component)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride)[component];
+	};
+
+	// Area weighted center and normal of every cluster.
+	size_t clusterCount = softClusters.size();
+
+	std::vector<float> centers(clusterCount * 3, 0.0f), normals(clusterCount * 3, 0.0f), areas(clusterCount, 0.0f);
+
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		uint32_t end = cluster + 1 < clusterCount ? softClusters[cluster + 1] : triangleCount;
+
+		for (uint32_t triangle = softClusters[cluster]; triangle < end; triangle++)
+		{
+			uint32_t a = indices[triangle * 3 + 0], b = indices[triangle * 3 + 1], c = indices[triangle * 3 + 2];
+
+			float ab[3], ac[3], normal[3];
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				ab[k] = position(b, k) - position(a, k);
+				ac[k] = position(c, k) - position(a, k);
+			}
+
+			normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+			normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+			normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+
+			float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				float center = (position(a, k) + position(b, k) + position(c, k)) / 3.0f;
+
+				centers[cluster * 3 + k] += center * area;
+				normals[cluster * 3 + k] += normal[k];
+				meshCenter[k] += center * area;
+			}
+
+			areas[cluster] += area;
+			meshArea += area;
+		}
+	}
+
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		const float* normal = &normals[cluster * 3];
+
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		if (areas[cluster] <= 0.0f || length <= 0.0f || meshArea <= 0.0f)
+		{
+			continue;
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			sortKeys[cluster] += (centers[cluster * 3 + k] / areas[cluster] - meshCenter[k] / meshArea) * normal[k] / length;
+		}
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+
+	output.reserve(indices.size());
+
+	for (uint32_t cluster : order)
+	{
+		uint32_t end = cluster + 1 < clusterCount ? softClusters[cluster + 1] : triangleCount;
+
+		output.insert(output.end(), indices.begin() + softClusters[cluster] * 3, indices.begin() + end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+uint32_t optimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& remap)
+{
+	remap.assign(vertexCount, UNUSED_VERTEX);
+
+	uint32_t usedVertices = 0;
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UNUSED_VERTEX)
+		{
+			remap[index] = usedVertices++;
+		}
+
+		index = remap[index];
+	}
+
+	return usedVertices;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Post-transform cache efficiency of a triangle list, from a FIFO cache simulation.
+struct VertexCacheStatistics
+{
+	double acmr = 0.0; // Average cache miss ratio, vertices transformed per triangle (0.5 at best, 3 at worst).
+	double atvr = 0.0; // Average transformed vertex ratio, vertices transformed per vertex used (1 at best).
+};
+
+const uint32_t VERTEX_CACHE_SIZE = 16; // Entries of the simulated cache, also targeted by the triangle reorder.
+
+const float OVERDRAW_THRESHOLD = 1.05f; // ACMR the cluster reorder may cost, relative to the cache optimized order.
+
+VertexCacheStatistics analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander, Nehab and Barczak, 2007): reorders the triangles for a post-transform cache of "cacheSize"
+// entries in linear time. "clusters" receives the first triangle of every run starting after a dead end, where
+// no cached vertex carries over, so the runs can be reordered without hurting the cache.
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& clusters);
+
+// Splits the clusters further wherever their own ACMR gets within "threshold" of the whole mesh's, then sorts them
+// by how much they face away from the mesh center. Outer surfaces are drawn first, so from most viewpoints the
+// depth test rejects the fragments hidden behind them. Positions are 3 floats every "positionStride" bytes.
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const uint32_t> clusters, const float* positions, size_t vertexCount, size_t positionStride, uint32_t cacheSize, float threshold);
+
+// Renumbers the vertices in order of first use by the indices, so vertex fetches walk the buffer forward. "remap"
+// maps every old vertex to its new slot (UINT32_MAX when unused), the number of used vertices is returned.
+uint32_t optimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& remap);
@@ -0,0 +1,547 @@
+#include "mesh_simplifier.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+static const uint32_t NO_VERTEX = UINT32_MAX;
+
+static const double BOUNDARY_WEIGHT = 10.0; // Of the planes holding borders and seams in place, relative to the faces.
+
+// Weighted sum of squared distances to planes, Q(p) = pAp + 2bp + c, evaluated per unit of weight.
+struct Quadric
+{
+	double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+
+	double weight = 0.0;
+};
+
+enum class VertexKind : uint8_t
+{
+	MANIFOLD, // Interior, collapses towards any neighbour.
+	BORDER,   // On an open border, collapses along it.
+	SEAM,     // One of the two vertices of a UV seam, collapses along it with its counterpart.
+	LOCKED
+};
+
+// Triangles around every vertex.
+struct Adjacency
+{
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+};
+
+static void addPlane(Quadric& quadric, const double* normal, double distance, double weight)
+{
+	quadric.a00 += weight * normal[0] * normal[0];
+	quadric.a11 += weight * normal[1] * normal[1];
+	quadric.a22 += weight * normal[2] * normal[2];
+	quadric.a01 += weight * normal[0] * normal[1];
+	quadric.a02 += weight * normal[0] * normal[2];
+	quadric.a12 += weight * normal[1] * normal[2];
+
+	quadric.b0 += weight * normal[0] * distance;
+	quadric.b1 += weight * normal[1] * distance;
+	quadric.b2 += weight * normal[2] * distance;
+
+	quadric.c += weight * distance * distance;
+
+	quadric.weight += weight;
+}
+
+static void addQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a00 += other.a00;
+	quadric.a11 += other.a11;
+	quadric.a22 += other.a22;
+	quadric.a01 += other.a01;
+	quadric.a02 += other.a02;
+	quadric.a12 += other.a12;
+
+	quadric.b0 += other.b0;
+	quadric.b1 += other.b1;
+	quadric.b2 += other.b2;
+
+	quadric.c += other.c;
+
+	quadric.weight += other.weight;
+}
+
+static double evaluateQuadric(const Quadric& quadric, const float* position)
+{
+	double x = position[0], y = position[1], z = position[2];
+
+	double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z
+		+ 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+		+ 2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+
+	return quadric.weight > 0.0 ? std::abs(error) / quadric.weight : 0.0;
+}
+
+static void cross(const double* a, const double* b, double* result)
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double normalize(double* vector)
+{
+	double length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+
+	if (length > 0.0)
+	{
+		vector[0] /= length;
+		vector[1] /= length;
+		vector[2] /= length;
+	}
+
+	return length;
+}
+
+static void buildAdjacency(std::span<const uint32_t> indices, size_t vertexCount, Adjacency& adjacency)
+{
+	adjacency.offsets.assign(vertexCount + 1, 0);
+	adjacency.triangles.resize(indices.size());
+
+	for (uint32_t index : indices)
+	{
+		adjacency.offsets[index + 1]++;
+	}
+
+	std::inclusive_scan(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+	std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency.triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+}
+
+// Whether a triangle winds from "a" to "b".
+static bool hasEdge(const Adjacency& adjacency, std::span<const uint32_t> indices, uint32_t a, uint32_t b)
+{
+	for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; i++)
+	{
+		const uint32_t* triangle = &indices[adjacency.triangles[i] * 3];
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			if (triangle[corner] == a && triangle[(corner + 1) % 3] == b)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices, const float* positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError, float* resultError)
+{
+	std::vector<uint32_t> result(indices.begin(), indices.end());
+
+	auto position = [&](uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+	};
+
+	// Vertices with equal positions are linked in a ring by "wedges", "remap" points to the first one of them.
+	std::vector<uint32_t> remap(vertexCount), wedges(vertexCount), order(vertexCount);
+
+	std::iota(order.begin(), order.end(), 0);
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		const float* pa = position(a);
+		const float* pb = position(b);
+
+		return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+	});
+
+	for (size_t begin = 0, end = 0; begin < vertexCount; begin = end)
+	{
+		const float* first = position(order[begin]);
+
+		for (end = begin + 1; end < vertexCount && std::equal(first, first + 3, position(order[end])); end++)
+		{
+		}
+
+		for (size_t i = begin; i < end; i++)
+		{
+			remap[order[i]] = order[begin];
+			wedges[order[i]] = order[i + 1 < end ? i + 1 : begin];
+		}
+	}
+
+	// Quadrics are kept per position, so both sides of a seam measure the same surface.
+	std::vector<Quadric> quadrics(vertexCount);
+
+	std::vector<VertexKind> kinds(vertexCount);
+	std::vector<uint32_t> openNext(vertexCount), openPrevious(vertexCount);
+	std::vector<bool> openPositions(vertexCount);
+
+	std::vector<uint32_t> positionIndices, collapses(vertexCount);
+	std::vector<bool> locked(vertexCount);
+
+	Adjacency adjacency, positionAdjacency;
+
+	struct Collapse
+	{
+		uint32_t vertex;
+		uint32_t target;
+		double error;
+	};
+
+	std::vector<Collapse> candidates;
+
+	double errorLimit = static_cast<double>(targetError) * targetError;
+	double maxError = 0.0;
+
+	targetIndexCount -= targetIndexCount % 3;
+
+	for (uint32_t pass = 0; result.size() > targetIndexCount; pass++)
+	{
+		buildAdjacency(result, vertexCount, adjacency);
+
+		positionIndices.resize(result.size());
+
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			positionIndices[i] = remap[result[i]];
+		}
+
+		buildAdjacency(positionIndices, vertexCount, positionAdjacency);
+
+		// Open edges, the ones without a twin winding the other way, in vertex and in position space.
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			uint32_t openOut = 0, openIn = 0;
+
+			openNext[vertex] = NO_VERTEX;
+			openPrevious[vertex] = NO_VERTEX;
+
+			for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++)
+			{
+				const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+				uint32_t corner = triangle[0] == vertex ? 0 : triangle[1] == vertex ? 1 : 2;
+
+				uint32_t next = triangle[(corner + 1) % 3];
+				uint32_t previous = triangle[(corner + 2) % 3];
+
+				if (!hasEdge(adjacency, result, next, vertex))
+				{
+					openNext[vertex] = next;
+					openOut++;
+				}
+
+				if (!hasEdge(adjacency, result, vertex, previous))
+				{
+					openPrevious[vertex] = previous;
+					openIn++;
+				}
+			}
+
+			bool openPosition = false;
+
+			if (remap[vertex] == vertex)
+			{
+				for (uint32_t i = positionAdjacency.offsets[vertex]; i < positionAdjacency.offsets[vertex + 1] && !openPosition; i++)
+				{
+					const uint32_t* triangle = &positionIndices[positionAdjacency.triangles[i] * 3];
+
+					for (uint32_t corner = 0; corner < 3; corner++)
+					{
+						uint32_t next = triangle[(corner + 1) % 3];
+
+						if (triangle[corner] == vertex && !hasEdge(positionAdjacency, positionIndices, next, vertex))
+						{
+							openPosition = true;
+						}
+					}
+				}
+
+				openPositions[vertex] = openPosition;
+			}
+
+			if (openOut == 0 && openIn == 0)
+			{
+				kinds[vertex] = wedges[vertex] == vertex ? VertexKind::MANIFOLD : VertexKind::LOCKED;
+			}
+			else if (openOut == 1 && openIn == 1 && wedges[vertex] == vertex)
+			{
+				kinds[vertex] = VertexKind::BORDER;
+			}
+			else if (openOut == 1 && openIn == 1 && wedges[wedges[vertex]] == vertex)
+			{
+				kinds[vertex] = VertexKind::SEAM; // Unless the seam reaches a border, checked below once every position is known.
+			}
+			else
+			{
+				kinds[vertex] = VertexKind::LOCKED;
+			}
+		}
+
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			if (kinds[vertex] == VertexKind::SEAM && openPositions[remap[vertex]])
+			{
+				kinds[vertex] = VertexKind::LOCKED;
+			}
+		}
+
+		if (pass == 0)
+		{
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				const float* p0 = position(result[i + 0]);
+				const float* p1 = position(result[i + 1]);
+				const float* p2 = position(result[i + 2]);
+
+				double edge1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				double edge2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				double normal[3];
+
+				cross(edge1, edge2, normal);
+
+				double area = normalize(normal) * 0.5;
+
+				if (area <= 0.0)
+				{
+					continue;
+				}
+
+				double distance = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					addPlane(quadrics[remap[result[i + corner]]], normal, distance, area);
+				}
+
+				// Borders and seams also keep to a plane through the edge, perpendicular to the face.
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = result[i + corner], b = result[i + (corner + 1) % 3];
+
+					if (hasEdge(adjacency, result, b, a))
+					{
+						continue;
+					}
+
+					const float* pa = position(a);
+					const float* pb = position(b);
+
+					double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+					double edgeNormal[3];
+
+					cross(edge, normal, edgeNormal);
+
+					double length = normalize(edgeNormal);
+					double edgeDistance = -(edgeNormal[0] * pa[0] + edgeNormal[1] * pa[1] + edgeNormal[2] * pa[2]);
+
+					addPlane(quadrics[remap[a]], edgeNormal, edgeDistance, length * length * BOUNDARY_WEIGHT);
+					addPlane(quadrics[remap[b]], edgeNormal, edgeDistance, length * length * BOUNDARY_WEIGHT);
+				}
+			}
+		}
+
+		auto canCollapse = [&](uint32_t vertex, uint32_t target)
+		{
+			if (remap[vertex] == remap[target])
+			{
+				return false;
+			}
+
+			switch (kinds[vertex])
+			{
+			case VertexKind::MANIFOLD:
+				return true;
+			case VertexKind::BORDER:
+			case VertexKind::SEAM:
+				return (target == openNext[vertex] || target == openPrevious[vertex]) && (kinds[target] == kinds[vertex] || kinds[target] == VertexKind::LOCKED);
+			default:
+				return false;
+			}
+		};
+
+		candidates.clear();
+
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t a = result[i + corner], b = result[i + (corner + 1) % 3];
+
+				if (canCollapse(a, b))
+				{
+					candidates.push_back({ a, b, evaluateQuadric(quadrics[remap[a]], position(b)) });
+				}
+
+				if (canCollapse(b, a))
+				{
+					candidates.push_back({ b, a, evaluateQuadric(quadrics[remap[b]], position(a)) });
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		// Whether moving "vertex" to "target" turns any of its remaining triangles over.
+		auto flipsTriangles = [&](uint32_t vertex, uint32_t target)
+		{
+			const float* pt = position(target);
+
+			for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++)
+			{
+				const uint32_t* triangle = &result[adjacency.triangles[i] * 3];
+
+				if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+				{
+					continue;
+				}
+
+				uint32_t corner = triangle[0] == vertex ? 0 : triangle[1] == vertex ? 1 : 2;
+
+				const float* pv = position(vertex);
+				const float* pb = position(triangle[(corner + 1) % 3]);
+				const float* pc = position(triangle[(corner + 2) % 3]);
+
+				double oldEdge1[3] = { pb[0] - pv[0], pb[1] - pv[1], pb[2] - pv[2] };
+				double oldEdge2[3] = { pc[0] - pv[0], pc[1] - pv[1], pc[2] - pv[2] };
+				double newEdge1[3] = { pb[0] - pt[0], pb[1] - pt[1], pb[2] - pt[2] };
+				double newEdge2[3] = { pc[0] - pt[0], pc[1] - pt[1], pc[2] - pt[2] };
+				double oldNormal[3], newNormal[3];
+
+				cross(oldEdge1, oldEdge2, oldNormal);
+				cross(newEdge1, newEdge2, newNormal);
+
+				if (oldNormal[0] * newNormal[0] + oldNormal[1] * newNormal[1] + oldNormal[2] * newNormal[2] <= 0.0)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		};
+
+		std::iota(collapses.begin(), collapses.end(), 0);
+		std::fill(locked.begin(), locked.end(), false);
+
+		size_t triangleCount = result.size() / 3;
+		size_t collapseCount = 0;
+
+		// A position collapses at most once per pass, and none collapses into one that moved.
+		for (const Collapse& collapse : candidates)
+		{
+			if (triangleCount * 3 <= targetIndexCount || collapse.error > errorLimit)
+			{
+				break;
+			}
+
+			uint32_t vertex = collapse.vertex, target = collapse.target;
+
+			if (locked[remap[vertex]] || locked[remap[target]])
+			{
+				continue;
+			}
+
+			uint32_t sibling = vertex, siblingTarget = target;
+
+			if (kinds[vertex] == VertexKind::SEAM)
+			{
+				sibling = wedges[vertex];
+
+				if (kinds[sibling] != VertexKind::SEAM)
+				{
+					continue;
+				}
+
+				if (openNext[sibling] != NO_VERTEX && remap[openNext[sibling]] == remap[target])
+				{
+					siblingTarget = openNext[sibling];
+				}
+				else if (openPrevious[sibling] != NO_VERTEX && remap[openPrevious[sibling]] == remap[target])
+				{
+					siblingTarget = openPrevious[sibling];
+				}
+				else
+				{
+					continue;
+				}
+			}
+
+			if (flipsTriangles(vertex, target) || (sibling != vertex && flipsTriangles(sibling, siblingTarget)))
+			{
+				continue;
+			}
+
+			collapses[vertex] = target;
+			collapses[sibling] = siblingTarget;
+
+			locked[remap[vertex]] = true;
+			locked[remap[target]] = true;
+
+			addQuadric(quadrics[remap[target]], quadrics[remap[vertex]]);
+
+			maxError = std::max(maxError, collapse.error);
+			triangleCount -= kinds[vertex] == VertexKind::BORDER ? 1 : 2;
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		// Triangles that lost an edge are gone.
+		size_t writeIndex = 0;
+
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = collapses[result[i + 0]], b = collapses[result[i + 1]], c = collapses[result[i + 2]];
+
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+			{
+				continue;
+			}
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+
+		result.resize(writeIndex);
+	}
+
+	if (resultError != nullptr)
+	{
+		*resultError = static_cast<float>(std::sqrt(maxError));
+	}
+
+	return result;
+}
+
+uint32_t selectMeshLod(std::span<const MeshLod> lods, uint32_t previous, float errorScale)
+{
+	uint32_t coarsest = 0, loosest = 0;
+
+	for (uint32_t level = 1; level < lods.size(); level++)
+	{
+		float projectedError = lods[level].error * errorScale;
+
+		if (projectedError <= 1.0f - LOD_HYSTERESIS)
+		{
+			coarsest = level;
+		}
+
+		if (projectedError <= 1.0f + LOD_HYSTERESIS)
+		{
+			loosest = level;
+		}
+	}
+
+	return std::clamp(previous, coarsest, loosest);
+}
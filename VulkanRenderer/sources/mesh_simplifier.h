@@ -0,0 +1,32 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A level of the LOD chain: a range of the shared index list drawing a simplified version of the mesh, with the
+// same vertices. Level 0 is the full mesh.
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // Object space distance between the simplified surface and the full one, as estimated by the quadrics.
+	uint32_t reserved;
+};
+
+const float LOD_HYSTERESIS = 0.25f; // Margin around the tolerated error a level must cross before it changes.
+
+// Quadric error metric simplification (Garland and Heckbert, 1997) by half edge collapses, so vertices are only
+// removed, never moved, and the result indexes the same vertex buffer. Vertices sharing a position with another
+// one (UV seams) only collapse along the seam, together with their counterpart on the other side, open borders
+// only along the border, so neither one cracks. Collapses are taken cheapest first until "targetIndexCount" is
+// reached or the next one would move the surface further than "targetError". Positions are 3 floats every
+// "positionStride" bytes, "resultError" receives the largest error reached.
+std::vector<uint32_t> simplifyMesh(std::span<const uint32_t> indices, const float* positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+// Picks a level from its error projected on screen, "errorScale" converts object space errors to multiples of
+// the tolerated one. The coarsest level within tolerance is drawn, but "previous" is kept as long as its own
+// error stays within LOD_HYSTERESIS of the tolerance, so levels don't pop back and forth. Errors must grow
+// with the level.
+uint32_t selectMeshLod(std::span<const MeshLod> lods, uint32_t previous, float errorScale);
@@ -0,0 +1,155 @@
+#include "meshlet_builder.h"
+
+#include <cmath>
+#include <algorithm>
+
+static void computeMeshletBounds(Meshlet& meshlet, std::span<const uint32_t> indices, const float* positions, size_t positionStride)
+{
+	auto position = [&](uint32_t vertex, uint32_t component)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride)[component];
+	};
+
+	std::span<const uint32_t> meshletIndices = indices.subspan(meshlet.firstIndex, meshlet.indexCount);
+
+	float minimum[3] = { INFINITY, INFINITY, INFINITY };
+	float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	for (uint32_t index : meshletIndices)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			minimum[k] = std::min(minimum[k], position(index, k));
+			maximum[k] = std::max(maximum[k], position(index, k));
+		}
+	}
+
+	float center[3], radius = 0.0f;
+
+	for (uint32_t k = 0; k < 3; k++)
+	{
+		center[k] = 0.5f * (minimum[k] + maximum[k]);
+	}
+
+	for (uint32_t index : meshletIndices)
+	{
+		float dx = position(index, 0) - center[0], dy = position(index, 1) - center[1], dz = position(index, 2) - center[2];
+
+		radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+	}
+
+	// Unit normals of the non degenerate triangles, the axis is their normalized sum.
+	std::vector<float> normals;
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	normals.reserve(meshletIndices.size());
+
+	for (size_t i = 0; i < meshletIndices.size(); i += 3)
+	{
+		uint32_t a = meshletIndices[i + 0], b = meshletIndices[i + 1], c = meshletIndices[i + 2];
+
+		float ab[3], ac[3];
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			ab[k] = position(b, k) - position(a, k);
+			ac[k] = position(c, k) - position(a, k);
+		}
+
+		float normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		if (length <= 0.0f)
+		{
+			continue;
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			normals.push_back(normal[k] / length);
+			axis[k] += normal[k] / length;
+		}
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float minimumDot = 1.0f;
+
+	if (axisLength > 0.0f)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			axis[k] /= axisLength;
+		}
+
+		for (size_t i = 0; i < normals.size(); i += 3)
+		{
+			minimumDot = std::min(minimumDot, normals[i] * axis[0] + normals[i + 1] * axis[1] + normals[i + 2] * axis[2]);
+		}
+	}
+
+	meshlet.boundingSphere[0] = center[0];
+	meshlet.boundingSphere[1] = center[1];
+	meshlet.boundingSphere[2] = center[2];
+	meshlet.boundingSphere[3] = radius;
+
+	meshlet.cone[0] = axis[0];
+	meshlet.cone[1] = axis[1];
+	meshlet.cone[2] = axis[2];
+
+	// Past ~84 degrees from the axis the cone could only cull from a sliver of directions.
+	meshlet.cone[3] = axisLength > 0.0f && minimumDot > 0.1f ? std::sqrt(1.0f - minimumDot * minimumDot) : 1.0f;
+}
+
+std::vector<Meshlet> buildMeshlets(std::span<const uint32_t> indices, const float* positions, size_t vertexCount, size_t positionStride, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+
+	// Vertices of the current meshlet are stamped with its number, so nothing is cleared between meshlets.
+	std::vector<uint32_t> stamps(vertexCount, UINT32_MAX);
+
+	auto countNewVertices = [&](size_t first, uint32_t stamp)
+	{
+		uint32_t a = indices[first], b = indices[first + 1], c = indices[first + 2];
+
+		// Repeated corners of degenerate triangles count once.
+		return (stamps[a] != stamp ? 1u : 0u) + (stamps[b] != stamp && b != a ? 1u : 0u) + (stamps[c] != stamp && c != a && c != b ? 1u : 0u);
+	};
+
+	Meshlet meshlet{};
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		uint32_t stamp = static_cast<uint32_t>(meshlets.size());
+		uint32_t newVertices = countNewVertices(i, stamp);
+
+		if (meshlet.indexCount > 0 && (meshlet.vertexCount + newVertices > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles))
+		{
+			computeMeshletBounds(meshlet, indices, positions, positionStride);
+
+			meshlets.push_back(meshlet);
+
+			meshlet = {};
+			meshlet.firstIndex = static_cast<uint32_t>(i);
+
+			stamp++;
+			newVertices = countNewVertices(i, stamp);
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			stamps[indices[i + corner]] = stamp;
+		}
+
+		meshlet.vertexCount += newVertices;
+		meshlet.indexCount += 3;
+	}
+
+	if (meshlet.indexCount > 0)
+	{
+		computeMeshletBounds(meshlet, indices, positions, positionStride);
+
+		meshlets.push_back(meshlet);
+	}
+
+	return meshlets;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A run of consecutive triangles of an index list, with bounds for culling. Matches the std430 layout of the
+// culling shader.
+struct Meshlet
+{
+	uint32_t firstIndex; // A multiple of 3.
+	uint32_t indexCount;
+	uint32_t vertexCount; // Unique vertices referenced.
+	uint32_t padding;
+
+	float boundingSphere[4]; // Center and radius.
+
+	// Axis (average triangle normal) and cutoff of the normal cone. Every triangle faces away from a viewer at
+	// "position" when dot(center - position, axis) >= cutoff * length(center - position) + radius. A cutoff of
+	// 1 never passes, the normals are spread too wide.
+	float cone[4];
+};
+
+// Scans the triangles in order, starting a new meshlet whenever the next one would exceed "maxVertices" unique
+// vertices or "maxTriangles" triangles. The index list isn't modified, so meshlets follow its (vertex cache
+// optimized) order and can be drawn as index ranges by the regular vertex pipeline. Positions are 3 floats
+// every "positionStride" bytes, triangles wind counter clockwise seen from the front.
+std::vector<Meshlet> buildMeshlets(std::span<const uint32_t> indices, const float* positions, size_t vertexCount, size_t positionStride, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,287 @@
+#include "mipmap_generator.h"
+
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+bool MipmapGenerator::isSupported(VkPhysicalDevice gpu)
+{
+	VkFormatProperties formatProperties{};
+
+	vkGetPhysicalDeviceFormatProperties(gpu, STORAGE_FORMAT, &formatProperties);
+
+	return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+}
+
+void MipmapGenerator::init(VkDevice device, PipelineCache& pipelineCache, const std::vector<char>& shaderCode)
+{
+	this->device = device;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = LEVELS_PER_DISPATCH;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mipmap generator descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mipmap generator pipeline layout!");
+	}
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = shaderCode.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+
+	if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module!");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateComputePipelines(device, pipelineCache.get(), 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mipmap generator pipeline!");
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	pipelineCache.reportCreationTime("MipmapGenerator compute pipeline", std::chrono::duration<double, std::milli>(endTime - startTime).count());
+
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void MipmapGenerator::destroy()
+{
+	releaseResources();
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+void MipmapGenerator::record(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb)
+{
+	uint32_t dispatchCount = (mipLevels - 1 + LEVELS_PER_DISPATCH - 1) / LEVELS_PER_DISPATCH;
+
+	VkImageMemoryBarrier imageBarrier{};
+
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel = 0;
+	imageBarrier.subresourceRange.levelCount = mipLevels;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount = 1;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+	if (dispatchCount > 0)
+	{
+		VkDescriptorPoolSize poolSize{};
+
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSize.descriptorCount = dispatchCount * (1 + LEVELS_PER_DISPATCH);
+
+		VkDescriptorPoolCreateInfo poolCreateInfo{};
+
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.poolSizeCount = 1;
+		poolCreateInfo.pPoolSizes = &poolSize;
+		poolCreateInfo.maxSets = dispatchCount;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+		if (vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create mipmap generator descriptor pool!");
+		}
+
+		descriptorPools.push_back(descriptorPool);
+
+		size_t firstView = imageViews.size();
+
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			imageViews.push_back(createLevelView(image, i));
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		for (uint32_t dispatch = 0; dispatch < dispatchCount; dispatch++)
+		{
+			uint32_t sourceLevel = dispatch * LEVELS_PER_DISPATCH;
+			uint32_t levelCount = std::min(LEVELS_PER_DISPATCH, mipLevels - 1 - sourceLevel);
+
+			VkDescriptorSetAllocateInfo allocateInfo{};
+
+			allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocateInfo.descriptorPool = descriptorPool;
+			allocateInfo.descriptorSetCount = 1;
+			allocateInfo.pSetLayouts = &descriptorSetLayout;
+
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+			if (vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate mipmap generator descriptor set!");
+			}
+
+			// Slots past the last level of the dispatch repeat it, they are never written.
+			std::array<VkDescriptorImageInfo, 1 + LEVELS_PER_DISPATCH> imageInfos{};
+
+			for (uint32_t i = 0; i < imageInfos.size(); i++)
+			{
+				imageInfos[i].imageView = imageViews[firstView + sourceLevel + std::min(i, levelCount)];
+				imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			}
+
+			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[0].dstSet = descriptorSet;
+			descriptorWrites[0].dstBinding = 0;
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptorWrites[0].descriptorCount = 1;
+			descriptorWrites[0].pImageInfo = &imageInfos[0];
+
+			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[1].dstSet = descriptorSet;
+			descriptorWrites[1].dstBinding = 1;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			descriptorWrites[1].descriptorCount = LEVELS_PER_DISPATCH;
+			descriptorWrites[1].pImageInfo = &imageInfos[1];
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+			PushConstants pushConstants{};
+
+			pushConstants.sourceWidth = static_cast<int32_t>(std::max(width >> sourceLevel, 1u));
+			pushConstants.sourceHeight = static_cast<int32_t>(std::max(height >> sourceLevel, 1u));
+			pushConstants.levelCount = levelCount;
+			pushConstants.srgb = srgb ? 1 : 0;
+
+			if (dispatch > 0)
+			{
+				// The source of this dispatch is the last level written by the previous one.
+				VkMemoryBarrier memoryBarrier{};
+
+				memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+			uint32_t groupCountX = (pushConstants.sourceWidth + TILE_SIZE - 1) / TILE_SIZE;
+			uint32_t groupCountY = (pushConstants.sourceHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+		}
+	}
+
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+void MipmapGenerator::releaseResources()
+{
+	for (VkImageView imageView : imageViews)
+	{
+		vkDestroyImageView(device, imageView, nullptr);
+	}
+
+	for (VkDescriptorPool descriptorPool : descriptorPools)
+	{
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	}
+
+	imageViews.clear();
+	descriptorPools.clear();
+}
+
+VkImageView MipmapGenerator::createLevelView(VkImage image, uint32_t level)
+{
+	VkImageViewCreateInfo viewCreateInfo{};
+
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = STORAGE_FORMAT;
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = level;
+	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	VkImageView imageView = VK_NULL_HANDLE;
+
+	if (vkCreateImageView(device, &viewCreateInfo, nullptr, &imageView) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create mip level image view!");
+	}
+
+	return imageView;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "pipeline_cache.h"
+
+// Builds mip chains with a compute shader instead of a blit per level: each dispatch produces up to
+// "LEVELS_PER_DISPATCH" levels, keeping the intermediate ones in workgroup shared memory, so a 4096x4096
+// chain takes two dispatches and three barriers. Filtering is done in linear space for sRGB data and
+// only needs storage image support, not linear blits. The image must be created as "STORAGE_FORMAT" with
+// VK_IMAGE_USAGE_STORAGE_BIT (and VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT to be sampled through an sRGB view).
+class MipmapGenerator
+{
+public:
+	static constexpr uint32_t LEVELS_PER_DISPATCH = 6;
+	static constexpr uint32_t TILE_SIZE = 64; // Source texels per workgroup side.
+	static constexpr VkFormat STORAGE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+	MipmapGenerator() = default;
+
+	static bool isSupported(VkPhysicalDevice gpu);
+
+	void init(VkDevice device, PipelineCache& pipelineCache, const std::vector<char>& shaderCode);
+	void destroy();
+
+	bool isInitialized() const { return pipeline != VK_NULL_HANDLE; }
+
+	// Every level must be in TRANSFER_DST_OPTIMAL with level 0 written, they all end in SHADER_READ_ONLY_OPTIMAL.
+	// The views and descriptor sets of the recording are kept until "releaseResources" or "destroy", which must
+	// only be called once the command buffer has completed.
+	void record(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb);
+
+	void releaseResources();
+
+private:
+	struct PushConstants
+	{
+		int32_t sourceWidth;
+		int32_t sourceHeight;
+		uint32_t levelCount;
+		uint32_t srgb;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	std::vector<VkDescriptorPool> descriptorPools;
+	std::vector<VkImageView> imageViews;
+
+	VkImageView createLevelView(VkImage image, uint32_t level);
+};
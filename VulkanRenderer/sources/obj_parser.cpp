@@ -0,0 +1,320 @@
+#include "obj_parser.h"
+
+#include "parallel_for.h"
+
+#include <cstring>
+#include <charconv>
+
+// Parsed form of a run of complete lines. Relative (negative) face indices can't be resolved until
+// the attribute counts of the previous chunks are known, they are resolved against the chunk and
+// listed in "fixups" (as corner * 3 + component) to be offset when merging.
+struct ObjChunk
+{
+	const char* begin = nullptr;
+	const char* end = nullptr;
+
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+
+	std::vector<VertexKey> corners;
+	std::vector<uint64_t> fixups;
+
+	void clear()
+	{
+		positions.clear();
+		normals.clear();
+		texcoords.clear();
+		corners.clear();
+		fixups.clear();
+	}
+};
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static bool isSeparator(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static float parseFloat(const char*& p, const char* end)
+{
+	while (p < end && isSpace(*p))
+	{
+		p++;
+	}
+
+	const char* tokenEnd = p;
+
+	while (tokenEnd < end && !isSeparator(*tokenEnd))
+	{
+		tokenEnd++;
+	}
+
+	// Parsed as double and narrowed, as the tinyobj parser does.
+	double value = 0.0;
+
+	std::from_chars(p < tokenEnd && *p == '+' ? p + 1 : p, tokenEnd, value);
+
+	p = tokenEnd;
+
+	return static_cast<float>(value);
+}
+
+// Same behaviour as "atoi", anything that isn't a number reads as zero.
+static int32_t parseInteger(const char*& p, const char* end)
+{
+	bool negative = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p++ == '-';
+	}
+
+	int32_t value = 0;
+
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p++ - '0');
+	}
+
+	return negative ? -value : value;
+}
+
+// Resolves an OBJ face index against the number of attributes seen so far, returns true for relative
+// indices (resolved only against the chunk).
+static bool parseIndex(const char*& p, const char* end, size_t attributeCount, int32_t& index)
+{
+	int32_t value = parseInteger(p, end);
+	bool relative = value < 0;
+
+	index = value > 0 ? value - 1 : value == 0 ? 0 : static_cast<int32_t>(attributeCount) + value;
+
+	while (p < end && *p != '/' && !isSeparator(*p))
+	{
+		p++;
+	}
+
+	return relative;
+}
+
+static void parseChunk(ObjChunk& chunk)
+{
+	struct FaceVertex
+	{
+		VertexKey key;
+		uint32_t relativeMask; // Bits 0, 1 and 2 for position, normal and texcoord.
+	};
+
+	std::vector<FaceVertex> face;
+
+	for (const char* line = chunk.begin; line < chunk.end;)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(line, '\n', chunk.end - line));
+
+		lineEnd = lineEnd == nullptr ? chunk.end : lineEnd;
+
+		const char* next = lineEnd + 1;
+		const char* p = line;
+
+		line = next;
+
+		while (p < lineEnd && isSpace(*p))
+		{
+			p++;
+		}
+
+		if (lineEnd - p < 2 || p[0] == '#')
+		{
+			continue;
+		}
+
+		if (p[0] == 'v' && isSpace(p[1]))
+		{
+			p += 2;
+
+			chunk.positions.push_back(parseFloat(p, lineEnd));
+			chunk.positions.push_back(parseFloat(p, lineEnd));
+			chunk.positions.push_back(parseFloat(p, lineEnd));
+		}
+		else if (p[0] == 'v' && p[1] == 'n' && lineEnd - p > 2 && isSpace(p[2]))
+		{
+			p += 3;
+
+			chunk.normals.push_back(parseFloat(p, lineEnd));
+			chunk.normals.push_back(parseFloat(p, lineEnd));
+			chunk.normals.push_back(parseFloat(p, lineEnd));
+		}
+		else if (p[0] == 'v' && p[1] == 't' && lineEnd - p > 2 && isSpace(p[2]))
+		{
+			p += 3;
+
+			chunk.texcoords.push_back(parseFloat(p, lineEnd));
+			chunk.texcoords.push_back(parseFloat(p, lineEnd));
+		}
+		else if (p[0] == 'f' && isSpace(p[1]))
+		{
+			p += 2;
+
+			face.clear();
+
+			while (true)
+			{
+				while (p < lineEnd && isSeparator(*p))
+				{
+					p++;
+				}
+
+				if (p == lineEnd)
+				{
+					break;
+				}
+
+				FaceVertex vertex{ { -1, -1, -1 }, 0 };
+
+				vertex.relativeMask |= parseIndex(p, lineEnd, chunk.positions.size() / 3, vertex.key.position) << 0;
+
+				if (p < lineEnd && *p == '/')
+				{
+					p++;
+
+					if (p < lineEnd && *p == '/')
+					{
+						p++;
+
+						vertex.relativeMask |= parseIndex(p, lineEnd, chunk.normals.size() / 3, vertex.key.normal) << 1;
+					}
+					else
+					{
+						vertex.relativeMask |= parseIndex(p, lineEnd, chunk.texcoords.size() / 2, vertex.key.texcoord) << 2;
+
+						if (p < lineEnd && *p == '/')
+						{
+							p++;
+
+							vertex.relativeMask |= parseIndex(p, lineEnd, chunk.normals.size() / 3, vertex.key.normal) << 1;
+						}
+					}
+				}
+
+				face.push_back(vertex);
+			}
+
+			// Polygons are triangulated as fans, like tinyobj does.
+			for (size_t k = 2; k < face.size(); k++)
+			{
+				for (size_t i : { size_t(0), k - 1, k })
+				{
+					for (uint32_t component = 0; component < 3; component++)
+					{
+						if (face[i].relativeMask & (1 << component))
+						{
+							chunk.fixups.push_back(chunk.corners.size() * 3 + component);
+						}
+					}
+
+					chunk.corners.push_back(face[i].key);
+				}
+			}
+		}
+	}
+}
+
+void parseObj(const char* data, size_t size, uint32_t threadCount, ObjMesh& mesh)
+{
+	threadCount = std::max(1u, threadCount);
+
+	mesh.positions.clear();
+	mesh.normals.clear();
+	mesh.texcoords.clear();
+	mesh.corners.clear();
+
+	std::vector<ObjChunk> chunks(threadCount);
+
+	const char* cursor = data;
+	const char* dataEnd = data + size;
+
+	while (cursor < dataEnd)
+	{
+		// Cut the next chunk per worker, each ending after a line break.
+		size_t chunkCount = 0;
+
+		for (; chunkCount < threadCount && cursor < dataEnd; chunkCount++)
+		{
+			ObjChunk& chunk = chunks[chunkCount];
+
+			chunk.begin = cursor;
+			chunk.end = dataEnd - cursor > static_cast<ptrdiff_t>(OBJ_CHUNK_SIZE) ? cursor + OBJ_CHUNK_SIZE : dataEnd;
+
+			const char* lineEnd = static_cast<const char*>(memchr(chunk.end, '\n', dataEnd - chunk.end));
+
+			chunk.end = lineEnd == nullptr ? dataEnd : lineEnd + 1;
+
+			cursor = chunk.end;
+		}
+
+		parallelFor(chunkCount, threadCount, [&](size_t begin, size_t end, uint32_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				chunks[i].clear();
+
+				parseChunk(chunks[i]);
+			}
+		});
+
+		// Prefix sums of the chunk sizes give where every chunk lands in the merged arrays.
+		struct Offsets
+		{
+			size_t positions, normals, texcoords, corners;
+		};
+
+		std::vector<Offsets> offsets(chunkCount + 1);
+
+		offsets[0] = { mesh.positions.size(), mesh.normals.size(), mesh.texcoords.size(), mesh.corners.size() };
+
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			offsets[i + 1].positions = offsets[i].positions + chunks[i].positions.size();
+			offsets[i + 1].normals = offsets[i].normals + chunks[i].normals.size();
+			offsets[i + 1].texcoords = offsets[i].texcoords + chunks[i].texcoords.size();
+			offsets[i + 1].corners = offsets[i].corners + chunks[i].corners.size();
+		}
+
+		mesh.positions.resize(offsets[chunkCount].positions);
+		mesh.normals.resize(offsets[chunkCount].normals);
+		mesh.texcoords.resize(offsets[chunkCount].texcoords);
+		mesh.corners.resize(offsets[chunkCount].corners);
+
+		parallelFor(chunkCount, threadCount, [&](size_t begin, size_t end, uint32_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const ObjChunk& chunk = chunks[i];
+				const Offsets& offset = offsets[i];
+
+				std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + offset.positions);
+				std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + offset.normals);
+				std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh.texcoords.begin() + offset.texcoords);
+				std::copy(chunk.corners.begin(), chunk.corners.end(), mesh.corners.begin() + offset.corners);
+
+				int32_t bases[] = {
+					static_cast<int32_t>(offset.positions / 3),
+					static_cast<int32_t>(offset.normals / 3),
+					static_cast<int32_t>(offset.texcoords / 2)
+				};
+
+				for (uint64_t fixup : chunk.fixups)
+				{
+					VertexKey& key = mesh.corners[offset.corners + fixup / 3];
+					int32_t* components[] = { &key.position, &key.normal, &key.texcoord };
+
+					*components[fixup % 3] += bases[fixup % 3];
+				}
+			}
+		});
+	}
+}
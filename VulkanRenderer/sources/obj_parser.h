@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex_dedup.h"
+
+// Bytes of OBJ text parsed by a worker at a time. Only one chunk per worker is held in its parsed
+// form before being merged, so this bounds the intermediate memory of the parser.
+const size_t OBJ_CHUNK_SIZE = 8 * 1024 * 1024;
+
+// Geometry of an OBJ file, with the same layout and conventions as "tinyobj::attrib_t" and the
+// concatenated "tinyobj::mesh_t::indices" of all shapes (zero based, -1 when an attribute is missing,
+// polygons triangulated as fans).
+struct ObjMesh
+{
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+
+	std::vector<VertexKey> corners;
+};
+
+// Parses the "v", "vn", "vt" and "f" statements of an OBJ file held in memory, the rest is ignored.
+// The text is split at line boundaries into chunks that are parsed in parallel and merged in order.
+void parseObj(const char* data, size_t size, uint32_t threadCount, ObjMesh& mesh);
@@ -0,0 +1,224 @@
+#include "offscreen_target.h"
+
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+void OffscreenTarget::init(VkDevice device, MemoryAllocator& allocator, VkFormat format, VkExtent2D extent, uint32_t imageCount, bool readback)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->format = format;
+	this->extent = extent;
+
+	images.resize(imageCount);
+	imagesMemory.resize(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCreateInfo{};
+
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent = { extent.width, extent.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = format;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageCreateInfo, nullptr, &images[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create offscreen image!");
+		}
+
+		VkMemoryRequirements memoryRequirements{};
+
+		vkGetImageMemoryRequirements(device, images[i], &memoryRequirements);
+
+		imagesMemory[i] = allocator.allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, OPTIMAL_RESOURCE, true);
+
+		vkBindImageMemory(device, images[i], imagesMemory[i].memory, imagesMemory[i].offset);
+	}
+
+	if (!readback)
+	{
+		return;
+	}
+
+	readbackBuffers.resize(imageCount);
+	readbackBuffersMemory.resize(imageCount);
+	readbackPending.assign(imageCount, false);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkBufferCreateInfo bufferCreateInfo{};
+
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &readbackBuffers[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create readback buffer!");
+		}
+
+		VkMemoryRequirements memoryRequirements{};
+
+		vkGetBufferMemoryRequirements(device, readbackBuffers[i], &memoryRequirements);
+
+		readbackBuffersMemory[i] = allocator.allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, LINEAR_RESOURCE);
+
+		vkBindBufferMemory(device, readbackBuffers[i], readbackBuffersMemory[i].memory, readbackBuffersMemory[i].offset);
+	}
+}
+
+void OffscreenTarget::destroy()
+{
+	if (hasReadback())
+	{
+		std::cout << "[INFO] OFFSCREEN READBACK:" << std::endl;
+		std::cout << '\t' << "Frames read back: " << collectedFrames << std::endl;
+
+		if (collectedFrames > 0)
+		{
+			std::cout << '\t' << "Last frame checksum: " << std::hex << lastChecksum << std::dec << std::endl;
+
+			if (saveImage(READBACK_IMAGE_PATH))
+			{
+				std::cout << '\t' << "Last frame saved to: " << READBACK_IMAGE_PATH << std::endl;
+			}
+			else
+			{
+				std::cerr << "[WARNING] Failed to save offscreen frame to \"" << READBACK_IMAGE_PATH << "\"." << std::endl;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < readbackBuffers.size(); i++)
+	{
+		vkDestroyBuffer(device, readbackBuffers[i], nullptr);
+		allocator->free(readbackBuffersMemory[i]);
+	}
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		vkDestroyImage(device, images[i], nullptr);
+		allocator->free(imagesMemory[i]);
+	}
+
+	images.clear();
+	imagesMemory.clear();
+
+	readbackBuffers.clear();
+	readbackBuffersMemory.clear();
+	readbackPending.clear();
+}
+
+void OffscreenTarget::recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!hasReadback())
+	{
+		return;
+	}
+
+	// The render pass already left the image in TRANSFER_SRC_OPTIMAL. The source stage covers the end of the render pass
+	// (the implicit external dependency waits on BOTTOM_OF_PIPE), so the copy is ordered after the final layout transition.
+	VkImageMemoryBarrier imageBarrier{};
+
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = images[imageIndex];
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel = 0;
+	imageBarrier.subresourceRange.levelCount = 1;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount = 1;
+	imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+	VkBufferImageCopy region{};
+
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffers[imageIndex], 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier{};
+
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = readbackBuffers[imageIndex];
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	readbackPending[imageIndex] = true;
+}
+
+void OffscreenTarget::collect(uint32_t imageIndex)
+{
+	if (!hasReadback() || !readbackPending[imageIndex])
+	{
+		return;
+	}
+
+	const char* pixels = static_cast<const char*>(readbackBuffersMemory[imageIndex].mapped);
+	size_t size = static_cast<size_t>(extent.width) * extent.height * 4;
+
+	lastFrame.assign(pixels, pixels + size);
+	lastChecksum = MeshCache::hashData(pixels, size);
+
+	readbackPending[imageIndex] = false;
+	collectedFrames++;
+}
+
+bool OffscreenTarget::saveImage(const std::string& path) const
+{
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+	output << "P6\n" << extent.width << ' ' << extent.height << "\n255\n";
+
+	// Offscreen images are BGRA or RGBA, PPM wants RGB.
+	bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+	std::vector<uint8_t> row(static_cast<size_t>(extent.width) * 3);
+
+	for (uint32_t y = 0; y < extent.height; y++)
+	{
+		const uint8_t* pixel = lastFrame.data() + static_cast<size_t>(y) * extent.width * 4;
+
+		for (uint32_t x = 0; x < extent.width; x++, pixel += 4)
+		{
+			row[x * 3 + 0] = pixel[bgra ? 2 : 0];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[bgra ? 0 : 2];
+		}
+
+		output.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+
+	return output.good();
+}
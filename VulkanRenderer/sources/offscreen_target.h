@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "memory_allocator.h"
+
+// Color images standing in for the swap chain when rendering without a window, one per frame in flight.
+// With readback enabled every rendered image is also copied into a host visible buffer, so frames can be
+// checked (checksum, saved as a PPM file) on the CPU.
+class OffscreenTarget
+{
+public:
+	OffscreenTarget() = default;
+
+	void init(VkDevice device, MemoryAllocator& allocator, VkFormat format, VkExtent2D extent, uint32_t imageCount, bool readback);
+
+	// Saves the last collected frame to "READBACK_IMAGE_PATH" when readback is enabled.
+	void destroy();
+
+	const std::vector<VkImage>& getImages() const { return images; }
+	bool hasReadback() const { return !readbackBuffers.empty(); }
+
+	// Pixels of the last collected frame, in "format".
+	const std::vector<uint8_t>& getLastFrame() const { return lastFrame; }
+
+	// Records the copy of the image into its readback buffer, the image must be in TRANSFER_SRC_OPTIMAL layout.
+	void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Must be called once the submission that recorded the readback of "imageIndex" has finished.
+	void collect(uint32_t imageIndex);
+
+private:
+	static constexpr const char* READBACK_IMAGE_PATH = "headless_frame.ppm";
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent{};
+
+	std::vector<VkImage> images;
+	std::vector<MemoryAllocation> imagesMemory;
+
+	std::vector<VkBuffer> readbackBuffers;
+	std::vector<MemoryAllocation> readbackBuffersMemory;
+	std::vector<bool> readbackPending;
+
+	std::vector<uint8_t> lastFrame;
+	uint64_t lastChecksum = 0;
+	uint64_t collectedFrames = 0;
+
+	bool saveImage(const std::string& path) const;
+};
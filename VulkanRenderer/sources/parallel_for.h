@@ -0,0 +1,45 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+inline uint32_t getWorkerThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, count) into "threadCount" contiguous ranges and calls "function(begin, end, threadIndex)"
+// for each of them, the calling thread takes the first range.
+template<typename Function>
+void parallelFor(size_t count, uint32_t threadCount, Function&& function)
+{
+	threadCount = static_cast<uint32_t>(std::clamp<size_t>(threadCount, 1, std::max<size_t>(count, 1)));
+
+	if (threadCount == 1)
+	{
+		function(size_t(0), count, 0u);
+
+		return;
+	}
+
+	std::vector<std::thread> threads;
+
+	threads.reserve(threadCount - 1);
+
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back([&function, count, threadCount, i]()
+		{
+			function(count * i / threadCount, count * (i + 1) / threadCount, i);
+		});
+	}
+
+	function(size_t(0), count / threadCount, 0u);
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
@@ -0,0 +1,151 @@
+#include "pipeline_cache.h"
+
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+static uint64_t hashBytes(const char* data, size_t size)
+{
+	// FNV-1a, only used to catch truncated or damaged files.
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+void PipelineCache::init(VkPhysicalDevice gpu, VkDevice device, const std::string& path)
+{
+	this->device = device;
+	this->path = path;
+
+	vkGetPhysicalDeviceProperties(gpu, &deviceProperties);
+
+	std::vector<char> data = loadFile();
+
+	warm = !data.empty() && isCompatible(data);
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = warm ? data.size() : 0;
+	pipelineCacheCreateInfo.pInitialData = warm ? data.data() : nullptr;
+
+	if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache) != VK_SUCCESS)
+	{
+		warm = false;
+
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	std::cout << "[INFO] PIPELINE CACHE:" << std::endl;
+	std::cout << '\t' << "Path: " << path << std::endl;
+	std::cout << '\t' << "State: " << (warm ? "warm" : "cold") << " (" << (warm ? data.size() : 0) << " bytes loaded)" << std::endl;
+}
+
+void PipelineCache::destroy()
+{
+	size_t dataSize = 0;
+
+	vkGetPipelineCacheData(device, cache, &dataSize, nullptr);
+
+	std::vector<char> data(dataSize);
+
+	if (dataSize > 0 && vkGetPipelineCacheData(device, cache, &dataSize, data.data()) == VK_SUCCESS)
+	{
+		FileHeader header{};
+
+		header.magic = FILE_MAGIC;
+		header.version = FILE_VERSION;
+		header.dataSize = dataSize;
+		header.dataHash = hashBytes(data.data(), dataSize);
+
+		if (!writeFileAtomically(path, { { reinterpret_cast<const char*>(&header), sizeof(header) }, { data.data(), dataSize } }))
+		{
+			std::cerr << "[WARNING] Failed to write pipeline cache to \"" << path << "\"." << std::endl;
+		}
+	}
+
+	std::cout << "[INFO] PIPELINE CREATION:" << std::endl;
+	std::cout << '\t' << "Total time: " << std::fixed << std::setprecision(3) << totalCreationTime << std::defaultfloat << " ms (" << (warm ? "warm" : "cold") << " cache)" << std::endl;
+
+	vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+void PipelineCache::reportCreationTime(const std::string& pipelineName, double milliseconds)
+{
+	totalCreationTime += milliseconds;
+
+	std::cout << "[INFO] PIPELINE CREATED:" << std::endl;
+	std::cout << '\t' << pipelineName << ": " << std::fixed << std::setprecision(3) << milliseconds << std::defaultfloat << " ms (" << (warm ? "warm" : "cold") << " cache)" << std::endl;
+}
+
+std::vector<char> PipelineCache::loadFile()
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+
+	if (fileSize < sizeof(FileHeader))
+	{
+		return {};
+	}
+
+	FileHeader header{};
+
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.dataSize != fileSize - sizeof(FileHeader))
+	{
+		return {};
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.dataSize));
+
+	file.read(data.data(), data.size());
+
+	if (!file || hashBytes(data.data(), data.size()) != header.dataHash)
+	{
+		return {};
+	}
+
+	return data;
+}
+
+bool PipelineCache::isCompatible(const std::vector<char>& data)
+{
+	VkPipelineCacheHeaderVersionOne header{};
+
+	if (data.size() < sizeof(header))
+	{
+		return false;
+	}
+
+	memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) && header.headerSize <= data.size()
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == deviceProperties.vendorID
+		&& header.deviceID == deviceProperties.deviceID
+		&& memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// VkPipelineCache persisted between runs. The file holds a small header (magic, payload size and hash)
+// followed by the driver blob, which is only accepted when its "VkPipelineCacheHeaderVersionOne"
+// matches the current device. Anything else is discarded and the cache starts cold.
+class PipelineCache
+{
+public:
+	PipelineCache() = default;
+
+	void init(VkPhysicalDevice gpu, VkDevice device, const std::string& path);
+
+	// Writes the cache back to disk (through a temporary file and a rename) and destroys it.
+	void destroy();
+
+	VkPipelineCache get() const { return cache; }
+	bool isWarm() const { return warm; }
+
+	void reportCreationTime(const std::string& pipelineName, double milliseconds);
+
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	static const uint32_t FILE_MAGIC = 0x43505256; // "VRPC".
+	static const uint32_t FILE_VERSION = 1;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties deviceProperties{};
+
+	VkPipelineCache cache = VK_NULL_HANDLE;
+
+	std::string path;
+
+	bool warm = false;
+	double totalCreationTime = 0.0;
+
+	std::vector<char> loadFile();
+	bool isCompatible(const std::vector<char>& data);
+};
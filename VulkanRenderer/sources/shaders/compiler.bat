@@ -1,5 +1,7 @@
 C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=vertex draw_model_vs.glsl -o draw_model_vs.spv
 C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=fragment draw_model_fs.glsl -o draw_model_fs.spv
+C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=compute generate_mipmaps_cs.glsl -o generate_mipmaps_cs.spv
+C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=compute gpu_cull_cs.glsl -o gpu_cull_cs.spv
 
 C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=vertex draw_particles_vs.glsl -o draw_particles_vs.spv
 C:\VulkanSDK\1.3.283.0\Bin\glslc.exe -fshader-stage=fragment draw_particles_fs.glsl -o draw_particles_fs.spv
@@ -1,6 +1,5 @@
 #version 450
 
-layout(location = 0) in vec3 fragmentColor;
 layout(location = 1) in vec2 fragmentTexCoord;
 
 layout(location = 0) out vec4 outColor;
@@ -9,5 +8,5 @@ layout(binding = 1) uniform sampler2D texSampler;
 
 void main()
 {
-    outColor = vec4(fragmentColor * texture(texSampler, fragmentTexCoord).rgb, 1.0);
+    outColor = vec4(texture(texSampler, fragmentTexCoord).rgb, 1.0);
 }
@@ -1,10 +1,8 @@
 #version 450
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
-layout(location = 0) out vec3 fragmentColor;
 layout(location = 1) out vec2 fragmentTexCoord;
 
 layout(binding = 0) uniform UniformBufferObject
@@ -12,12 +10,27 @@ layout(binding = 0) uniform UniformBufferObject
     mat4 model;
     mat4 view;
     mat4 projection;
+    float time;
+    vec4 positionScale;
+    vec4 positionOffset;
 } UBO;
 
+struct InstanceData
+{
+    mat4 model;
+};
+
+layout(std140, binding = 2) readonly buffer InstanceSSBO
+{
+    InstanceData instances[ ];
+};
+
 void main()
 {
-    gl_Position = UBO.projection * UBO.view * UBO.model * vec4(inPosition, 1.0);
+    // Compact vertices hold SNORM16 positions within the mesh bounds, float ones get an identity transform.
+    vec3 position = UBO.positionOffset.xyz + UBO.positionScale.xyz * inPosition;
+
+    gl_Position = UBO.projection * UBO.view * instances[gl_InstanceIndex].model * vec4(position, 1.0);
 
-    fragmentColor = inColor;
     fragmentTexCoord = inTexCoord;
 }
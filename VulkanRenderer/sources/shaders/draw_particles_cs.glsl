@@ -1,50 +1,465 @@
 #version 450
 
-struct Particle
+// Spawns particles in a disc, moving away from its center.
+struct Emitter
 {
     vec2 position;
-    vec2 velocity;
-    vec4 color;
+    float radius;
+    float speed;
+    float rate;
+    float lifetime; // Mean, particles live between half and one and a half of it.
 };
 
 layout(binding = 0) uniform UniformBufferObject
 {
-    mat4 model;
-    mat4 view;
-    mat4 projection;
-    float time;
+    Emitter emitters[4];
+    uint emitterCount;
+    float timeStep; // Length of a simulation step, in seconds.
+    float aspectRatio;
+
+    float interactionRadius;
+    float separation;
+    float cohesion;
+    uint gridSize;  // Cells per side.
+    uint cellCount; // Padded to a multiple of the workgroup size.
 } UBO;
 
-layout(std140, binding = 1) readonly buffer ParticleSSBOIn
+// Structure of arrays over the slots of the chunk, the colors are only read by the vertex stage.
+layout(std430, binding = 1) buffer PositionSSBOIn
 {
-    Particle particlesIn[ ];
+    vec2 positionsIn[ ];
 };
 
-layout(std140, binding = 2) buffer ParticleSSBOOut
+layout(std430, binding = 2) readonly buffer VelocitySSBOIn
 {
-    Particle particlesOut[ ];
+    vec2 velocitiesIn[ ];
 };
 
-layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+layout(std430, binding = 3) writeonly buffer PositionSSBOOut
+{
+    vec2 positionsOut[ ];
+};
 
-void main()
+layout(std430, binding = 4) writeonly buffer VelocitySSBOOut
 {
-    uint index = gl_GlobalInvocationID.x;
+    vec2 velocitiesOut[ ];
+};
+
+layout(std430, binding = 5) buffer LifetimeSSBO
+{
+    float lifetimes[ ];
+};
+
+// Slots of the living particles, the written list is also the index buffer of the draw.
+layout(std430, binding = 6) readonly buffer AliveSSBOIn
+{
+    uint aliveIn[ ];
+};
+
+layout(std430, binding = 7) writeonly buffer AliveSSBOOut
+{
+    uint aliveOut[ ];
+};
+
+// Stack of the free slots.
+layout(std430, binding = 8) buffer DeadSSBO
+{
+    uint dead[ ];
+};
+
+layout(std430, binding = 9) buffer CounterSSBO
+{
+    uint aliveCounts[2]; // Indexed by state.
+    int deadCount;
+    uint padding;
+
+    uvec3 dispatchCommand; // VkDispatchIndirectCommand of the next simulation.
+    uint padding1;
+
+    uint drawCommand[5]; // VkDrawIndexedIndirectCommand, only the index count is written.
+} counters;
+
+// Uniform grid of the chunk, rebuilt every step by counting sort.
+layout(std430, binding = 10) buffer CellCountSSBO
+{
+    uint cellCounts[ ];
+};
+
+layout(std430, binding = 11) buffer CellRangeSSBO
+{
+    uvec2 cellRanges[ ]; // First and past the last sorted particle.
+};
+
+layout(std430, binding = 12) buffer RankSSBO
+{
+    uint ranks[ ]; // Within the cell, indexed like the read list.
+};
+
+layout(std430, binding = 13) buffer SortedSSBO
+{
+    vec2 sortedPositions[ ];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    uint pass;
+    uint readState;
+
+    uint firstEmitted; // Of the chunk, among the particles the step emits.
+    uint emitCount;    // By the chunk.
+    uint seed;
+    uint interactions;
+
+    uint emitterEnds[4]; // Particles the step emits up to every emitter, included.
+} PC;
+
+const uint HASH_PASS = 0;
+const uint SCAN_PASS = 1;
+const uint SORT_PASS = 2;
+const uint SIMULATE_PASS = 3;
+const uint EMIT_PASS = 4;
+const uint PREPARE_PASS = 5;
+
+const uint NO_INTERACTIONS = 0;
+const uint GRID_INTERACTIONS = 1;
+const uint BRUTE_FORCE_INTERACTIONS = 2;
+
+const uint WORKGROUP_SIZE = 256;
+
+layout(local_size_x = WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+shared uint scanTotals[WORKGROUP_SIZE];
+shared vec2 positionTile[WORKGROUP_SIZE];
+
+// PCG hash (Jarzynski and Olano, 2020).
+uint hash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+    return (word >> 22u) ^ word;
+}
+
+float random(inout uint state)
+{
+    state = hash(state);
 
-    Particle particleIn = particlesIn[index];
+    return float(state >> 8u) / 16777216.0;
+}
+
+// Particles past the border fall in the border cells.
+ivec2 getCell(vec2 position)
+{
+    return clamp(ivec2(floor((position + 1.0) / UBO.interactionRadius)), ivec2(0), ivec2(UBO.gridSize - 1));
+}
+
+uint getCellIndex(vec2 position)
+{
+    ivec2 cell = getCell(position);
+
+    return uint(cell.y) * UBO.gridSize + uint(cell.x);
+}
+
+void hashParticle(uint index)
+{
+    if (index >= counters.aliveCounts[PC.readState])
+    {
+        return;
+    }
+
+    ranks[index] = atomicAdd(cellCounts[getCellIndex(positionsIn[aliveIn[index]])], 1);
+}
+
+// Exclusive prefix sum of the counts by a single workgroup, every invocation sums a contiguous run of cells.
+void scanCells(uint index)
+{
+    uint runLength = UBO.cellCount / WORKGROUP_SIZE;
+    uint firstCell = index * runLength;
+    uint total = 0;
+
+    for (uint i = 0; i < runLength; i++)
+    {
+        total += cellCounts[firstCell + i];
+    }
+
+    scanTotals[index] = total;
+
+    barrier();
+
+    // Inclusive scan of the run totals (Hillis and Steele).
+    for (uint offset = 1; offset < WORKGROUP_SIZE; offset *= 2)
+    {
+        uint previous = index >= offset ? scanTotals[index - offset] : 0u;
+
+        barrier();
+
+        scanTotals[index] += previous;
+
+        barrier();
+    }
+
+    uint start = scanTotals[index] - total;
+
+    for (uint i = 0; i < runLength; i++)
+    {
+        uint count = cellCounts[firstCell + i];
+
+        cellRanges[firstCell + i] = uvec2(start, start + count);
+        cellCounts[firstCell + i] = 0;
+
+        start += count;
+    }
+}
+
+void sortParticle(uint index)
+{
+    if (index >= counters.aliveCounts[PC.readState])
+    {
+        return;
+    }
+
+    vec2 position = positionsIn[aliveIn[index]];
+
+    sortedPositions[cellRanges[getCellIndex(position)].x + ranks[index]] = position;
+}
+
+// Neighbours within the interaction radius push the particle away, harder the closer they are, and pull it towards
+// their center. Both are averaged over the neighbours, so dense regions don't blow up.
+struct Neighbourhood
+{
+    vec2 separation;
+    vec2 offsetSum;
+    uint count;
+};
+
+void interact(vec2 position, vec2 neighbour, inout Neighbourhood neighbourhood)
+{
+    vec2 offset = neighbour - position;
+    float distanceSquared = dot(offset, offset);
+
+    // The particle itself, or one at the same place, pushes in no direction.
+    if (distanceSquared == 0.0 || distanceSquared >= UBO.interactionRadius * UBO.interactionRadius)
+    {
+        return;
+    }
 
-    particlesOut[index].position = particleIn.position + particleIn.velocity * UBO.time;
-    particlesOut[index].velocity = particleIn.velocity;
+    float distance = sqrt(distanceSquared);
+
+    neighbourhood.separation -= offset / distance * (1.0 - distance / UBO.interactionRadius);
+    neighbourhood.offsetSum += offset;
+    neighbourhood.count++;
+}
+
+vec2 getForce(Neighbourhood neighbourhood)
+{
+    if (neighbourhood.count == 0)
+    {
+        return vec2(0.0);
+    }
+
+    return (UBO.separation * neighbourhood.separation + UBO.cohesion * neighbourhood.offsetSum / UBO.interactionRadius) / float(neighbourhood.count);
+}
+
+// Searches the sorted particles of the 3x3 cells around the particle, the cells are as large as the radius.
+vec2 getGridForce(vec2 position)
+{
+    Neighbourhood neighbourhood = Neighbourhood(vec2(0.0), vec2(0.0), 0u);
+
+    ivec2 cell = getCell(position);
+    ivec2 firstCell = max(cell - 1, ivec2(0));
+    ivec2 lastCell = min(cell + 1, ivec2(UBO.gridSize - 1));
+
+    for (int y = firstCell.y; y <= lastCell.y; y++)
+    {
+        for (int x = firstCell.x; x <= lastCell.x; x++)
+        {
+            uvec2 range = cellRanges[uint(y) * UBO.gridSize + uint(x)];
+
+            for (uint i = range.x; i < range.y; i++)
+            {
+                interact(position, sortedPositions[i], neighbourhood);
+            }
+        }
+    }
+
+    return getForce(neighbourhood);
+}
+
+// Reference, tests every live particle of the chunk, a workgroup sized tile at a time loaded in shared memory. Every
+// invocation of the workgroup must call it.
+vec2 getBruteForce(vec2 position, uint aliveCount)
+{
+    Neighbourhood neighbourhood = Neighbourhood(vec2(0.0), vec2(0.0), 0u);
+
+    for (uint firstNeighbour = 0; firstNeighbour < aliveCount; firstNeighbour += WORKGROUP_SIZE)
+    {
+        uint neighbour = firstNeighbour + gl_LocalInvocationID.x;
+
+        if (neighbour < aliveCount)
+        {
+            positionTile[gl_LocalInvocationID.x] = positionsIn[aliveIn[neighbour]];
+        }
+
+        barrier();
+
+        uint tileSize = min(WORKGROUP_SIZE, aliveCount - firstNeighbour);
+
+        for (uint i = 0; i < tileSize; i++)
+        {
+            interact(position, positionTile[i], neighbourhood);
+        }
+
+        barrier();
+    }
+
+    return getForce(neighbourhood);
+}
+
+void simulate(uint index)
+{
+    uint writtenState = 1 - PC.readState;
+    uint aliveCount = counters.aliveCounts[PC.readState];
+
+    // The last workgroup may run past the living particles, but it still loads its share of the brute force tiles.
+    bool living = index < aliveCount;
+
+    uint particle = living ? aliveIn[index] : 0u;
+    vec2 position = positionsIn[particle];
+    vec2 force = vec2(0.0);
+
+    if (PC.interactions == BRUTE_FORCE_INTERACTIONS)
+    {
+        force = getBruteForce(position, aliveCount);
+    }
+
+    if (!living)
+    {
+        return;
+    }
+
+    float lifetime = lifetimes[particle] - UBO.timeStep;
+
+    lifetimes[particle] = lifetime;
+
+    if (lifetime <= 0.0)
+    {
+        dead[atomicAdd(counters.deadCount, 1)] = particle;
+
+        return;
+    }
+
+    if (PC.interactions == GRID_INTERACTIONS)
+    {
+        force = getGridForce(position);
+    }
+
+    vec2 velocity = velocitiesIn[particle] + force * UBO.timeStep;
+
+    position += velocity * UBO.timeStep;
 
     // Flip movement at window border.
 
-    if ((particlesOut[index].position.x <= -1.0) || (particlesOut[index].position.x >= 1.0))
+    if ((position.x <= -1.0) || (position.x >= 1.0))
+    {
+        velocity.x = -velocity.x;
+    }
+
+    if ((position.y <= -1.0) || (position.y >= 1.0))
+    {
+        velocity.y = -velocity.y;
+    }
+
+    positionsOut[particle] = position;
+    velocitiesOut[particle] = velocity;
+
+    aliveOut[atomicAdd(counters.aliveCounts[writtenState], 1)] = particle;
+}
+
+void emit(uint index)
+{
+    if (index >= PC.emitCount)
+    {
+        return;
+    }
+
+    // Particles past the free slots of the chunk are dropped.
+    int top = atomicAdd(counters.deadCount, -1) - 1;
+
+    if (top < 0)
+    {
+        atomicAdd(counters.deadCount, 1);
+
+        return;
+    }
+
+    uint particle = dead[top];
+    uint emitted = PC.firstEmitted + index;
+    uint emitter = 0;
+
+    while (emitter + 1 < UBO.emitterCount && emitted >= PC.emitterEnds[emitter])
+    {
+        emitter++;
+    }
+
+    uint state = hash(emitted ^ hash(PC.seed));
+
+    float angle = 6.28318530718 * random(state);
+    float distance = UBO.emitters[emitter].radius * sqrt(random(state));
+
+    vec2 direction = vec2(cos(angle), sin(angle));
+    vec2 position = UBO.emitters[emitter].position + direction * distance * vec2(UBO.aspectRatio, 1.0);
+
+    // Both states, the vertex stage interpolates from the one read.
+    positionsIn[particle] = position;
+    positionsOut[particle] = position;
+    velocitiesOut[particle] = direction * vec2(UBO.aspectRatio, 1.0) * UBO.emitters[emitter].speed;
+    lifetimes[particle] = UBO.emitters[emitter].lifetime * (0.5 + random(state));
+
+    aliveOut[atomicAdd(counters.aliveCounts[1 - PC.readState], 1)] = particle;
+}
+
+void prepare(uint index)
+{
+    if (index > 0)
     {
-        particlesOut[index].velocity.x = -particlesOut[index].velocity.x;
+        return;
     }
 
-    if ((particlesOut[index].position.y <= -1.0) || (particlesOut[index].position.y >= 1.0))
+    uint alive = counters.aliveCounts[1 - PC.readState];
+
+    counters.dispatchCommand = uvec3((alive + 255) / 256, 1, 1);
+    counters.drawCommand[0] = alive;
+
+    // Appended to by the next step.
+    counters.aliveCounts[PC.readState] = 0;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    if (PC.pass == HASH_PASS)
+    {
+        hashParticle(index);
+    }
+    else if (PC.pass == SCAN_PASS)
+    {
+        scanCells(index);
+    }
+    else if (PC.pass == SORT_PASS)
+    {
+        sortParticle(index);
+    }
+    else if (PC.pass == SIMULATE_PASS)
+    {
+        simulate(index);
+    }
+    else if (PC.pass == EMIT_PASS)
+    {
+        emit(index);
+    }
+    else
     {
-        particlesOut[index].velocity.y = -particlesOut[index].velocity.y;
+        prepare(index);
     }
 }
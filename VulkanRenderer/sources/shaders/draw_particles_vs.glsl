@@ -2,12 +2,20 @@
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inPreviousPosition;
+
+layout(push_constant) uniform PushConstants
+{
+    float interpolation; // Share of a step elapsed since the last one.
+} PC;
 
 layout(location = 0) out vec3 fragmentColor;
 
 void main()
 {
-    gl_Position = vec4(inPosition.xy, 1.0, 1.0);
+    vec2 position = mix(inPreviousPosition, inPosition, PC.interpolation);
+
+    gl_Position = vec4(position, 1.0, 1.0);
     gl_PointSize = 14.0;
 
     fragmentColor = inColor.rgb;
@@ -0,0 +1,147 @@
+#version 450
+
+// Every workgroup reduces a 64x64 tile of the source level down to one texel of the 6th level below it. The
+// first two levels are computed straight from the source, the following ones from workgroup shared memory.
+// Texels outside of a level repeat its last row/column, so odd sizes reduce like the blit chain does.
+
+layout(binding = 0, rgba8) uniform readonly image2D sourceLevel;
+layout(binding = 1, rgba8) uniform writeonly image2D destinationLevels[6];
+
+layout(push_constant) uniform PushConstants
+{
+    ivec2 sourceSize;
+    uint levelCount;
+    uint srgb;
+} PC;
+
+layout(local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+shared vec4 tile[16][16];
+
+vec4 toLinear(vec4 color)
+{
+    if (PC.srgb == 0)
+    {
+        return color;
+    }
+
+    vec3 linearColor = mix(color.rgb / 12.92, pow((color.rgb + 0.055) / 1.055, vec3(2.4)), greaterThan(color.rgb, vec3(0.04045)));
+
+    return vec4(linearColor, color.a);
+}
+
+vec4 toSrgb(vec4 color)
+{
+    if (PC.srgb == 0)
+    {
+        return color;
+    }
+
+    vec3 srgbColor = mix(color.rgb * 12.92, 1.055 * pow(color.rgb, vec3(1.0 / 2.4)) - 0.055, greaterThan(color.rgb, vec3(0.0031308)));
+
+    return vec4(srgbColor, color.a);
+}
+
+ivec2 levelSize(uint level)
+{
+    return max(PC.sourceSize >> ivec2(level), ivec2(1));
+}
+
+vec4 loadSource(ivec2 coord)
+{
+    return toLinear(imageLoad(sourceLevel, min(coord, PC.sourceSize - 1)));
+}
+
+void storeLevel(uint level, ivec2 coord, vec4 color)
+{
+    if (any(greaterThanEqual(coord, levelSize(level))))
+    {
+        return;
+    }
+
+    // Constant indices only, dynamic indexing of image arrays is an optional feature.
+    switch (level)
+    {
+    case 1u: imageStore(destinationLevels[0], coord, toSrgb(color)); break;
+    case 2u: imageStore(destinationLevels[1], coord, toSrgb(color)); break;
+    case 3u: imageStore(destinationLevels[2], coord, toSrgb(color)); break;
+    case 4u: imageStore(destinationLevels[3], coord, toSrgb(color)); break;
+    case 5u: imageStore(destinationLevels[4], coord, toSrgb(color)); break;
+    case 6u: imageStore(destinationLevels[5], coord, toSrgb(color)); break;
+    }
+}
+
+void main()
+{
+    ivec2 thread = ivec2(gl_LocalInvocationID.xy);
+    ivec2 group = ivec2(gl_WorkGroupID.xy);
+
+    // Level 1: a 2x2 quad per thread, from the source. Texels are computed at clamped coordinates, so the quad
+    // already holds what level 2 has to average.
+    ivec2 firstLevelSize = levelSize(1);
+    vec4 sum = vec4(0.0);
+
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 coord = group * 32 + thread * 2 + ivec2(i & 1, i >> 1);
+        ivec2 clampedCoord = min(coord, firstLevelSize - 1);
+        ivec2 sourceCoord = clampedCoord * 2;
+
+        vec4 color = 0.25 * (loadSource(sourceCoord) + loadSource(sourceCoord + ivec2(1, 0)) + loadSource(sourceCoord + ivec2(0, 1)) + loadSource(sourceCoord + ivec2(1, 1)));
+
+        if (coord == clampedCoord)
+        {
+            storeLevel(1, coord, color);
+        }
+
+        sum += color;
+    }
+
+    if (PC.levelCount < 2)
+    {
+        return;
+    }
+
+    // Level 2: the average of the quad, kept in shared memory for the following levels.
+    vec4 color = 0.25 * sum;
+
+    storeLevel(2, group * 16 + thread, color);
+
+    tile[thread.y][thread.x] = color;
+
+    for (uint level = 3; level <= PC.levelCount; level++)
+    {
+        barrier();
+
+        int side = 16 >> (level - 2);
+        bool reduces = all(lessThan(thread, ivec2(side)));
+
+        if (reduces)
+        {
+            ivec2 coord = group * side + thread;
+
+            // Workgroups past the end of the previous level still read inside the tile, their texels aren't stored.
+            ivec2 previousLast = max(levelSize(level - 1) - 1 - group * side * 2, ivec2(0));
+
+            color = vec4(0.0);
+
+            for (int i = 0; i < 4; i++)
+            {
+                ivec2 previousCoord = min(thread * 2 + ivec2(i & 1, i >> 1), previousLast);
+
+                color += tile[previousCoord.y][previousCoord.x];
+            }
+
+            color *= 0.25;
+
+            storeLevel(level, coord, color);
+        }
+
+        barrier();
+
+        if (reduces)
+        {
+            tile[thread.y][thread.x] = color;
+        }
+    }
+}
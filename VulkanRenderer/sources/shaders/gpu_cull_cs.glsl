@@ -0,0 +1,253 @@
+#version 450
+
+// One invocation per draw slot, a record or one of its meshlets: the bounding sphere, moved by the record's
+// transform, is tested against the frustum planes of the camera, and meshlets facing away from the camera are
+// rejected by their normal cone. Visible ones append an indexed indirect draw, its first instance selects the
+// transform in the vertex shader. With a LOD chain, visible records draw the coarsest level whose error projects
+// within tolerance, unless the level they were drawn at last stays within the hysteresis margin.
+
+const uint MAX_LEVELS_OF_DETAIL = 8;
+const float MIN_LOD_DISTANCE = 1e-6;
+
+struct DrawRecord
+{
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint transformIndex;
+    vec4 boundingSphere;
+};
+
+struct Meshlet
+{
+    uint firstIndex;
+    uint indexCount;
+    uint vertexCount;
+    uint padding;
+    vec4 boundingSphere;
+    vec4 cone;
+};
+
+struct LodRange
+{
+    uint firstIndex;
+    uint indexCount;
+    uint firstMeshlet;
+    uint meshletCount;
+    float error;
+    uint padding[3];
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    float time;
+    vec4 positionScale;
+    vec4 positionOffset;
+} UBO;
+
+layout(std430, binding = 1) readonly buffer DrawRecordSSBO
+{
+    DrawRecord records[ ];
+};
+
+layout(std430, binding = 2) readonly buffer TransformSSBO
+{
+    mat4 transforms[ ];
+};
+
+layout(std430, binding = 3) writeonly buffer DrawCommandSSBO
+{
+    DrawCommand commands[ ];
+};
+
+layout(std430, binding = 4) buffer DrawCountSSBO
+{
+    uint drawCount;
+    uint padding[3];
+    uint lodTriangles[2 * MAX_LEVELS_OF_DETAIL]; // 64 bit sums, low half first.
+};
+
+layout(std430, binding = 5) readonly buffer MeshletSSBO
+{
+    Meshlet meshlets[ ];
+};
+
+layout(std430, binding = 6) readonly buffer LodSSBO
+{
+    LodRange lods[ ];
+};
+
+layout(std430, binding = 7) buffer LodStateSSBO
+{
+    uint lodStates[ ];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    uint recordCount;
+    uint meshletCount;
+    uint dispatchWidth;
+    uint lodCount;
+    float lodErrorScale;
+    float lodHysteresis;
+} PC;
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+vec4 planes[6];
+
+bool isSphereInFrustum(vec3 center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        // The planes aren't normalized, the radius is scaled by the length of their normal instead.
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint selectLevelOfDetail(uint recordIndex, float errorScale)
+{
+    uint coarsest = 0;
+    uint loosest = 0;
+
+    for (uint level = 1; level < PC.lodCount; level++)
+    {
+        float projectedError = lods[level].error * errorScale;
+
+        if (projectedError <= 1.0 - PC.lodHysteresis)
+        {
+            coarsest = level;
+        }
+
+        if (projectedError <= 1.0 + PC.lodHysteresis)
+        {
+            loosest = level;
+        }
+    }
+
+    // Every invocation of the record picks the same level, whether it reads the state before or after another one updated it.
+    uint previous = lodStates[recordIndex];
+    uint level = clamp(previous, coarsest, loosest);
+
+    if (level != previous)
+    {
+        lodStates[recordIndex] = level;
+    }
+
+    return level;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.y * PC.dispatchWidth * gl_WorkGroupSize.x + gl_GlobalInvocationID.x;
+    uint recordIndex = index / max(PC.meshletCount, 1);
+
+    if (recordIndex >= PC.recordCount)
+    {
+        return;
+    }
+
+    DrawRecord record = records[recordIndex];
+    mat4 model = transforms[record.transformIndex];
+    float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+
+    // Planes from the rows of the view projection matrix (Gribb and Hartmann), for a [0, 1] depth range.
+    mat4 rows = transpose(UBO.projection * UBO.view);
+
+    planes = vec4[6](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]);
+
+    vec3 center = (model * vec4(record.boundingSphere.xyz, 1.0)).xyz;
+    float radius = record.boundingSphere.w * scale;
+
+    if (!isSphereInFrustum(center, radius))
+    {
+        return;
+    }
+
+    // The view is a rigid transform, so the camera sits at -transpose(rotation) * translation.
+    vec3 cameraPosition = -(transpose(mat3(UBO.view)) * UBO.view[3].xyz);
+
+    uint level = 0;
+    uint firstIndex = record.firstIndex;
+    uint indexCount = record.indexCount;
+    uint firstMeshlet = 0;
+    uint meshletCount = PC.meshletCount;
+
+    if (PC.lodCount > 0)
+    {
+        // Errors are projected from the nearest point of the bounding sphere.
+        float distance = max(length(center - cameraPosition) - radius, MIN_LOD_DISTANCE);
+
+        level = selectLevelOfDetail(recordIndex, PC.lodErrorScale * scale / distance);
+
+        LodRange lod = lods[level];
+
+        firstIndex += lod.firstIndex;
+        indexCount = lod.indexCount;
+        firstMeshlet = lod.firstMeshlet;
+        meshletCount = lod.meshletCount;
+    }
+
+    if (PC.meshletCount > 0)
+    {
+        uint meshletIndex = index % PC.meshletCount;
+
+        // Coarser levels have fewer meshlets than invocations.
+        if (meshletIndex >= meshletCount)
+        {
+            return;
+        }
+
+        Meshlet meshlet = meshlets[firstMeshlet + meshletIndex];
+
+        center = (model * vec4(meshlet.boundingSphere.xyz, 1.0)).xyz;
+        radius = meshlet.boundingSphere.w * scale;
+
+        if (!isSphereInFrustum(center, radius))
+        {
+            return;
+        }
+
+        vec3 axis = mat3(model) * meshlet.cone.xyz;
+        vec3 offset = center - cameraPosition;
+
+        // Every triangle faces away from the camera.
+        if (length(axis) > 0.0 && dot(offset, normalize(axis)) >= meshlet.cone.w * length(offset) + radius)
+        {
+            return;
+        }
+
+        firstIndex = record.firstIndex + meshlet.firstIndex;
+        indexCount = meshlet.indexCount;
+    }
+
+    uint slot = atomicAdd(drawCount, 1);
+
+    commands[slot] = DrawCommand(indexCount, 1, firstIndex, record.vertexOffset, record.transformIndex);
+
+    // 64 bit sum, the invocation wrapping the low half carries.
+    uint triangles = indexCount / 3;
+    uint previousLow = atomicAdd(lodTriangles[2 * level], triangles);
+
+    if (previousLow + triangles < previousLow)
+    {
+        atomicAdd(lodTriangles[2 * level + 1], 1);
+    }
+}
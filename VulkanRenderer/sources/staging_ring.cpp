@@ -0,0 +1,250 @@
+#include "staging_ring.h"
+
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static double toMebibytes(VkDeviceSize bytes)
+{
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void StagingRing::init(VkDevice device, MemoryAllocator& allocator, VkDeviceSize capacity)
+{
+	this->device = device;
+	this->allocator = &allocator;
+
+	VkBufferCreateInfo bufferCreateInfo{};
+
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = capacity;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create staging ring buffer!");
+	}
+
+	VkMemoryRequirements memoryRequirements{};
+
+	vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+	memory = allocator.allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, LINEAR_RESOURCE, true);
+
+	vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+
+	statistics.capacity = capacity;
+}
+
+void StagingRing::destroy()
+{
+	recycle();
+
+	if (!pendingFrames.empty() || currentFrame.bytes > 0 || !currentFrame.overflowBlocks.empty())
+	{
+		std::cerr << "[WARNING] Staging ring destroyed while still in use." << std::endl;
+	}
+
+	releaseFrame(currentFrame);
+
+	for (Frame& frame : pendingFrames)
+	{
+		releaseFrame(frame);
+	}
+
+	pendingFrames.clear();
+
+	logStatistics();
+
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator->free(memory);
+}
+
+StagingRegion StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (size > statistics.capacity)
+	{
+		return allocateOverflow(size);
+	}
+
+	VkDeviceSize offset = 0;
+
+	recycle();
+
+	// Ranges of frames already submitted come back once their fence signals, so waiting is worth it.
+	while (!tryAllocate(size, alignment, offset))
+	{
+		if (pendingFrames.empty())
+		{
+			// The frame being recorded holds the rest of the ring.
+			return allocateOverflow(size);
+		}
+
+		statistics.stalls++;
+
+		vkWaitForFences(device, 1, &pendingFrames.front().fence, VK_TRUE, UINT64_MAX);
+
+		recycle();
+	}
+
+	return { buffer, offset, static_cast<char*>(memory.mapped) + offset };
+}
+
+void StagingRing::endFrame(VkFence fence)
+{
+	if (currentFrame.bytes == 0 && currentFrame.overflowBlocks.empty())
+	{
+		return;
+	}
+
+	currentFrame.fence = fence;
+	currentFrame.endOffset = head;
+
+	pendingFrames.push_back(std::move(currentFrame));
+
+	currentFrame = Frame{};
+}
+
+void StagingRing::recycle()
+{
+	// Fences are checked out of order, so a signaled fence is recorded before its owner gets to reset it.
+	for (Frame& frame : pendingFrames)
+	{
+		if (!frame.completed && vkGetFenceStatus(device, frame.fence) == VK_SUCCESS)
+		{
+			frame.completed = true;
+		}
+	}
+
+	while (!pendingFrames.empty() && pendingFrames.front().completed)
+	{
+		Frame& frame = pendingFrames.front();
+
+		tail = frame.endOffset;
+		statistics.usedBytes -= frame.bytes;
+
+		releaseFrame(frame);
+
+		pendingFrames.pop_front();
+	}
+}
+
+void StagingRing::logStatistics() const
+{
+	std::cout << "[INFO] STAGING RING:" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << '\t' << "Capacity: " << toMebibytes(statistics.capacity) << " MiB" << std::endl;
+	std::cout << '\t' << "High-water mark: " << toMebibytes(statistics.highWaterMark) << " MiB" << std::endl;
+	std::cout << '\t' << "Stalls: " << statistics.stalls << std::endl;
+	std::cout << '\t' << "Overflow allocations: " << statistics.overflowAllocations << " (" << toMebibytes(statistics.overflowBytes) << " MiB)" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	if (statistics.usedBytes == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	VkDeviceSize alignedHead = alignUp(head, alignment);
+
+	if (head > tail || statistics.usedBytes == 0)
+	{
+		// Free space is [head, capacity) followed by [0, tail).
+		if (alignedHead + size <= statistics.capacity)
+		{
+			consume(alignedHead + size - head);
+
+			offset = alignedHead;
+			head = alignedHead + size;
+
+			return true;
+		}
+
+		// Wrap around, the skipped end of the ring is charged to the current frame.
+		if (size <= tail)
+		{
+			consume(statistics.capacity - head + size);
+
+			offset = 0;
+			head = size;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// Free space is [head, tail).
+	if (alignedHead + size <= tail)
+	{
+		consume(alignedHead + size - head);
+
+		offset = alignedHead;
+		head = alignedHead + size;
+
+		return true;
+	}
+
+	return false;
+}
+
+void StagingRing::consume(VkDeviceSize bytes)
+{
+	currentFrame.bytes += bytes;
+
+	statistics.usedBytes += bytes;
+	statistics.highWaterMark = std::max(statistics.highWaterMark, statistics.usedBytes);
+}
+
+StagingRegion StagingRing::allocateOverflow(VkDeviceSize size)
+{
+	OverflowBlock block{};
+
+	VkBufferCreateInfo bufferCreateInfo{};
+
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = size;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &block.buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create staging overflow buffer!");
+	}
+
+	VkMemoryRequirements memoryRequirements{};
+
+	vkGetBufferMemoryRequirements(device, block.buffer, &memoryRequirements);
+
+	block.memory = allocator->allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, LINEAR_RESOURCE);
+
+	vkBindBufferMemory(device, block.buffer, block.memory.memory, block.memory.offset);
+
+	currentFrame.overflowBlocks.push_back(block);
+
+	statistics.overflowAllocations++;
+	statistics.overflowBytes += size;
+
+	return { block.buffer, 0, block.memory.mapped };
+}
+
+void StagingRing::releaseFrame(Frame& frame)
+{
+	for (OverflowBlock& block : frame.overflowBlocks)
+	{
+		vkDestroyBuffer(device, block.buffer, nullptr);
+		allocator->free(block.memory);
+	}
+
+	frame.overflowBlocks.clear();
+}
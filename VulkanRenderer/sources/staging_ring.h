@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+#include "memory_allocator.h"
+
+struct StagingRegion
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+
+	void* mapped = nullptr; // Host address of "offset".
+};
+
+// One persistently mapped staging buffer handed out as a ring. Every sub-range belongs to the frame being
+// recorded, and "endFrame" ties them to the fence of the submission that reads them. Ranges are recycled
+// once that fence signals. Requests that can't fit even after waiting go to a temporary overflow block.
+class StagingRing
+{
+public:
+	struct Statistics
+	{
+		VkDeviceSize capacity = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize highWaterMark = 0;
+
+		uint32_t stalls = 0;
+		uint32_t overflowAllocations = 0;
+		VkDeviceSize overflowBytes = 0;
+	};
+
+	StagingRing() = default;
+
+	void init(VkDevice device, MemoryAllocator& allocator, VkDeviceSize capacity);
+	void destroy();
+
+	StagingRegion allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	void endFrame(VkFence fence);
+
+	// Must run before any of the fences passed to "endFrame" is reset.
+	void recycle();
+
+	const Statistics& getStatistics() const { return statistics; }
+
+	void logStatistics() const;
+
+private:
+	struct OverflowBlock
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+	};
+
+	struct Frame
+	{
+		VkFence fence = VK_NULL_HANDLE;
+
+		VkDeviceSize endOffset = 0;
+		VkDeviceSize bytes = 0;
+
+		std::vector<OverflowBlock> overflowBlocks;
+
+		bool completed = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	MemoryAllocator* allocator = nullptr;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+
+	VkDeviceSize head = 0; // Next free byte.
+	VkDeviceSize tail = 0; // First byte still in use by the GPU.
+
+	Frame currentFrame;
+	std::deque<Frame> pendingFrames;
+
+	Statistics statistics;
+
+	bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	void consume(VkDeviceSize bytes);
+
+	StagingRegion allocateOverflow(VkDeviceSize size);
+	void releaseFrame(Frame& frame);
+};
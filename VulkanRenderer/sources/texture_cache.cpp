@@ -0,0 +1,93 @@
+#include "texture_cache.h"
+
+#include <cstring>
+#include <iostream>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool TextureCache::open(const std::string& cachePath, uint64_t sourceHash)
+{
+	close();
+
+	if (!file.open(cachePath) || file.getSize() < sizeof(Header))
+	{
+		file.close();
+
+		return false;
+	}
+
+	memcpy(&header, file.getData(), sizeof(Header));
+
+	uint64_t levelTableEnd = sizeof(Header) + static_cast<uint64_t>(header.levelCount) * sizeof(Level);
+
+	bool valid = header.magic == FILE_MAGIC && header.version == FILE_VERSION && header.sourceHash == sourceHash
+		&& header.levelCount > 0 && header.levelCount <= MAX_LEVELS
+		&& header.dataOffset % LEVEL_ALIGNMENT == 0 && header.dataOffset >= levelTableEnd
+		&& header.dataOffset <= file.getSize() && header.dataSize <= file.getSize() - header.dataOffset;
+
+	if (valid)
+	{
+		levels.resize(header.levelCount);
+
+		memcpy(levels.data(), file.getData() + sizeof(Header), levels.size() * sizeof(Level));
+
+		for (const Level& level : levels)
+		{
+			valid = valid && level.offset % LEVEL_ALIGNMENT == 0 && level.offset <= header.dataSize && level.size <= header.dataSize - level.offset;
+		}
+	}
+
+	if (!valid)
+	{
+		close();
+
+		return false;
+	}
+
+	data = file.getData();
+
+	return true;
+}
+
+void TextureCache::store(const std::string& cachePath, uint64_t sourceHash, VkFormat format, const std::vector<Level>& levels, const std::vector<char>& data)
+{
+	close();
+
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.sourceHash = sourceHash;
+	header.format = static_cast<uint32_t>(format);
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.dataOffset = alignUp(sizeof(Header) + levels.size() * sizeof(Level), LEVEL_ALIGNMENT);
+	header.dataSize = data.size();
+
+	this->levels = levels;
+
+	ownedData.assign(static_cast<size_t>(header.dataOffset + header.dataSize), 0);
+
+	memcpy(ownedData.data(), &header, sizeof(Header));
+	memcpy(ownedData.data() + sizeof(Header), levels.data(), levels.size() * sizeof(Level));
+	memcpy(ownedData.data() + header.dataOffset, data.data(), data.size());
+
+	this->data = ownedData.data();
+
+	if (!writeFileAtomically(cachePath, { ownedData }))
+	{
+		std::cerr << "[WARNING] Failed to write texture cache to \"" << cachePath << "\"." << std::endl;
+	}
+}
+
+void TextureCache::close()
+{
+	file.close();
+
+	ownedData.clear();
+	ownedData.shrink_to_fit();
+
+	data = nullptr;
+	header = Header{};
+	levels.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mapped_file.h"
+
+// Every mip level of a texture, already in its GPU format (possibly block compressed), stored in a flat
+// binary file that is memory mapped on load. Like the mesh cache, the file is keyed by a content hash of
+// the source image.
+class TextureCache
+{
+public:
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+
+		uint64_t offset; // From the start of the level data, aligned to "LEVEL_ALIGNMENT".
+		uint64_t size;
+	};
+
+	static const uint64_t LEVEL_ALIGNMENT = 16; // Covers the texel block size of every supported format.
+
+	TextureCache() = default;
+
+	// Returns false when the file is missing, stale (source hash mismatch) or damaged.
+	bool open(const std::string& cachePath, uint64_t sourceHash);
+
+	// Writes the levels to "cachePath", "data" holds every level at the offsets given by "levels". The
+	// serialized image is used as the backing storage from now on, even if writing the file fails.
+	void store(const std::string& cachePath, uint64_t sourceHash, VkFormat format, const std::vector<Level>& levels, const std::vector<char>& data);
+
+	void close();
+
+	bool isOpen() const { return data != nullptr; }
+
+	VkFormat getFormat() const { return static_cast<VkFormat>(header.format); }
+	uint32_t getLevelCount() const { return header.levelCount; }
+	const Level& getLevel(uint32_t level) const { return levels[level]; }
+
+	const char* getLevelData() const { return data + header.dataOffset; }
+	size_t getLevelDataSize() const { return static_cast<size_t>(header.dataSize); }
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+
+		uint32_t format;
+		uint32_t levelCount;
+
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+
+	static const uint32_t FILE_MAGIC = 0x43545256; // "VRTC".
+	static const uint32_t FILE_VERSION = 1;
+	static const uint32_t MAX_LEVELS = 32;
+
+	MappedFile file;
+	std::vector<char> ownedData;
+
+	const char* data = nullptr;
+	Header header{};
+	std::vector<Level> levels;
+};
@@ -0,0 +1,258 @@
+#include "texture_compression.h"
+
+#include "parallel_for.h"
+
+#include <stbi/stb_dxt.h>
+#include <stbi/stb_image_resize2.h>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+static const size_t PARALLEL_BLOCK_THRESHOLD = 4096; // Smaller levels are compressed on the calling thread.
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t getBlockSize(TextureEncoding encoding)
+{
+	switch (encoding)
+	{
+	case TextureEncoding::BC1:
+	case TextureEncoding::BC4:
+		return 8;
+
+	case TextureEncoding::BC3:
+		return 16;
+
+	default:
+		return 0;
+	}
+}
+
+static uint64_t getEncodedLevelSize(uint32_t width, uint32_t height, TextureEncoding encoding)
+{
+	if (encoding == TextureEncoding::RGBA8)
+	{
+		return static_cast<uint64_t>(width) * height * 4;
+	}
+
+	return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(encoding);
+}
+
+static void compressLevel(const uint8_t* pixels, uint32_t width, uint32_t height, TextureEncoding encoding, uint32_t threadCount, char* output)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint32_t blockSize = getBlockSize(encoding);
+
+	if (static_cast<size_t>(blocksX) * blocksY < PARALLEL_BLOCK_THRESHOLD)
+	{
+		threadCount = 1;
+	}
+
+	parallelFor(blocksY, threadCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		uint8_t block[16 * 4];
+		uint8_t channel[16];
+
+		for (size_t by = begin; by < end; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				// Blocks crossing the edge of the level repeat the last row/column.
+				for (uint32_t y = 0; y < 4; y++)
+				{
+					uint32_t sy = std::min(static_cast<uint32_t>(by) * 4 + y, height - 1);
+
+					for (uint32_t x = 0; x < 4; x++)
+					{
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+
+						memcpy(block + (y * 4 + x) * 4, pixels + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+
+						channel[y * 4 + x] = block[(y * 4 + x) * 4];
+					}
+				}
+
+				unsigned char* destination = reinterpret_cast<unsigned char*>(output) + (by * blocksX + bx) * blockSize;
+
+				if (encoding == TextureEncoding::BC4)
+				{
+					stb_compress_bc4_block(destination, channel);
+				}
+				else
+				{
+					stb_compress_dxt_block(destination, block, encoding == TextureEncoding::BC3 ? 1 : 0, STB_DXT_HIGHQUAL);
+				}
+			}
+		}
+	});
+}
+
+TextureEncoding chooseBlockEncoding(const uint8_t* pixels, size_t texelCount, int sourceChannels)
+{
+	if (sourceChannels == 1)
+	{
+		return TextureEncoding::BC4;
+	}
+
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		if (pixels[i * 4 + 3] != 255)
+		{
+			return TextureEncoding::BC3;
+		}
+	}
+
+	return TextureEncoding::BC1;
+}
+
+VkFormat getTextureFormat(TextureEncoding encoding)
+{
+	switch (encoding)
+	{
+	case TextureEncoding::BC1:
+		return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+
+	case TextureEncoding::BC3:
+		return VK_FORMAT_BC3_SRGB_BLOCK;
+
+	case TextureEncoding::BC4:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+
+	default:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	}
+}
+
+const char* getTextureFormatName(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		return "BC1 sRGB";
+
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return "BC3 sRGB";
+
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return "BC4 UNORM";
+
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return "RGBA8 sRGB";
+
+	default:
+		return "unknown";
+	}
+}
+
+void setSamplerFiltering(VkPhysicalDevice gpu, VkFormat format, VkSamplerCreateInfo& samplerCreateInfo)
+{
+	VkFormatProperties formatProperties{};
+
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &formatProperties);
+
+	// Precomputed levels don't need linear blits, formats that only support nearest filtering are sampled as such.
+	if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+	{
+		VkPhysicalDeviceProperties deviceProperties{};
+
+		vkGetPhysicalDeviceProperties(gpu, &deviceProperties);
+
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+
+		samplerCreateInfo.anisotropyEnable = VK_TRUE;
+		samplerCreateInfo.maxAnisotropy = deviceProperties.limits.maxSamplerAnisotropy;
+	}
+	else
+	{
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+		samplerCreateInfo.anisotropyEnable = VK_FALSE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+	}
+}
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+uint64_t getEncodedChainSize(uint32_t width, uint32_t height, TextureEncoding encoding)
+{
+	uint64_t size = 0;
+
+	for (uint32_t i = 0; i < getMipLevelCount(width, height); i++)
+	{
+		size += getEncodedLevelSize(std::max(width >> i, 1u), std::max(height >> i, 1u), encoding);
+	}
+
+	return size;
+}
+
+void encodeTextureLevels(const uint8_t* pixels, uint32_t width, uint32_t height, TextureEncoding encoding, uint32_t threadCount, std::vector<TextureCache::Level>& levels, std::vector<char>& data)
+{
+	uint32_t levelCount = getMipLevelCount(width, height);
+
+	levels.resize(levelCount);
+
+	uint64_t dataSize = 0;
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		TextureCache::Level& level = levels[i];
+
+		level.width = std::max(width >> i, 1u);
+		level.height = std::max(height >> i, 1u);
+		level.offset = alignUp(dataSize, TextureCache::LEVEL_ALIGNMENT);
+		level.size = getEncodedLevelSize(level.width, level.height, encoding);
+
+		dataSize = level.offset + level.size;
+	}
+
+	data.assign(static_cast<size_t>(dataSize), 0);
+
+	// Each level is filtered from the previous one, in linear space for the sRGB formats.
+	std::vector<uint8_t> levelPixels(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	std::vector<uint8_t> nextPixels;
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		const TextureCache::Level& level = levels[i];
+
+		if (i > 0)
+		{
+			const TextureCache::Level& previous = levels[i - 1];
+
+			nextPixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+			unsigned char* result = getTextureFormat(encoding) == VK_FORMAT_BC4_UNORM_BLOCK
+				? stbir_resize_uint8_linear(levelPixels.data(), previous.width, previous.height, 0, nextPixels.data(), level.width, level.height, 0, STBIR_RGBA)
+				: stbir_resize_uint8_srgb(levelPixels.data(), previous.width, previous.height, 0, nextPixels.data(), level.width, level.height, 0, STBIR_RGBA);
+
+			if (result == nullptr)
+			{
+				throw std::runtime_error("Failed to resize texture level!");
+			}
+
+			levelPixels.swap(nextPixels);
+		}
+
+		if (encoding == TextureEncoding::RGBA8)
+		{
+			memcpy(data.data() + level.offset, levelPixels.data(), static_cast<size_t>(level.size));
+		}
+		else
+		{
+			compressLevel(levelPixels.data(), level.width, level.height, encoding, threadCount, data.data() + level.offset);
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "texture_cache.h"
+
+enum class TextureEncoding
+{
+	RGBA8, BC1, BC3, BC4
+};
+
+// BC4 for single channel sources, BC3 when any texel isn't opaque, BC1 otherwise.
+TextureEncoding chooseBlockEncoding(const uint8_t* pixels, size_t texelCount, int sourceChannels);
+
+// Color encodings map to sRGB formats. BC4 has no sRGB variant, single channel data is kept linear.
+VkFormat getTextureFormat(TextureEncoding encoding);
+const char* getTextureFormatName(VkFormat format);
+
+// Linear filtering and mip selection with full anisotropy when the format supports it, nearest without anisotropy otherwise.
+void setSamplerFiltering(VkPhysicalDevice gpu, VkFormat format, VkSamplerCreateInfo& samplerCreateInfo);
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+// Size of the whole mip chain in "encoding".
+uint64_t getEncodedChainSize(uint32_t width, uint32_t height, TextureEncoding encoding);
+
+// Builds the mip chain of an RGBA8 image (gamma correct for sRGB formats) and encodes every level into
+// "data", at the offsets recorded in "levels". Blocks are compressed on up to "threadCount" threads.
+void encodeTextureLevels(const uint8_t* pixels, uint32_t width, uint32_t height, TextureEncoding encoding, uint32_t threadCount, std::vector<TextureCache::Level>& levels, std::vector<char>& data);
@@ -0,0 +1,498 @@
+#include "texture_streamer.h"
+
+#include "mesh_cache.h"
+#include "mapped_file.h"
+#include "parallel_for.h"
+#include "texture_compression.h"
+
+#include <stbi/stb_image.h>
+
+#include <array>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+static bool isBlockCompressed(VkFormat format)
+{
+	return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK;
+}
+
+void TextureStreamer::init(VkPhysicalDevice gpu, VkDevice device, MemoryAllocator& allocator, UploadContext& uploader, VkDeviceSize frameBudget, uint32_t framesInFlight)
+{
+	this->gpu = gpu;
+	this->device = device;
+	this->allocator = &allocator;
+	this->uploader = &uploader;
+	this->frameBudget = frameBudget;
+	this->framesInFlight = framesInFlight;
+}
+
+void TextureStreamer::destroy()
+{
+	if (importThread.joinable())
+	{
+		importThread.join();
+	}
+
+	for (const RetiredView& retiredView : retiredViews)
+	{
+		vkDestroyImageView(device, retiredView.view, nullptr);
+	}
+
+	retiredViews.clear();
+
+	vkDestroySampler(device, sampler, nullptr);
+	vkDestroyImageView(device, imageView, nullptr);
+	vkDestroyImage(device, image, nullptr);
+
+	vkDestroySampler(device, placeholderSampler, nullptr);
+	vkDestroyImageView(device, placeholderImageView, nullptr);
+	vkDestroyImage(device, placeholderImage, nullptr);
+
+	if (allocator != nullptr)
+	{
+		allocator->free(imageMemory);
+		allocator->free(placeholderImageMemory);
+	}
+
+	sampler = VK_NULL_HANDLE;
+	imageView = VK_NULL_HANDLE;
+	image = VK_NULL_HANDLE;
+
+	placeholderSampler = VK_NULL_HANDLE;
+	placeholderImageView = VK_NULL_HANDLE;
+	placeholderImage = VK_NULL_HANDLE;
+
+	cache.close();
+}
+
+void TextureStreamer::load(const std::string& sourcePath, const std::string& cachePath)
+{
+	this->sourcePath = sourcePath;
+
+	loadTime = std::chrono::high_resolution_clock::now();
+
+	createPlaceholder();
+
+	MappedFile source;
+
+	if (!source.open(sourcePath))
+	{
+		throw std::runtime_error("Failed to load texture image!");
+	}
+
+	uint64_t sourceHash = MeshCache::hashData(source.getData(), source.getSize());
+
+	if (cache.open(cachePath, sourceHash) && isFormatSupported(cache.getFormat(), VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		cacheStatus = "hit";
+
+		createStreamedImage();
+
+		return;
+	}
+
+	cache.close();
+
+	// Decoding and block compression take time proportional to the texture size, so they stay off the frame loop.
+	cacheStatus = "miss";
+
+	importFinished = false;
+	importThread = std::thread(&TextureStreamer::importTexture, this, sourceHash, cachePath);
+}
+
+void TextureStreamer::update()
+{
+	frame++;
+
+	// Every descriptor set was rewritten since these views were replaced, and the frames that used them completed.
+	auto firstInUse = std::partition(retiredViews.begin(), retiredViews.end(), [this](const RetiredView& retiredView)
+	{
+		return frame - retiredView.frame < framesInFlight;
+	});
+
+	for (auto it = firstInUse; it != retiredViews.end(); it++)
+	{
+		vkDestroyImageView(device, it->view, nullptr);
+	}
+
+	retiredViews.erase(firstInUse, retiredViews.end());
+
+	if (importThread.joinable() && importFinished)
+	{
+		importThread.join();
+
+		if (importError)
+		{
+			std::rethrow_exception(importError);
+		}
+
+		createStreamedImage();
+	}
+
+	if (image == VK_NULL_HANDLE || residentLevel == 0)
+	{
+		return;
+	}
+
+	uint32_t previousResidentLevel = residentLevel;
+	VkDeviceSize frameBytes = 0;
+
+	VkFormat format = cache.getFormat();
+	uint32_t blockHeight = isBlockCompressed(format) ? 4 : 1;
+
+	while (residentLevel > 0 && frameBytes < frameBudget)
+	{
+		uint32_t level = residentLevel - 1;
+
+		const TextureCache::Level& levelInfo = cache.getLevel(level);
+
+		uint32_t rowCount = (levelInfo.height + blockHeight - 1) / blockHeight;
+		VkDeviceSize rowSize = levelInfo.size / rowCount;
+
+		uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>((frameBudget - frameBytes) / rowSize, rowCount - streamedRows));
+
+		// A single row always goes out, so a budget smaller than a row still makes progress.
+		if (rows == 0 && frameBytes > 0)
+		{
+			break;
+		}
+
+		rows = std::max(rows, 1u);
+
+		StagingRegion staging = uploader->stage(cache.getLevelData() + levelInfo.offset + streamedRows * rowSize, rows * rowSize);
+
+		VkBufferImageCopy region{};
+
+		region.bufferOffset = staging.offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(streamedRows * blockHeight), 0 };
+		region.imageExtent = { levelInfo.width, std::min(rows * blockHeight, levelInfo.height - streamedRows * blockHeight), 1 };
+
+		vkCmdCopyBufferToImage(uploader->getTransferCommandBuffer(), staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		frameBytes += rows * rowSize;
+		streamedRows += rows;
+
+		if (streamedRows == rowCount)
+		{
+			// Transfer queues can't wait on shader stages, so the transition is recorded for the graphics queue.
+			recordLevelBarrier(uploader->getGraphicsCommandBuffer(), image, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			residentLevel = level;
+			streamedRows = 0;
+		}
+	}
+
+	statistics.streamingFrames++;
+	statistics.streamedBytes += frameBytes;
+	statistics.maxFrameBytes = std::max(statistics.maxFrameBytes, frameBytes);
+
+	if (residentLevel == previousResidentLevel)
+	{
+		return;
+	}
+
+	double elapsedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadTime).count();
+
+	if (imageView == VK_NULL_HANDLE)
+	{
+		statistics.firstLevelTime = elapsedTime;
+	}
+	else
+	{
+		retiredViews.push_back({ imageView, frame });
+	}
+
+	imageView = createImageView(image, format, residentLevel, cache.getLevelCount() - residentLevel);
+
+	if (residentLevel == 0)
+	{
+		statistics.fullDetailTime = elapsedTime;
+
+		logStatistics();
+	}
+}
+
+VkDescriptorImageInfo TextureStreamer::getDescriptorImageInfo() const
+{
+	VkDescriptorImageInfo imageInfo{};
+
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView != VK_NULL_HANDLE ? imageView : placeholderImageView;
+	imageInfo.sampler = imageView != VK_NULL_HANDLE ? sampler : placeholderSampler;
+
+	return imageInfo;
+}
+
+bool TextureStreamer::isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const
+{
+	VkFormatProperties formatProperties{};
+
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &formatProperties);
+
+	return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+void TextureStreamer::importTexture(uint64_t sourceHash, const std::string& cachePath)
+{
+	try
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		MappedFile source;
+
+		if (!source.open(sourcePath))
+		{
+			throw std::runtime_error("Failed to load texture image!");
+		}
+
+		int texWidth, texHeight, texChannels;
+
+		stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.getData()), static_cast<int>(source.getSize()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+		if (!pixels)
+		{
+			throw std::runtime_error("Failed to load texture image!");
+		}
+
+		// Block compressed when the device can sample the format, RGBA8 otherwise.
+		TextureEncoding encoding = chooseBlockEncoding(pixels, static_cast<size_t>(texWidth) * texHeight, texChannels);
+
+		if (!isFormatSupported(getTextureFormat(encoding), VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			encoding = TextureEncoding::RGBA8;
+		}
+
+		std::vector<TextureCache::Level> levels;
+		std::vector<char> levelData;
+
+		encodeTextureLevels(pixels, texWidth, texHeight, encoding, getWorkerThreadCount(), levels, levelData);
+
+		stbi_image_free(pixels);
+
+		cache.store(cachePath, sourceHash, getTextureFormat(encoding), levels, levelData);
+
+		statistics.importTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+	catch (...)
+	{
+		importError = std::current_exception();
+	}
+
+	importFinished = true;
+}
+
+void TextureStreamer::createPlaceholder()
+{
+	const std::array<uint8_t, 4> color = { 128, 128, 128, 255 };
+
+	StagingRegion staging = uploader->stage(color.data(), color.size());
+
+	createImage(1, 1, 1, VK_FORMAT_R8G8B8A8_SRGB, placeholderImage, placeholderImageMemory);
+
+	VkBufferImageCopy region{};
+
+	region.bufferOffset = staging.offset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { 1, 1, 1 };
+
+	VkCommandBuffer transferCommandBuffer = uploader->getTransferCommandBuffer();
+
+	recordLevelBarrier(transferCommandBuffer, placeholderImage, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	vkCmdCopyBufferToImage(transferCommandBuffer, staging.buffer, placeholderImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	recordLevelBarrier(uploader->getGraphicsCommandBuffer(), placeholderImage, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	placeholderImageView = createImageView(placeholderImage, VK_FORMAT_R8G8B8A8_SRGB, 0, 1);
+	placeholderSampler = createSampler(VK_FORMAT_R8G8B8A8_SRGB, 1);
+}
+
+void TextureStreamer::createStreamedImage()
+{
+	const TextureCache::Level& baseLevel = cache.getLevel(0);
+
+	VkFormat format = cache.getFormat();
+	uint32_t levelCount = cache.getLevelCount();
+
+	createImage(baseLevel.width, baseLevel.height, levelCount, format, image, imageMemory);
+
+	recordLevelBarrier(uploader->getTransferCommandBuffer(), image, 0, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	sampler = createSampler(format, levelCount);
+
+	residentLevel = levelCount;
+	streamedRows = 0;
+}
+
+void TextureStreamer::createImage(uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkImage& image, MemoryAllocation& imageMemory)
+{
+	VkImageCreateInfo imageCreateInfo{};
+
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = format;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Written on the transfer queue and read on the graphics queue.
+	std::array<uint32_t, 2> queueFamilyIndices = uploader->getQueueFamilyIndices();
+
+	if (uploader->hasDedicatedTransferQueue())
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+		imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	}
+	else
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	if (vkCreateImage(device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create streamed texture image!");
+	}
+
+	VkMemoryRequirements memoryRequirements{};
+
+	vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+	imageMemory = allocator->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, OPTIMAL_RESOURCE);
+
+	vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+}
+
+VkImageView TextureStreamer::createImageView(VkImage image, VkFormat format, uint32_t baseLevel, uint32_t levelCount)
+{
+	VkImageViewCreateInfo viewCreateInfo{};
+
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = format;
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = baseLevel;
+	viewCreateInfo.subresourceRange.levelCount = levelCount;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	// BC4 only stores red, single channel textures are read back as gray.
+	if (format == VK_FORMAT_BC4_UNORM_BLOCK)
+	{
+		viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+	}
+
+	VkImageView view = VK_NULL_HANDLE;
+
+	if (vkCreateImageView(device, &viewCreateInfo, nullptr, &view) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create streamed texture image view!");
+	}
+
+	return view;
+}
+
+VkSampler TextureStreamer::createSampler(VkFormat format, uint32_t levelCount)
+{
+	VkSamplerCreateInfo samplerCreateInfo{};
+
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+
+	setSamplerFiltering(gpu, format, samplerCreateInfo);
+
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerCreateInfo.compareEnable = VK_FALSE;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+
+	// LODs are relative to the base level of the view, which already clamps to the resident levels.
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = static_cast<float>(levelCount);
+	samplerCreateInfo.mipLodBias = 0.0f;
+
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	if (vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create streamed texture sampler!");
+	}
+
+	return sampler;
+}
+
+void TextureStreamer::recordLevelBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier barrier{};
+
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = baseLevel;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	VkPipelineStageFlags sourceStage;
+	VkPipelineStageFlags destinationStage;
+
+	if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	{
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	else
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TextureStreamer::logStatistics() const
+{
+	const TextureCache::Level& baseLevel = cache.getLevel(0);
+
+	uint64_t uncompressedSize = getEncodedChainSize(baseLevel.width, baseLevel.height, TextureEncoding::RGBA8);
+
+	std::cout << "[INFO] TEXTURE STREAMED:" << std::endl;
+	std::cout << '\t' << "Source: " << sourcePath << " (" << baseLevel.width << "x" << baseLevel.height << ", " << cache.getLevelCount() << " levels)" << std::endl;
+	std::cout << '\t' << "Format: " << getTextureFormatName(cache.getFormat()) << ", texture cache: " << cacheStatus << std::endl;
+	std::cout << '\t' << "VRAM: " << cache.getLevelDataSize() / 1024.0 << " KB, RGBA8 would take " << uncompressedSize / 1024.0 << " KB (saved "
+		<< 100.0 * (1.0 - static_cast<double>(cache.getLevelDataSize()) / uncompressedSize) << "%)" << std::endl;
+
+	if (statistics.importTime > 0.0)
+	{
+		std::cout << '\t' << "Import time: " << statistics.importTime << " ms (worker thread)" << std::endl;
+	}
+
+	std::cout << '\t' << "First level: " << statistics.firstLevelTime << " ms, full detail: " << statistics.fullDetailTime << " ms" << std::endl;
+	std::cout << '\t' << "Streaming: " << statistics.streamingFrames << " frames, " << statistics.streamedBytes / 1024.0 << " KB (at most "
+		<< statistics.maxFrameBytes / 1024.0 << " KB per frame, budget " << frameBudget / 1024.0 << " KB)" << std::endl;
+}
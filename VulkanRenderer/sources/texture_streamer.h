@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <exception>
+
+#include "memory_allocator.h"
+#include "upload_context.h"
+#include "texture_cache.h"
+
+// Uploads the levels of a texture cache from the smallest one up, never more than "frameBudget" bytes per
+// frame (large levels are split into bands of rows). The view only covers the resident levels, so its base
+// level is the min LOD clamp, and it moves down as levels arrive. A stale or missing cache is rebuilt on a
+// worker thread, a 1x1 placeholder is bound in the meantime.
+class TextureStreamer
+{
+public:
+	struct Statistics
+	{
+		double importTime = 0.0;     // Milliseconds spent rebuilding the cache, 0 on a hit.
+		double firstLevelTime = 0.0; // Milliseconds from "load" until the first level was recorded.
+		double fullDetailTime = 0.0; // Milliseconds from "load" until every level was recorded.
+
+		uint32_t streamingFrames = 0;
+		VkDeviceSize streamedBytes = 0;
+		VkDeviceSize maxFrameBytes = 0;
+	};
+
+	TextureStreamer() = default;
+
+	// Views are destroyed "framesInFlight" updates after being replaced, once no descriptor set uses them.
+	void init(VkPhysicalDevice gpu, VkDevice device, MemoryAllocator& allocator, UploadContext& uploader, VkDeviceSize frameBudget, uint32_t framesInFlight);
+
+	// Joins the import thread, so it may block until a running import finishes.
+	void destroy();
+
+	void load(const std::string& sourcePath, const std::string& cachePath);
+
+	// Records the uploads of the next band of levels into the upload context, they must be submitted before the
+	// frame that binds the new view. Must be called once per frame, after the fence of that frame signaled.
+	void update();
+
+	// The placeholder until the first level is resident.
+	VkDescriptorImageInfo getDescriptorImageInfo() const;
+
+	bool isFullyResident() const { return image != VK_NULL_HANDLE && residentLevel == 0; }
+
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	struct RetiredView
+	{
+		VkImageView view = VK_NULL_HANDLE;
+		uint64_t frame = 0;
+	};
+
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+
+	MemoryAllocator* allocator = nullptr;
+	UploadContext* uploader = nullptr;
+
+	VkDeviceSize frameBudget = 0;
+	uint32_t framesInFlight = 0;
+
+	std::string sourcePath;
+	const char* cacheStatus = "";
+
+	TextureCache cache; // Written by the import thread until "importFinished" is set.
+
+	std::thread importThread;
+	std::atomic<bool> importFinished = false;
+	std::exception_ptr importError;
+
+	VkImage placeholderImage = VK_NULL_HANDLE;
+	MemoryAllocation placeholderImageMemory;
+	VkImageView placeholderImageView = VK_NULL_HANDLE;
+	VkSampler placeholderSampler = VK_NULL_HANDLE;
+
+	VkImage image = VK_NULL_HANDLE;
+	MemoryAllocation imageMemory;
+	VkImageView imageView = VK_NULL_HANDLE; // Levels ["residentLevel", level count).
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	uint32_t residentLevel = 0;
+	uint32_t streamedRows = 0; // Rows (of texel blocks) of level "residentLevel - 1" already recorded.
+
+	std::vector<RetiredView> retiredViews;
+	uint64_t frame = 0;
+
+	std::chrono::high_resolution_clock::time_point loadTime;
+	Statistics statistics;
+
+	bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const;
+
+	void importTexture(uint64_t sourceHash, const std::string& cachePath);
+
+	void createPlaceholder();
+	void createStreamedImage();
+
+	void createImage(uint32_t width, uint32_t height, uint32_t levelCount, VkFormat format, VkImage& image, MemoryAllocation& imageMemory);
+	VkImageView createImageView(VkImage image, VkFormat format, uint32_t baseLevel, uint32_t levelCount);
+	VkSampler createSampler(VkFormat format, uint32_t levelCount);
+
+	void recordLevelBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+	void logStatistics() const;
+};
@@ -0,0 +1,385 @@
+#include "upload_context.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t UploadContext::findTransferQueueFamily(VkPhysicalDevice gpu, uint32_t graphicsFamily)
+{
+	uint32_t queueFamilyCount = 0;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, queueFamilies.data());
+
+	// A family that only supports transfers is usually backed by the copy/DMA engines.
+	for (uint32_t i = 0; i < queueFamilyCount; i++)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			return i;
+		}
+	}
+
+	return graphicsFamily;
+}
+
+void UploadContext::init(VkDevice device, MemoryAllocator& allocator, uint32_t graphicsFamily, uint32_t transferFamily, VkDeviceSize stagingRingSize)
+{
+	this->device = device;
+	this->graphicsFamily = graphicsFamily;
+	this->transferFamily = transferFamily;
+
+	vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+	vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo{};
+
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = graphicsFamily;
+
+	if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload command pool!");
+	}
+
+	transferCommandPool = graphicsCommandPool;
+
+	if (hasDedicatedTransferQueue())
+	{
+		commandPoolCreateInfo.queueFamilyIndex = transferFamily;
+
+		if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload command pool!");
+		}
+	}
+
+	stagingRing.init(device, allocator, stagingRingSize);
+
+	std::cout << "[INFO] UPLOAD CONTEXT:" << std::endl;
+	std::cout << '\t' << "Transfer queue family: " << transferFamily << (hasDedicatedTransferQueue() ? " (dedicated)" : " (shared with graphics)") << std::endl;
+}
+
+void UploadContext::destroy()
+{
+	if (recording)
+	{
+		submit();
+	}
+
+	for (Batch& batch : pendingBatches)
+	{
+		vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+	}
+
+	collect();
+
+	logStatistics();
+
+	for (Batch& batch : freeBatches)
+	{
+		vkDestroySemaphore(device, batch.transferFinishedSemaphore, nullptr);
+		vkDestroyFence(device, batch.fence, nullptr);
+	}
+
+	freeBatches.clear();
+
+	stagingRing.destroy();
+
+	if (transferCommandPool != graphicsCommandPool)
+	{
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+	}
+
+	vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
+}
+
+StagingRegion UploadContext::allocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (!recording)
+	{
+		beginBatch();
+	}
+
+	recordingBatch.uploadedBytes += size;
+
+	return stagingRing.allocate(size, alignment);
+}
+
+StagingRegion UploadContext::stage(const void* data, VkDeviceSize size)
+{
+	StagingRegion staging = allocateStaging(size);
+
+	memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+	return staging;
+}
+
+VkCommandBuffer UploadContext::getTransferCommandBuffer()
+{
+	if (!recording)
+	{
+		beginBatch();
+	}
+
+	return recordingBatch.transferCommandBuffer;
+}
+
+VkCommandBuffer UploadContext::getGraphicsCommandBuffer()
+{
+	if (!recording)
+	{
+		beginBatch();
+	}
+
+	return recordingBatch.graphicsCommandBuffer;
+}
+
+uint64_t UploadContext::submit()
+{
+	if (!recording)
+	{
+		return 0;
+	}
+
+	// Make every transfer write visible to whatever the following frames do with the resources.
+	// Submissions on the graphics queue after this one are ordered behind this barrier.
+	VkMemoryBarrier barrier{};
+
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	vkCmdPipelineBarrier(recordingBatch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (hasDedicatedTransferQueue())
+	{
+		if (vkEndCommandBuffer(recordingBatch.transferCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record upload command buffer!");
+		}
+
+		VkSubmitInfo submitInfo{};
+
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recordingBatch.transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &recordingBatch.transferFinishedSemaphore;
+
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload command buffer!");
+		}
+	}
+
+	if (vkEndCommandBuffer(recordingBatch.graphicsCommandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record upload command buffer!");
+	}
+
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	VkSubmitInfo submitInfo{};
+
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &recordingBatch.graphicsCommandBuffer;
+
+	if (hasDedicatedTransferQueue())
+	{
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &recordingBatch.transferFinishedSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, recordingBatch.fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit upload command buffer!");
+	}
+
+	stagingRing.endFrame(recordingBatch.fence);
+
+	uint64_t batchId = recordingBatch.id;
+
+	pendingBatches.push_back(std::move(recordingBatch));
+
+	recordingBatch = Batch{};
+	recording = false;
+
+	return batchId;
+}
+
+bool UploadContext::isComplete(uint64_t batchId)
+{
+	collect();
+
+	if (recording && recordingBatch.id == batchId)
+	{
+		return false;
+	}
+
+	return std::none_of(pendingBatches.begin(), pendingBatches.end(), [batchId](const Batch& batch) { return batch.id == batchId; });
+}
+
+void UploadContext::wait(uint64_t batchId)
+{
+	for (Batch& batch : pendingBatches)
+	{
+		if (batch.id == batchId)
+		{
+			vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		}
+	}
+
+	collect();
+}
+
+void UploadContext::collect()
+{
+	std::vector<bool> completed(pendingBatches.size());
+
+	for (size_t i = 0; i < pendingBatches.size(); i++)
+	{
+		completed[i] = vkGetFenceStatus(device, pendingBatches[i].fence) == VK_SUCCESS;
+	}
+
+	// The ring has to see the signaled fences before "retireBatch" resets them.
+	stagingRing.recycle();
+
+	size_t i = 0;
+
+	for (auto it = pendingBatches.begin(); it != pendingBatches.end(); i++)
+	{
+		if (completed[i])
+		{
+			retireBatch(*it);
+
+			freeBatches.push_back(std::move(*it));
+
+			it = pendingBatches.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+void UploadContext::logStatistics() const
+{
+	double megabytes = static_cast<double>(statistics.uploadedBytes) / 1.0e6;
+
+	// Completion is only observed when polled, so the throughput is a lower bound.
+	std::cout << "[INFO] UPLOAD BATCHES:" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << '\t' << "Completed: " << statistics.batches << std::endl;
+	std::cout << '\t' << "Uploaded: " << megabytes << " MB" << std::endl;
+	std::cout << '\t' << "Time: " << statistics.seconds * 1000.0 << " ms (slowest batch " << statistics.maxSeconds * 1000.0 << " ms)" << std::endl;
+	std::cout << '\t' << "Throughput: " << (statistics.seconds > 0.0 ? megabytes / statistics.seconds : 0.0) << " MB/s" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+void UploadContext::beginBatch()
+{
+	if (!freeBatches.empty())
+	{
+		recordingBatch = std::move(freeBatches.back());
+
+		freeBatches.pop_back();
+	}
+	else
+	{
+		recordingBatch = Batch{};
+
+		recordingBatch.transferCommandBuffer = allocateCommandBuffer(transferCommandPool);
+		recordingBatch.graphicsCommandBuffer = recordingBatch.transferCommandBuffer;
+
+		if (hasDedicatedTransferQueue())
+		{
+			recordingBatch.graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+
+			VkSemaphoreCreateInfo semaphoreCreateInfo{};
+
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &recordingBatch.transferFinishedSemaphore) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create upload semaphore!");
+			}
+		}
+
+		VkFenceCreateInfo fenceCreateInfo{};
+
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(device, &fenceCreateInfo, nullptr, &recordingBatch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload fence!");
+		}
+	}
+
+	recordingBatch.id = nextBatchId++;
+	recordingBatch.uploadedBytes = 0;
+	recordingBatch.startTime = std::chrono::high_resolution_clock::now();
+
+	VkCommandBufferBeginInfo beginInfo{};
+
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(recordingBatch.transferCommandBuffer, &beginInfo);
+
+	if (hasDedicatedTransferQueue())
+	{
+		vkBeginCommandBuffer(recordingBatch.graphicsCommandBuffer, &beginInfo);
+	}
+
+	recording = true;
+}
+
+void UploadContext::retireBatch(Batch& batch)
+{
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - batch.startTime).count();
+
+	statistics.batches++;
+	statistics.uploadedBytes += batch.uploadedBytes;
+	statistics.seconds += seconds;
+	statistics.maxSeconds = std::max(statistics.maxSeconds, seconds);
+
+	vkResetFences(device, 1, &batch.fence);
+
+	vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+
+	if (batch.graphicsCommandBuffer != batch.transferCommandBuffer)
+	{
+		vkResetCommandBuffer(batch.graphicsCommandBuffer, 0);
+	}
+}
+
+VkCommandBuffer UploadContext::allocateCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandPool = commandPool;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+	if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate upload command buffer!");
+	}
+
+	return commandBuffer;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "memory_allocator.h"
+#include "staging_ring.h"
+
+// Records every pending transfer of a batch into one command buffer and submits it without waiting.
+// When the device exposes a transfer-only queue family, copies run there and the work that needs a
+// graphics queue (blits, shader read transitions) is recorded into a second command buffer that waits
+// on the transfer submission through a semaphore.
+class UploadContext
+{
+public:
+	struct Statistics
+	{
+		uint64_t batches = 0;
+		VkDeviceSize uploadedBytes = 0;
+
+		double seconds = 0.0;
+		double maxSeconds = 0.0;
+	};
+
+	UploadContext() = default;
+
+	static uint32_t findTransferQueueFamily(VkPhysicalDevice gpu, uint32_t graphicsFamily);
+
+	void init(VkDevice device, MemoryAllocator& allocator, uint32_t graphicsFamily, uint32_t transferFamily, VkDeviceSize stagingRingSize);
+	void destroy();
+
+	bool hasDedicatedTransferQueue() const { return graphicsFamily != transferFamily; }
+	std::array<uint32_t, 2> getQueueFamilyIndices() const { return { graphicsFamily, transferFamily }; }
+
+	// Staging memory stays alive until the batch that reads it completes.
+	StagingRegion allocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+	StagingRegion stage(const void* data, VkDeviceSize size);
+
+	VkCommandBuffer getTransferCommandBuffer();
+	VkCommandBuffer getGraphicsCommandBuffer();
+
+	// Returns the batch identifier, or 0 when nothing was recorded.
+	uint64_t submit();
+
+	bool isComplete(uint64_t batchId);
+	void wait(uint64_t batchId);
+
+	// Releases staging memory of finished batches, should be called once per frame.
+	void collect();
+
+	const Statistics& getStatistics() const { return statistics; }
+
+	void logStatistics() const;
+
+private:
+	struct Batch
+	{
+		uint64_t id = 0;
+
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+
+		VkSemaphore transferFinishedSemaphore = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+
+		VkDeviceSize uploadedBytes = 0;
+
+		std::chrono::high_resolution_clock::time_point startTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	StagingRing stagingRing;
+
+	uint32_t graphicsFamily = 0;
+	uint32_t transferFamily = 0;
+
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+
+	VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+	Batch recordingBatch;
+	bool recording = false;
+
+	std::vector<Batch> pendingBatches;
+	std::vector<Batch> freeBatches;
+
+	uint64_t nextBatchId = 1;
+
+	Statistics statistics;
+
+	void beginBatch();
+	void retireBatch(Batch& batch);
+
+	VkCommandBuffer allocateCommandBuffer(VkCommandPool commandPool);
+};
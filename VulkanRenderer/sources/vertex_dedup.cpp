@@ -0,0 +1,258 @@
+#include "vertex_dedup.h"
+
+#include "parallel_for.h"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+static uint32_t hashKey(const VertexKey& key)
+{
+	uint64_t value = (static_cast<uint64_t>(static_cast<uint32_t>(key.position)) << 32) ^ static_cast<uint32_t>(key.texcoord);
+
+	value ^= static_cast<uint64_t>(static_cast<uint32_t>(key.normal)) * 0x9e3779b97f4a7c15ull;
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+
+	return static_cast<uint32_t>(value);
+}
+
+static bool operator==(const VertexKey& a, const VertexKey& b)
+{
+	return a.position == b.position && a.normal == b.normal && a.texcoord == b.texcoord;
+}
+
+// Open addressing table (linear probing) mapping a key to the corner where it first appeared. The
+// full hash is kept next to the corner so most mismatches never touch the key array.
+class KeyTable
+{
+public:
+	KeyTable(const VertexKey* keys, size_t expectedSize)
+		: keys(keys)
+	{
+		slots.resize(std::bit_ceil(std::max<size_t>(expectedSize * 2, 64)), Slot{ 0, EMPTY_SLOT });
+
+		mask = slots.size() - 1;
+	}
+
+	uint32_t findOrInsert(uint32_t hash, uint32_t corner)
+	{
+		if ((size + 1) * 4 > slots.size() * 3)
+		{
+			grow();
+		}
+
+		for (size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			Slot& slot = slots[i];
+
+			if (slot.corner == EMPTY_SLOT)
+			{
+				slot = { hash, corner };
+				size++;
+
+				return corner;
+			}
+
+			if (slot.hash == hash && keys[slot.corner] == keys[corner])
+			{
+				return slot.corner;
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t hash;
+		uint32_t corner;
+	};
+
+	const VertexKey* keys;
+
+	std::vector<Slot> slots;
+	size_t mask = 0, size = 0;
+
+	void grow()
+	{
+		std::vector<Slot> oldSlots(slots.size() * 2, Slot{ 0, EMPTY_SLOT });
+
+		std::swap(slots, oldSlots);
+
+		mask = slots.size() - 1;
+
+		for (const Slot& slot : oldSlots)
+		{
+			if (slot.corner != EMPTY_SLOT)
+			{
+				size_t i = slot.hash & mask;
+
+				while (slots[i].corner != EMPTY_SLOT)
+				{
+					i = (i + 1) & mask;
+				}
+
+				slots[i] = slot;
+			}
+		}
+	}
+};
+
+uint32_t deduplicateVertexKeys(std::span<const VertexKey> keys, uint32_t threadCount, std::vector<uint32_t>& cornerIndices, std::vector<uint32_t>& firstCorners)
+{
+	if (keys.size() >= EMPTY_SLOT)
+	{
+		throw std::runtime_error("Failed to deduplicate vertices, too many indices!");
+	}
+
+	size_t count = keys.size();
+	uint32_t shardCount = std::max(1u, threadCount);
+
+	std::vector<uint32_t> hashes(count);
+
+	cornerIndices.resize(count);
+
+	parallelFor(count, shardCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			hashes[i] = hashKey(keys[i]);
+		}
+	});
+
+	// Every shard scans the corners in order, so the first corner it records for a key is the first
+	// occurrence. A closed triangle mesh references each vertex about six times, half of the index
+	// count is a generous initial size that rarely needs to grow.
+	parallelFor(shardCount, shardCount, [&](size_t firstShard, size_t lastShard, uint32_t)
+	{
+		for (size_t shard = firstShard; shard < lastShard; shard++)
+		{
+			KeyTable table(keys.data(), count / 2 / shardCount);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t hash = hashes[i];
+
+				// The shard is chosen by the high bits of the hash, the table slot by the low ones.
+				if ((static_cast<uint64_t>(hash) * shardCount >> 32) == shard)
+				{
+					cornerIndices[i] = table.findOrInsert(hash, static_cast<uint32_t>(i));
+				}
+			}
+		}
+	});
+
+	// "cornerIndices" now holds the first corner of every key, number those corners in order. The hash
+	// array is reused to hold the number given to each first corner.
+	std::vector<uint32_t> chunkCounts(shardCount + 1, 0);
+
+	parallelFor(count, shardCount, [&](size_t begin, size_t end, uint32_t chunk)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			chunkCounts[chunk + 1] += cornerIndices[i] == i;
+		}
+	});
+
+	for (uint32_t i = 0; i < shardCount; i++)
+	{
+		chunkCounts[i + 1] += chunkCounts[i];
+	}
+
+	firstCorners.resize(chunkCounts[shardCount]);
+
+	parallelFor(count, shardCount, [&](size_t begin, size_t end, uint32_t chunk)
+	{
+		uint32_t next = chunkCounts[chunk];
+
+		for (size_t i = begin; i < end; i++)
+		{
+			if (cornerIndices[i] == i)
+			{
+				firstCorners[next] = static_cast<uint32_t>(i);
+				hashes[i] = next++;
+			}
+		}
+	});
+
+	parallelFor(count, shardCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			cornerIndices[i] = hashes[cornerIndices[i]];
+		}
+	});
+
+	return chunkCounts[shardCount];
+}
+
+uint32_t deduplicateVertexValues(float* vertices, size_t vertexCount, uint32_t floatsPerVertex, std::vector<uint32_t>& remap)
+{
+	std::vector<uint32_t> slots(std::bit_ceil(std::max<size_t>(vertexCount * 2, 64)), EMPTY_SLOT);
+	size_t mask = slots.size() - 1;
+	uint32_t uniqueCount = 0;
+
+	remap.resize(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertices + i * floatsPerVertex;
+		uint64_t hash = 0;
+
+		for (uint32_t j = 0; j < floatsPerVertex; j++)
+		{
+			// Negative zero is hashed as zero, as both compare equal.
+			float value = vertex[j] == 0.0f ? 0.0f : vertex[j];
+			uint32_t bits;
+
+			memcpy(&bits, &value, sizeof(bits));
+
+			hash = (hash ^ bits) * 0x100000001b3ull;
+		}
+
+		hash ^= hash >> 32;
+
+		size_t slot = hash & mask;
+
+		for (;; slot = (slot + 1) & mask)
+		{
+			if (slots[slot] == EMPTY_SLOT)
+			{
+				break;
+			}
+
+			const float* other = vertices + static_cast<size_t>(slots[slot]) * floatsPerVertex;
+			bool equal = true;
+
+			for (uint32_t j = 0; j < floatsPerVertex && equal; j++)
+			{
+				equal = vertex[j] == other[j];
+			}
+
+			if (equal)
+			{
+				break;
+			}
+		}
+
+		if (slots[slot] == EMPTY_SLOT)
+		{
+			slots[slot] = uniqueCount;
+
+			// Unique vertices are moved to the front, the destination was already processed.
+			if (uniqueCount != i)
+			{
+				memcpy(vertices + static_cast<size_t>(uniqueCount) * floatsPerVertex, vertex, floatsPerVertex * sizeof(float));
+			}
+
+			uniqueCount++;
+		}
+
+		remap[i] = slots[slot];
+	}
+
+	return uniqueCount;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+// Same layout as "tinyobj::index_t".
+struct VertexKey
+{
+	int32_t position;
+	int32_t normal;
+	int32_t texcoord;
+};
+
+// Meshes with more corners than this are deduplicated with the sharded multi-threaded path.
+const size_t PARALLEL_DEDUP_THRESHOLD = 1 << 20;
+
+// Numbers the unique keys by first occurrence and writes, for every corner, the number of its key.
+// "firstCorners" receives the corner where every unique key first appears. With more than one thread
+// the keys are sharded by hash, every thread owning the flat table of its shard.
+uint32_t deduplicateVertexKeys(std::span<const VertexKey> keys, uint32_t threadCount, std::vector<uint32_t>& cornerIndices, std::vector<uint32_t>& firstCorners);
+
+// Merges vertices whose float components compare equal (so -0.0 and 0.0 are the same value), keeping
+// the first occurrence order. Unique vertices are compacted to the front of "vertices" and "remap"
+// maps every input vertex to its output slot.
+uint32_t deduplicateVertexValues(float* vertices, size_t vertexCount, uint32_t floatsPerVertex, std::vector<uint32_t>& remap);